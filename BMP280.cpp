@@ -1,36 +1,29 @@
 #include "BMP280.h"
 
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
-#include <fcntl.h>
 #include <iostream>
-#include <linux/i2c-dev.h>
 #include <thread>
-#include <unistd.h>
-#include <sys/ioctl.h>
 
 #undef DBG
 
-BMP280::BMP280(std::string i2c_dev_name, uint8_t ccs811_addr)
-        : i2c_dev_name(std::move(i2c_dev_name)),
-          ccs811_addr(ccs811_addr) {
-    open_device();
+BMP280::BMP280(I2CTransport &bus, uint8_t bmp280_addr)
+        : bus(bus),
+          bmp280_addr(bmp280_addr) {
     init();
 }
 
-BMP280::~BMP280() {
-    close_device();
-}
-
-void BMP280::close_device() {
-    if (i2c_fd >= 0) close(i2c_fd);
-}
+BMP280::~BMP280() = default;
 
 void BMP280::init() {
     if (verbose) {
         std::cout << "[BMP280] Resetting BMP280..." << std::endl;
     }
     reset();
-    std::this_thread::sleep_for(std::chrono::seconds(3));
+    if (wait_reset_done() < 0) {
+        throw "[BMP280] reset timed out";
+    }
 
     auto id = read_id();
     if (id != 0x58) {
@@ -45,8 +38,6 @@ void BMP280::init() {
     if (verbose) {
         std::cout << "[BMP280] Setting the measurement control register" << std::endl;
     }
-    uint8_t temp_oversampling = 1; // x1 oversampling
-    uint8_t pres_oversampling = 1; // x1 oversampling
     uint8_t power_mode = 3; // Normal mode
 
     auto ctrl_meas_reg = static_cast<uint8_t>(((temp_oversampling & 7) << 5) | ((pres_oversampling & 7) << 2) |
@@ -72,44 +63,27 @@ void BMP280::init() {
     }
 }
 
-void BMP280::open_device() {
-    i2c_fd = open(i2c_dev_name.c_str(), O_RDWR);
-    if (i2c_fd < 0) {
-        std::cerr << "[BMP280] Unable to open " << i2c_dev_name << ". " << strerror(errno) << std::endl;
-        throw 1;
-    }
-
-    if (ioctl(i2c_fd, I2C_SLAVE, ccs811_addr) < 0) {
-        std::cerr << "[BMP280] Failed to communicate with the device. " << strerror(errno) << std::endl;
-        throw 1;
-    }
-}
-
-std::unique_ptr<std::vector<uint8_t>> BMP280::read_registers(uint8_t start, size_t count) {
+// Register pointer write and burst read are done in one combined transaction (repeated start).
+int BMP280::read_registers(uint8_t start, uint8_t *buffer, size_t count) {
     uint8_t data[] = {start};
-    write_data(data, 1);
 
-    auto *read_buffer = new uint8_t[count];
-    auto bytes_read = read(i2c_fd, read_buffer, count);
-
-    if (bytes_read < 0) {
-        // return an empty vector if we can't read anything.
-        return std::make_unique<std::vector<uint8_t>>();
+    TraceSpan span("bmp280 read", Tracer::TRACE_I2C, bmp280_addr);
+    auto bytes_read = bus.write_read(bmp280_addr, data, 1, buffer, count);
+    span.result((int32_t) bytes_read);
+    if (bytes_read != (ssize_t) count) {
+        std::cerr << "[BMP280] Unable to read registers (" << strerror(errno) << ")." << std::endl;
+        return -1;
     }
 
-    auto result = std::make_unique<std::vector<uint8_t>>(read_buffer, read_buffer + bytes_read);
-
-    delete[] read_buffer;
-
 #ifdef DBG
     std::cerr << "\tRegisters: ";
-    for (auto e : *result) {
-        std::cerr << std::hex << (int) e << " ";
+    for (size_t i = 0; i < count; i++) {
+        std::cerr << std::hex << (int) buffer[i] << " ";
     }
     std::cerr << std::endl;
 #endif
 
-    return result;
+    return (int) bytes_read;
 }
 
 
@@ -121,7 +95,9 @@ int BMP280::write_data(uint8_t *buffer, size_t buffer_len) {
     }
 #endif
 
-    auto write_c = write(i2c_fd, buffer, buffer_len);
+    TraceSpan span("bmp280 write", Tracer::TRACE_I2C, bmp280_addr);
+    auto write_c = bus.write(bmp280_addr, buffer, buffer_len);
+    span.result((int32_t) write_c);
     if (write_c < 0) {
         std::cerr << "[BMP280] Unable to send command." << std::endl;
         // TODO - Have better exceptions.
@@ -134,24 +110,17 @@ int BMP280::write_data(uint8_t *buffer, size_t buffer_len) {
 }
 
 void BMP280::read_calibration_data() {
-    auto reg_data = read_registers(0x88, 24);
-    dig_T1 = (reg_data->at(1) << 8) | reg_data->at(0);
-    dig_T2 = (reg_data->at(3) << 8) | reg_data->at(2);
-    dig_T3 = (reg_data->at(5) << 8) | reg_data->at(4);
-    dig_P1 = (reg_data->at(7) << 8) | reg_data->at(6);
-    dig_P2 = (reg_data->at(9) << 8) | reg_data->at(8);
-    dig_P3 = (reg_data->at(11) << 8) | reg_data->at(10);
-    dig_P4 = (reg_data->at(13) << 8) | reg_data->at(12);
-    dig_P5 = (reg_data->at(15) << 8) | reg_data->at(14);
-    dig_P6 = (reg_data->at(17) << 8) | reg_data->at(16);
-    dig_P7 = (reg_data->at(19) << 8) | reg_data->at(18);
-    dig_P8 = (reg_data->at(21) << 8) | reg_data->at(20);
-    dig_P9 = (reg_data->at(23) << 8) | reg_data->at(22);
+    uint8_t reg_data[24];
+    if (read_registers(0x88, reg_data) < 0) {
+        throw "[BMP280] unable to read calibration data";
+    }
+    calibration.decode(reg_data);
 }
 
 uint8_t BMP280::read_status() {
-    auto reg_data = read_registers(0xf3, 1);    
-    return reg_data->front();
+    uint8_t reg_data[1] = {0};
+    read_registers(0xf3, reg_data);
+    return reg_data[0];
 }
 
 int BMP280::reset() {
@@ -159,64 +128,101 @@ int BMP280::reset() {
     return write_data(cmd, 2);
 }
 
+int BMP280::wait_reset_done() {
+    TraceSpan span("bmp280 reset", Tracer::TRACE_SLEEP, STARTUP_TIME_MYS);
+    uint32_t waited = STARTUP_TIME_MYS;
+    uint8_t status[1];
+
+    std::this_thread::sleep_for(std::chrono::microseconds(STARTUP_TIME_MYS));
+    // im_update (bit 0) is set while the NVM data are copied to the image registers
+    while ((read_registers(0xf3, status) != 1) || ((status[0] & 0x01) != 0)) {
+        if (waited >= RESET_TIMEOUT_MYS) {
+            return -1;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(RESET_POLL_INTERVAL_MYS));
+        waited += RESET_POLL_INTERVAL_MYS;
+    }
+    return 0;
+}
+
 int BMP280::set_ctrl_meas(uint8_t val) {
     uint8_t cmd[] = {0xf4, val};
     return write_data(cmd, 2);
 }
 
 uint8_t BMP280::read_id() {
-    auto id = read_registers(0xd0, 1);
-    return id->front();
+    uint8_t id[1] = {0};
+    read_registers(0xd0, id);
+    return id[0];
 }
 
 
-void BMP280::measure() {
-    auto pressure_data = read_registers(0xf7, 3);
-    uint8_t pressure_msb = pressure_data->at(0);
-    uint8_t pressure_lsb = pressure_data->at(1);
-    uint8_t pressure_xlsb = pressure_data->at(2);
+uint32_t BMP280::measurement_time_mys() {
+    // t_measure,max = 1.25 ms + 2.3 ms * T_oversampling + (2.3 ms * P_oversampling + 0.575 ms)
+    uint32_t t_os = temp_oversampling ? (1u << (std::min<uint8_t>(temp_oversampling, 5) - 1)) : 0;
+    uint32_t p_os = pres_oversampling ? (1u << (std::min<uint8_t>(pres_oversampling, 5) - 1)) : 0;
+    return 1250 + 2300 * t_os + (p_os ? 2300 * p_os + 575 : 0);
+}
+
+int BMP280::measure() {
+    return (measure_blocking() < 0) ? -1 : 0;
+}
+
+int BMP280::start_measurement(uint32_t &wait_mys) {
+    polls_left = MAX_READY_POLLS;
+    return continue_measurement(wait_mys);
+}
+
+int BMP280::continue_measurement(uint32_t &wait_mys) {
+    int rc = read_result();
+    if (rc < 0) {
+        return -1;
+    }
+    if (rc > 0) {
+        if (polls_left-- > 0) {
+            // first conversion after configuration still running
+            wait_mys = measurement_time_mys();
+            return PHASE_PENDING;
+        }
+        std::cerr << "[BMP280] No conversion result available." << std::endl;
+        return -1;
+    }
+    return PHASE_DONE;
+}
+
+int BMP280::read_result() {
+    // One burst over status (0xf3) .. temp_xlsb (0xfc): the data registers are shadowed during
+    // a burst read, so pressure and temperature are taken from the same conversion.
+    uint8_t data[10];
+    if (read_registers(0xf3, data) < 0) {
+        std::cerr << "[BMP280] Unable to read measurement registers." << std::endl;
+        return -1;
+    }
+    uint8_t pressure_msb = data[4];
+    uint8_t pressure_lsb = data[5];
+    uint8_t pressure_xlsb = data[6];
 
     uint32_t pressure_val = (pressure_msb << 12) | (pressure_lsb << 4) | (pressure_xlsb >> 4);
 
-    auto temp_data = read_registers(0xfa, 3);
-    uint8_t temp_msb = temp_data->at(0);
-    uint8_t temp_lsb = temp_data->at(1);
-    uint8_t temp_xlsb = temp_data->at(2);
+    uint8_t temp_msb = data[7];
+    uint8_t temp_lsb = data[8];
+    uint8_t temp_xlsb = data[9];
 
     uint32_t temp_val = (temp_msb << 12) | (temp_lsb << 4) | (temp_xlsb >> 4);
 
-    pressure = compensate_pressure(pressure_val);
-    temperature = compensate_temp(temp_val);
+    // data registers still hold their reset value and the chip is measuring: no result yet
+    if ((data[0] & 0x08) && (temp_val == 0x80000) && (pressure_val == 0x80000)) {
+        return 1;
+    }
+
+    // temperature first: the pressure compensation depends on t_fine of the same conversion
+    temperature = BMP280Compensation::temperature(calibration, temp_val, t_fine);
+    pressure = BMP280Compensation::pressure(calibration, pressure_val, t_fine);
 
     last_measurement = time(nullptr);
     
-    status = read_status();
-}
-
-// Compensation formulae are taken from the datasheet.
-// Returns temperature in Celsuis, resolution is 0.01 DegC.
-double BMP280::compensate_temp(uint32_t adc_t) {
-    double var1 = (((double) adc_t) / 16384.0 - ((double) dig_T1) / 1024.0) * ((double) dig_T2);
-    double var2 = ((((double) adc_t) / 131072.0 - ((double) dig_T1) / 8192.0) *
-                   (((double) adc_t) / 131072.0 - ((double) dig_T1) / 8192.0)) * ((double) dig_T3);
-    t_fine = static_cast<int32_t>(var1 + var2);
-    return t_fine / 5120.0;
-}
-
-// Returns pressure in Pa as unsigned 32 bit integer in Q24.8 format (24 integer bits and 8 fractional bits).
-// Output value of 24674867 represents 24674867/256 = 96386.2 Pa = 963.862 hPa
-double BMP280::compensate_pressure(int32_t adc_p) {
-    double var1 = ((double) t_fine / 2.0) - 64000.0;
-    double var2 = var1 * var1 * ((double) dig_P6) / 32768.0;
-    var2 = var2 + var1 * ((double) dig_P5) * 2.0;
-    var2 = (var2 / 4.0) + (((double) dig_P4) * 65536.0);
-    var1 = (((double) dig_P3) * var1 * var1 / 524288.0 + ((double) dig_P2) * var1) / 524288.0;
-    var1 = (1.0 + var1 / 32768.0) * ((double) dig_P1);
-    double p = 1048576.0 - (double) adc_p;
-    p = (p - (var2 / 4096.0)) * 6250.0 / var1;
-    var1 = ((double) dig_P9) * p * p / 2147483648.0;
-    var2 = p * ((double) dig_P8) / 32768.0;
-    return (p + (var1 + var2 + ((double) dig_P7)) / 16.0) / 100;
+    status = data[0];
+    return 0;
 }
 
 double BMP280::get_temperature() {
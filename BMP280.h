@@ -1,15 +1,18 @@
 #ifndef IAQ_BMP280_H
 #define IAQ_BMP280_H
 
-#include <memory>
+#include "BMP280Compensation.h"
+#include "I2CTransport.h"
+#include "MeasurementCycle.h"
+#include "Tracer.h"
+
 #include <string>
-#include <vector>
 
 // BMP280 interface per specifications in
 // https://ae-bst.resource.bosch.com/media/_tech/media/datasheets/BST-BMP280-DS001.pdf
-class BMP280 {
+class BMP280 : public PhasedMeasurement {
 public:
-    BMP280(std::string i2c_dev_name, uint8_t ccs811_addr);
+    BMP280(I2CTransport &bus, uint8_t bmp280_addr);
 
     ~BMP280();
 
@@ -21,37 +24,60 @@ public:
 
     uint8_t get_status();
 
-    void measure();
+    // Reads the result of the last conversion (normal mode). Returns 0 or -1 on error.
+    int measure();
+
+    // The BMP280 converts continuously, so a measurement is a single phase.
+    int start_measurement(uint32_t &wait_mys) override;
+
+    int continue_measurement(uint32_t &wait_mys) override;
 
 private:
-    const std::string i2c_dev_name;
-    const uint8_t ccs811_addr;
-    int i2c_fd = -1;
+    I2CTransport &bus;
+    const uint8_t bmp280_addr;
     time_t last_measurement = 0;
     double pressure;
     double temperature;
     uint8_t status = 0;
+    uint8_t temp_oversampling = 1; // x1 oversampling
+    uint8_t pres_oversampling = 1; // x1 oversampling
+    int polls_left = 0;
 
-    // Calibration values.
-    uint16_t dig_T1, dig_P1;
-    int16_t dig_T2, dig_T3, dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9;
+    enum Timing : uint32_t {
+        MAX_READY_POLLS = 2,
+        STARTUP_TIME_MYS = 2000,        // t_startup after power on or soft reset
+        RESET_POLL_INTERVAL_MYS = 1000,
+        RESET_TIMEOUT_MYS = 100000
+    };
 
-    // State for the compensation formula
-    int32_t t_fine;
+    // Waits until the soft reset has finished (polls im_update). Returns 0 or -1 on timeout.
+    int wait_reset_done();
 
-    double compensate_temp(uint32_t temp_val);
+    // Maximum measurement time per datasheet for the configured oversampling.
+    uint32_t measurement_time_mys();
 
-    double compensate_pressure(int32_t adc_P);
+    // Burst read of status and results: 0 on success, 1 if no conversion has finished yet
+    // since the measurement was configured, -1 on error.
+    int read_result();
 
-    void close_device();
+    // Calibration values.
+    BMP280Calibration calibration;
 
-    void init();
+    // State for the compensation formula
+    int32_t t_fine;
 
-    void open_device();
+    void init();
 
     void read_calibration_data();
 
-    std::unique_ptr<std::vector<uint8_t>> read_registers(uint8_t start, size_t count);
+    // Reads count registers starting at start into buffer.
+    // Returns the number of bytes read or -1 on error.
+    int read_registers(uint8_t start, uint8_t *buffer, size_t count);
+
+    template<size_t N>
+    int read_registers(uint8_t start, uint8_t (&buffer)[N]) {
+        return read_registers(start, buffer, N);
+    }
 
     uint8_t read_id();
 
@@ -0,0 +1,110 @@
+#ifndef IAQ_BMP280_COMPENSATION_H
+#define IAQ_BMP280_COMPENSATION_H
+
+#include <cstdint>
+
+// Trimming parameters of the BMP280 (registers 0x88..0x9F).
+struct BMP280Calibration {
+    uint16_t dig_T1;
+    int16_t dig_T2, dig_T3;
+    uint16_t dig_P1;
+    int16_t dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9;
+
+    // Decodes the 24 byte block read from 0x88 (little endian words).
+    void decode(const uint8_t *reg_data) {
+        dig_T1 = (reg_data[1] << 8) | reg_data[0];
+        dig_T2 = (reg_data[3] << 8) | reg_data[2];
+        dig_T3 = (reg_data[5] << 8) | reg_data[4];
+        dig_P1 = (reg_data[7] << 8) | reg_data[6];
+        dig_P2 = (reg_data[9] << 8) | reg_data[8];
+        dig_P3 = (reg_data[11] << 8) | reg_data[10];
+        dig_P4 = (reg_data[13] << 8) | reg_data[12];
+        dig_P5 = (reg_data[15] << 8) | reg_data[14];
+        dig_P6 = (reg_data[17] << 8) | reg_data[16];
+        dig_P7 = (reg_data[19] << 8) | reg_data[18];
+        dig_P8 = (reg_data[21] << 8) | reg_data[20];
+        dig_P9 = (reg_data[23] << 8) | reg_data[22];
+    }
+};
+
+// Compensation policies. Both provide
+//   temperature(cal, adc_T, t_fine): temperature in DegC, stores t_fine for pressure()
+//   pressure(cal, adc_P, t_fine):    pressure in hPa
+// The BMP280 driver uses BMP280Compensation, selected at compile time (see below).
+
+// Double precision formulae from the datasheet (chapter 8.1).
+struct BMP280DoubleCompensation {
+    static double temperature(const BMP280Calibration &cal, int32_t adc_T, int32_t &t_fine) {
+        double var1 = (((double) adc_T) / 16384.0 - ((double) cal.dig_T1) / 1024.0) * ((double) cal.dig_T2);
+        double var2 = ((((double) adc_T) / 131072.0 - ((double) cal.dig_T1) / 8192.0) *
+                       (((double) adc_T) / 131072.0 - ((double) cal.dig_T1) / 8192.0)) * ((double) cal.dig_T3);
+        t_fine = static_cast<int32_t>(var1 + var2);
+        return t_fine / 5120.0;
+    }
+
+    static double pressure(const BMP280Calibration &cal, int32_t adc_P, int32_t t_fine) {
+        double var1 = ((double) t_fine / 2.0) - 64000.0;
+        double var2 = var1 * var1 * ((double) cal.dig_P6) / 32768.0;
+        var2 = var2 + var1 * ((double) cal.dig_P5) * 2.0;
+        var2 = (var2 / 4.0) + (((double) cal.dig_P4) * 65536.0);
+        var1 = (((double) cal.dig_P3) * var1 * var1 / 524288.0 + ((double) cal.dig_P2) * var1) / 524288.0;
+        var1 = (1.0 + var1 / 32768.0) * ((double) cal.dig_P1);
+        if (var1 == 0.0) {
+            return 0;   // avoid exception caused by division by zero
+        }
+        double p = 1048576.0 - (double) adc_P;
+        p = (p - (var2 / 4096.0)) * 6250.0 / var1;
+        var1 = ((double) cal.dig_P9) * p * p / 2147483648.0;
+        var2 = p * ((double) cal.dig_P8) / 32768.0;
+        return (p + (var1 + var2 + ((double) cal.dig_P7)) / 16.0) / 100;
+    }
+};
+
+// 32 bit temperature and 64 bit pressure integer formulae from the datasheet (chapter 3.11.3),
+// for boards with soft-float or a slow FPU. Left shifts of signed values are written as
+// multiplications (same result, but defined for negative values).
+struct BMP280IntegerCompensation {
+    // Returns temperature in 0.01 DegC, e.g. 5123 = 51.23 DegC.
+    static int32_t temperature_int(const BMP280Calibration &cal, int32_t adc_T, int32_t &t_fine) {
+        int32_t var1 = ((((adc_T >> 3) - ((int32_t) cal.dig_T1 * 2))) * ((int32_t) cal.dig_T2)) >> 11;
+        int32_t var2 = (((((adc_T >> 4) - ((int32_t) cal.dig_T1)) * ((adc_T >> 4) - ((int32_t) cal.dig_T1))) >> 12) *
+                        ((int32_t) cal.dig_T3)) >> 14;
+        t_fine = var1 + var2;
+        return (t_fine * 5 + 128) >> 8;
+    }
+
+    // Returns pressure in Pa in Q24.8 format, e.g. 24674867 = 24674867/256 Pa = 963.862 hPa.
+    static uint32_t pressure_int(const BMP280Calibration &cal, int32_t adc_P, int32_t t_fine) {
+        int64_t var1 = ((int64_t) t_fine) - 128000;
+        int64_t var2 = var1 * var1 * (int64_t) cal.dig_P6;
+        var2 = var2 + ((var1 * (int64_t) cal.dig_P5) * 131072);
+        var2 = var2 + (((int64_t) cal.dig_P4) * 34359738368LL);
+        var1 = ((var1 * var1 * (int64_t) cal.dig_P3) >> 8) + ((var1 * (int64_t) cal.dig_P2) * 4096);
+        var1 = (((((int64_t) 1) << 47) + var1)) * ((int64_t) cal.dig_P1) >> 33;
+        if (var1 == 0) {
+            return 0;   // avoid exception caused by division by zero
+        }
+        int64_t p = 1048576 - adc_P;
+        p = (((p * 2147483648LL) - var2) * 3125) / var1;
+        var1 = (((int64_t) cal.dig_P9) * (p >> 13) * (p >> 13)) >> 25;
+        var2 = (((int64_t) cal.dig_P8) * p) >> 19;
+        p = ((p + var1 + var2) >> 8) + (((int64_t) cal.dig_P7) * 16);
+        return (uint32_t) p;
+    }
+
+    static double temperature(const BMP280Calibration &cal, int32_t adc_T, int32_t &t_fine) {
+        return temperature_int(cal, adc_T, t_fine) / 100.0;
+    }
+
+    static double pressure(const BMP280Calibration &cal, int32_t adc_P, int32_t t_fine) {
+        return pressure_int(cal, adc_P, t_fine) / 25600.0;
+    }
+};
+
+#ifdef BMP280_INTEGER_COMPENSATION
+typedef BMP280IntegerCompensation BMP280Compensation;
+#else
+typedef BMP280DoubleCompensation BMP280Compensation;
+#endif
+
+#endif //IAQ_BMP280_COMPENSATION_H
@@ -0,0 +1,77 @@
+#include "BaselineStore.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char BASELINE_MAGIC[8] = "CJMCUBL";
+
+BaselineStore::BaselineStore(std::string path)
+        : path(std::move(path)) {
+}
+
+uint32_t BaselineStore::checksum(const BaselineRecord &record) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&record);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(BaselineRecord, checksum); i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+int BaselineStore::load(BaselineRecord &record) const {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t ret = read(fd, &record, sizeof(record));
+    close(fd);
+    if ((ret != (ssize_t) sizeof(record)) || (memcmp(record.magic, BASELINE_MAGIC, sizeof(record.magic)) != 0) ||
+        (record.version != VERSION) || (record.checksum != checksum(record))) {
+        errno = EINVAL;
+        return -1;
+    }
+    record.device[sizeof(record.device) - 1] = '\0';
+    return 0;
+}
+
+int BaselineStore::save(BaselineRecord &record) const {
+    std::string tmp_path = path + ".tmp";
+    int fd, saved_errno;
+
+    memcpy(record.magic, BASELINE_MAGIC, sizeof(record.magic));
+    record.version = VERSION;
+    record.checksum = checksum(record);
+
+    fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t ret = write(fd, &record, sizeof(record));
+    if ((ret != (ssize_t) sizeof(record)) || (fsync(fd) < 0)) {
+        saved_errno = ((ret >= 0) && (ret < (ssize_t) sizeof(record))) ? EIO : errno;
+        close(fd);
+        unlink(tmp_path.c_str());
+        errno = saved_errno;
+        return -1;
+    }
+    close(fd);
+    if (rename(tmp_path.c_str(), path.c_str()) < 0) {
+        saved_errno = errno;
+        unlink(tmp_path.c_str());
+        errno = saved_errno;
+        return -1;
+    }
+    // make the rename durable
+    std::string dir = path.substr(0, path.rfind('/') + 1);
+    fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    return 0;
+}
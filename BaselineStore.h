@@ -0,0 +1,48 @@
+#ifndef IAQ_BASELINE_STORE_H
+#define IAQ_BASELINE_STORE_H
+
+#include <cstdint>
+#include <string>
+
+// Checkpoint of the BASELINE of a CCS811 (host byte order). The identity fields tell which
+// sensor the baseline was learned by: HW_ID is the same for all CCS811, so the bus and the
+// address of the sensor are kept too, and the firmware, whose algorithm defines the baseline.
+struct BaselineRecord {
+    char magic[8];              // "CJMCUBL\0"
+    uint32_t version;
+    uint8_t hw_id;
+    uint8_t hw_version;
+    uint8_t fw_app_version[2];
+    int64_t saved;              // time of the checkpoint
+    uint8_t address;            // I2C address of the CCS811
+    uint8_t baseline[2];
+    uint8_t reserved[5];
+    char device[64];            // I2C bus of the CCS811
+    uint32_t checksum;          // FNV-1a over all preceding bytes of the record
+};
+
+// One baseline checkpoint in a file. save() writes a temporary file and renames it over the
+// checkpoint, so a crash or power loss leaves either the old or the new record.
+class BaselineStore {
+public:
+    static const uint32_t VERSION = 1;
+
+    explicit BaselineStore(std::string path);
+
+    // Reads the checkpoint. Returns 0 on success, -1 with errno set if there is none (ENOENT)
+    // or it is no valid record (EINVAL).
+    int load(BaselineRecord &record) const;
+
+    // Sets magic, version and checksum of the record and writes it. Returns 0 on success, -1
+    // with errno set on error.
+    int save(BaselineRecord &record) const;
+
+    const std::string &get_path() const { return path; }
+
+private:
+    const std::string path;
+
+    static uint32_t checksum(const BaselineRecord &record);
+};
+
+#endif //IAQ_BASELINE_STORE_H
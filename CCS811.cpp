@@ -1,9 +1,5 @@
 #include "CCS811.h"
 
-#include <fcntl.h>
-#include <linux/i2c-dev.h>
-#include <sys/ioctl.h>
-
 // #define DBG
 
 /* measurement mode of CC811:
@@ -13,20 +9,16 @@
    Mode 3 – Low power pulse heating mode IAQ measurement every 60 seconds
    Mode 4 – Constant power mode, sensor measurement every 250ms
 */
-#define MEASUREMENT_MODE  2 // supported values: 1, 2, 3
+#define MEASUREMENT_MODE  2 // drive mode after the start, see set_drive_mode()
 
-CCS811::CCS811(std::string i2c_dev_name, uint8_t ccs811_addr)
-        : i2c_dev_name(std::move(i2c_dev_name)),
-          ccs811_addr(ccs811_addr) {
-    open_device();
+CCS811::CCS811(I2CTransport &bus, uint8_t ccs811_addr)
+        : bus(bus),
+          ccs811_addr(ccs811_addr),
+          drive_mode(MEASUREMENT_MODE) {
     init();
 }
 
-CCS811::~CCS811() {
-    close_device();
-}
-
-void CCS811::close_device() const { if (i2c_fd >= 0) close(i2c_fd); }
+CCS811::~CCS811() = default;
 
 uint16_t CCS811::get_co2() {
     return co2;
@@ -36,50 +28,72 @@ uint16_t CCS811::get_tvoc() {
     return tvoc;
 }
 
+uint32_t CCS811::get_suppressed_transactions() {
+    return suppressed_transactions;
+}
+
 int CCS811::set_measurement_mode() {
-#if (MEASUREMENT_MODE == 1)
+    static const char *const descriptions[] = {
+            "Mode 0 - Idle, no measurements",
+            "Mode 1 - Constant power mode, IAQ measurement every 1 sec.",
+            "Mode 2 - Pulse heating mode IAQ measurement every 10 sec.",
+            "Mode 3 - Low power pulse heating mode IAQ measurement every 60 sec.",
+            "Mode 4 - Constant power mode, raw data every 250 ms"
+    };
     if (verbose) {
-        std::cout << "[CCS811] Configuring measurement mode to Mode 1 - Constant power mode, measuring every 1 sec."
-                  << std::endl;
+        std::cout << "[CCS811] Configuring measurement mode to " << descriptions[drive_mode] << std::endl;
     }
-    measurement_mode[0] = 0x10;
-#elif (MEASUREMENT_MODE == 2)
-    if (verbose) {
-        std::cout << "[CCS811] Configuring measurement mode to Mode 2 - Pulse heating mode IAQ measurement every 10 sec."
-                  << std::endl;
+    measurement_mode[0] = (uint8_t) (drive_mode << 4);
+    if (data_ready_interrupt) {
+        measurement_mode[0] |= 0x08;    // INT_DATARDY
     }
-    measurement_mode[0] = 0x20;
-#else 
-    if (verbose) {
-        std::cout << "[CCS811] Configuring measurement mode to Mode 3 -  Low power pulse heating mode IAQ measurement every 60 sec."
-                  << std::endl;
+    if (meas_mode_shadow.unchanged(measurement_mode)) {
+        suppressed_transactions++;
+        return 0;
     }
-    measurement_mode[0] = 0x30;
-#endif
     if (write_to_mailbox(MEAS_MODE, measurement_mode, 1) < 0) {
-        throw "[CCS811] unable to set mode";        
+        meas_mode_shadow.invalidate();
+        return -1;
     }
-    std::this_thread::sleep_for(std::chrono::microseconds(15000));
+    meas_mode_shadow.store(measurement_mode);
     return 0;
 }
 
-int CCS811::read_baseline() {
-    auto bl = read_mailbox(BASELINE);
-    if (bl->empty()) {
-        std::cerr << "[CCS811] Unable to read baseline register.";
+int CCS811::set_drive_mode(uint8_t mode) {
+    if (mode > 4) {
         return -1;
     }
-
-    if (bl->size() < 2) {
-        std::cerr << "[CCS811] baseline: Mailbox not filled, size: " << bl->size() << std::endl;
-        return -2;
+    uint8_t previous = drive_mode;
+    drive_mode = mode;
+    if (set_measurement_mode() < 0) {
+        drive_mode = previous;
+        return -1;
     }
-    
-    baseline[0] = bl->at(0);
-    baseline[1] = bl->at(1);
     return 0;
 }
 
+int CCS811::read_raw_data(RawData &raw) {
+    uint8_t status[1];
+    uint8_t data[2];
+
+    if (read_mailbox(STATUS, status) < 0) {
+        return -1;
+    }
+    if ((status[0] & 0x08) != 0x08) {
+        return 0;
+    }
+    if (read_mailbox(RAW_DATA, data) < 0) {
+        return -1;
+    }
+    decode_raw_data(data, raw);
+    return 1;
+}
+
+int CCS811::set_data_ready_interrupt(bool enable) {
+    data_ready_interrupt = enable;
+    return set_measurement_mode();
+}
+
 int CCS811::write_baseline() {
 
     if ((baseline[0] == 0) && (baseline[1] == 0)) {
@@ -97,160 +111,234 @@ int CCS811::write_baseline() {
     return 0;
 }
 
+int CCS811::restore_baseline(const uint8_t *bl) {
+    uint8_t previous[2] = {baseline[0], baseline[1]};
+
+    memcpy(baseline, bl, sizeof(baseline));
+    if (write_baseline() != 0) {
+        memcpy(baseline, previous, sizeof(baseline));
+        return -1;
+    }
+    return 0;
+}
+
 int CCS811::init() {
     if (verbose) {
         std::cout << "[CCS811] checking the hardware id..." << std::endl;
     }
-    auto hw_id = read_mailbox(HW_ID);
-    if (hw_id->empty()) {
+    uint8_t hw_id[1];
+    if (read_mailbox(HW_ID, hw_id) < 0) {
         throw "[CCS811] Unable to read device id.";
     }
-    if (hw_id->front() != 0x81) {
-        std::cerr << "[CCS811] Unrecognized hardware id 0x" << std::hex << (int) hw_id->front() << std::endl;
+    if (hw_id[0] != 0x81) {
+        std::cerr << "[CCS811] Unrecognized hardware id 0x" << std::hex << (int) hw_id[0] << std::endl;
         throw "[CCS811] Invalid device id!";
     }
+    identity.hw_id = hw_id[0];
+    uint8_t hw_version[1];
+    if (read_mailbox(HW_VERSION, hw_version) == 1) {
+        identity.hw_version = hw_version[0];
+    }
+    uint8_t fw_app_version[2];
+    if (read_mailbox(FW_APP_VERSION, fw_app_version) == 2) {
+        memcpy(identity.fw_app_version, fw_app_version, sizeof(fw_app_version));
+    }
 
 /*
-    auto hw_version = read_mailbox(HW_VERSION);
+    uint8_t hw_version[1];
+    read_mailbox(HW_VERSION, hw_version);
     char version_str[15];
-    version_to_str(hw_version->front(), version_str);
+    version_to_str(hw_version[0], version_str);
     std::cout << "[CCS811] HW Version: " << version_str << std::endl;
 
-    auto fw_boot_ver = read_mailbox(FW_BOOT_VERSION);
-    version_to_str(fw_boot_ver->front(), version_str);
-    std::cout << "[CCS811] FW Boot Version: " << version_str << "." << (int) fw_boot_ver->at(1) << std::endl;
+    uint8_t fw_boot_ver[2];
+    read_mailbox(FW_BOOT_VERSION, fw_boot_ver);
+    version_to_str(fw_boot_ver[0], version_str);
+    std::cout << "[CCS811] FW Boot Version: " << version_str << "." << (int) fw_boot_ver[1] << std::endl;
 
-    auto fw_app_ver = read_mailbox(FW_APP_VERSION);
-    version_to_str(fw_app_ver->front(), version_str);
-    std::cout << "[CCS811] FW Application Version: " << version_str << "." << (int) fw_app_ver->at(1) << std::endl;
+    uint8_t fw_app_ver[2];
+    read_mailbox(FW_APP_VERSION, fw_app_ver);
+    version_to_str(fw_app_ver[0], version_str);
+    std::cout << "[CCS811] FW Application Version: " << version_str << "." << (int) fw_app_ver[1] << std::endl;
 */
 
     if (verbose) {
         std::cout << "[CCS811] Starting..." << std::endl;
     }
+    // the application firmware starts with default mailbox contents
+    meas_mode_shadow.invalidate();
+    env_data_shadow.invalidate();
     uint8_t buffer[] = {APP_START};
     if (write_data(buffer, 1) < 0) {
         throw "[CCS811] unable to start";
     }
-    std::this_thread::sleep_for(std::chrono::microseconds(62500));
+    if (wait_app_started() < 0) {
+        throw "[CCS811] application did not start";
+    }
 
-    return set_measurement_mode();
+    if (set_measurement_mode() < 0) {
+        throw "[CCS811] unable to set mode";
+    }
+    return 0;
 }
 
-void CCS811::open_device() {
-    i2c_fd = open(i2c_dev_name.c_str(), O_RDWR);
-    if (i2c_fd < 0) {
-        std::cerr << "[CCS811] Unable to open" << i2c_dev_name << ". " << strerror(errno) << std::endl;
-        throw 1;
-    }
+int CCS811::wait_app_started() {
+    TraceSpan span("ccs811 app start", Tracer::TRACE_SLEEP, APP_START_POLL_INTERVAL_MYS);
+    uint32_t waited = 0;
+    uint8_t status[1];
+
+    // FW_MODE (bit 7) is set when the application firmware runs
+    do {
+        std::this_thread::sleep_for(std::chrono::microseconds(APP_START_POLL_INTERVAL_MYS));
+        waited += APP_START_POLL_INTERVAL_MYS;
+        if ((read_mailbox(STATUS, status) == 1) && ((status[0] & 0x80) != 0)) {
+            return 0;
+        }
+    } while (waited < APP_START_TIME_MYS);
+    return -1;
+}
 
-    if (ioctl(i2c_fd, I2C_SLAVE, ccs811_addr) < 0) {
-        std::cerr << "[CCS811] Failed to communicate with the device. " << strerror(errno) << std::endl;
-        throw 1;
+int CCS811::read_mailbox(CCS811::Mailbox m, uint8_t *buffer, size_t buffer_len, uint32_t delay_mys) {
+    if (select_mailbox(m) < 0) {
+        return -1;
     }
+    if (delay_mys > 0) {
+        TraceSpan span("ccs811 mailbox delay", Tracer::TRACE_SLEEP, (int32_t) delay_mys);
+        std::this_thread::sleep_for(std::chrono::microseconds(delay_mys));
+    }
+    return fetch_mailbox(m, buffer, buffer_len);
 }
 
-std::unique_ptr<std::vector<uint8_t>> CCS811::read_mailbox(CCS811::Mailbox m, uint32_t delay_mys) {
+int CCS811::select_mailbox(CCS811::Mailbox m) {
     auto mbox_info = mailbox_info(m);
 
     if (!mbox_info.readable) {
-        std::cerr << "[CCS811] Mailbox is not writeable!" << std::endl;
-        return std::make_unique<std::vector<uint8_t>>();
+        std::cerr << "[CCS811] Mailbox is not readable!" << std::endl;
+        return -1;
     }
 
-    // Select the mailbox.
     uint8_t mailbox_id_buf[] = {mbox_info.id};
-    if (write_data(mailbox_id_buf, 1) < 0) {
-        return std::make_unique<std::vector<uint8_t>>();
-    }
-    if (delay_mys > 0) {
-        std::this_thread::sleep_for(std::chrono::microseconds(delay_mys));
+    return write_data(mailbox_id_buf, 1);
+}
+
+int CCS811::fetch_mailbox(CCS811::Mailbox m, uint8_t *buffer, size_t buffer_len) {
+    auto mbox_info = mailbox_info(m);
+
+    if (buffer_len < mbox_info.size) {
+        std::cerr << "[CCS811] Read buffer too small for mailbox 0x" << std::hex << (int) mbox_info.id << std::endl;
+        return -1;
     }
 
-    size_t buffer_len = mbox_info.size;
-    auto *read_buffer = new uint8_t[buffer_len];
-    auto bytes_read = read(i2c_fd, read_buffer, buffer_len);
-    if (bytes_read != buffer_len) {
+    TraceSpan span("ccs811 read", Tracer::TRACE_I2C, ccs811_addr);
+    auto bytes_read = bus.read(ccs811_addr, buffer, mbox_info.size);
+    span.result((int32_t) bytes_read);
+    if (bytes_read != (ssize_t) mbox_info.size) {
         std::cerr << "[CCS811] Failed to read from the device. Bytes read: " << bytes_read << std::endl;
-        // TODO - Have better exceptions.
-        return std::make_unique<std::vector<uint8_t>>();
+        return -1;
     }
 
-    auto result = std::make_unique<std::vector<uint8_t>>();
 #ifdef DBG
     std::cerr << "[CCS811] Read: ";
-#endif
     for (size_t i = 0; i < mbox_info.size; i++) {
-        result->push_back(read_buffer[i]);
-#ifdef DBG
-        std::cerr << "0x" << std::hex << (int)read_buffer[i] << " ";
-#endif
+        std::cerr << "0x" << std::hex << (int)buffer[i] << " ";
     }
-#ifdef DBG
     std::cerr << std::endl;
 #endif
 
-    delete[] read_buffer;
-    return std::move(result);
+    return (int) bytes_read;
 }
 
 int CCS811::read_sensors() {
-    auto status = read_mailbox(STATUS);
+    return measure_blocking();
+}
+
+int CCS811::abort_measurement() {
+    phase = IDLE;
+    return -1;
+}
+
+uint32_t CCS811::ready_poll_budget_mys() {
+    // Only wait for DATA_READY in drive mode 1; with 10 s or 60 s between samples the status
+    // is checked once. Mode 4 has no algorithm results, start_measurement() never polls.
+    return (drive_mode == 1) ? 1000000 : 0;
+}
+
+int CCS811::start_measurement(uint32_t &wait_mys) {
+    if (!has_alg_results()) {
+        phase = IDLE;
+        return PHASE_DONE;      // nothing to read, the values stay unchanged
+    }
+    phase = READ_STATUS;
+    polls_left = ready_poll_budget_mys() / READY_POLL_INTERVAL_MYS;
+    return continue_measurement(wait_mys);
+}
+
+int CCS811::continue_measurement(uint32_t &wait_mys) {
+    if (phase != READ_STATUS) {
+        return abort_measurement();
+    }
+
+    uint8_t status[1];
     // Check if the sensor is ready for a read.
-    if (status->empty()) {
-        return -1;
+    if (read_mailbox(STATUS, status) < 0) {
+        return abort_measurement();
     }
-    if ((status->front() & 0x08) != 0x08) {
-        std::cerr << "[CCS811] No new samples are ready. Status register: 0x" << std::hex << int(status->front()) << std::endl;
-        return -1;
+    if ((status[0] & 0x08) != 0x08) {
+        if (polls_left-- > 0) {
+            wait_mys = READY_POLL_INTERVAL_MYS;
+            return PHASE_PENDING;
+        }
+        std::cerr << "[CCS811] No new samples are ready. Status register: 0x" << std::hex << int(status[0]) << std::endl;
+        return abort_measurement();
     }
-    if ((status->front() & 1) != 0) {
-        auto error_register = read_mailbox(ERROR_ID);
-        if (error_register->empty()) {
-              return -1;
+    if ((status[0] & 1) != 0) {
+        uint8_t error_register[1];
+        if (read_mailbox(ERROR_ID, error_register) < 0) {
+            return abort_measurement();
         }
-        std::cerr << "[CCS811] Error detected. Status register: 0x" << std::hex << int(status->front()) << ", Error register: " << std::hex << int(error_register->front()) << std::endl;
-        if (error_register->front() == 0x08) {
-              /* 0x08 -> bit 3: MAX_RESISTANCE -> The sensor resistance measurement has reached or exceeded the maximum range */
-              write_baseline();
-              /* do not return since data is marked as ready... */
+        std::cerr << "[CCS811] Error detected. Status register: 0x" << std::hex << int(status[0]) << ", Error register: " << std::hex << int(error_register[0]) << std::endl;
+        if (error_register[0] == 0x08) {
+            /* 0x08 -> bit 3: MAX_RESISTANCE -> The sensor resistance measurement has reached or exceeded the maximum range */
+            write_baseline();
+            /* do not return since data is marked as ready... */
         } else {
-              return -1;
+            return abort_measurement();
         }
     } else {
-        read_baseline();
+        uint8_t bl[2];
+        if (read_mailbox(BASELINE, bl) < 0) {
+            std::cerr << "[CCS811] Unable to read baseline register." << std::endl;
+        } else {
+            baseline[0] = bl[0];
+            baseline[1] = bl[1];
+        }
     }
 
-    std::this_thread::sleep_for(std::chrono::microseconds(15000));
-    auto data = read_mailbox(ALG_RESULT_DATA);
-    if (data->size() < 6) {
-        std::cerr << "[CCS811] Mailbox not filled, size: " << data->size() << std::endl;
-        return -1;
+    uint8_t data[8];
+    if (read_mailbox(ALG_RESULT_DATA, data) < 0) {
+        std::cerr << "[CCS811] Unable to read the algorithm results." << std::endl;
+        return abort_measurement();
     }
 
-    int status_byte = data->at(4);
-    int err_byte = data->at(5);
+    int status_byte = data[4];
+    int err_byte = data[5];
 
     if ((status_byte != 0x98) && (status_byte != 0x99)) {
         std::cerr << "[CCS811] Sensor wasn't ready (0x" << std::hex << status_byte << "). Not updating measurements." << std::endl;
-        return -1;
+        return abort_measurement();
     }
 
     if ((err_byte != 0) && (err_byte != 0x08 /* MAX_RESISTANCE */)) {
         std::cerr << "[CCS811] Error occurred while taking measurements. ERROR_ID: 0x" << std::hex << err_byte
                   << std::endl;
-        return -1;
+        return abort_measurement();
     }
 
-    co2 = (data->at(0) << 8) | data->at(1);
-    tvoc = (data->at(2) << 8) | data->at(3);
-
-    // Mask out the 16th bit from measurements. Sensor can randomly set values with the 16th bit set.
-    co2 &= ~(1 << 15);
-    tvoc &= ~(1 << 15);
+    decode_alg_result(data, co2, tvoc);
 
     last_measurement = time(nullptr);
-    return 0;
+    phase = IDLE;
+    return PHASE_DONE;
 }
 
 int CCS811::write_data(uint8_t *buffer, size_t buffer_len) {
@@ -262,7 +350,9 @@ int CCS811::write_data(uint8_t *buffer, size_t buffer_len) {
     std::cout << std::endl;
 #endif
 
-    auto write_c = write(i2c_fd, buffer, buffer_len);
+    TraceSpan span("ccs811 write", Tracer::TRACE_I2C, ccs811_addr);
+    auto write_c = bus.write(ccs811_addr, buffer, buffer_len);
+    span.result((int32_t) write_c);
     if (write_c < 0) {
         std::cerr << "[CCS811] Unable to send command ("  << strerror(errno) <<  ")." << std::endl;
         return -1;
@@ -285,7 +375,7 @@ int CCS811::write_to_mailbox(CCS811::Mailbox m, uint8_t *buffer, size_t buffer_l
     auto write_buf_len = std::min(buffer_len, mbox_info.size) + 1;
     uint8_t write_buffer[write_buf_len];
     write_buffer[0] = mbox_info.id;
-    memcpy(&write_buffer[1], buffer, write_buf_len);
+    memcpy(&write_buffer[1], buffer, write_buf_len - 1);
 
     return write_data(write_buffer, write_buf_len);
 }
@@ -302,6 +392,15 @@ int CCS811::set_env_data(double rel_humidity, double temperature) {
     auto temp_data = static_cast<uint16_t>((temperature + 25) * 512);
     uint8_t env_data[] = {static_cast<uint8_t>(rh_data >> 8), static_cast<uint8_t>(rh_data & 0xFF),
                           static_cast<uint8_t>(temp_data >> 8), static_cast<uint8_t>(temp_data & 0xFF)};
-    
-    return write_to_mailbox(ENV_DATA, env_data, 4);
+
+    if (env_data_shadow.unchanged(env_data)) {
+        suppressed_transactions++;
+        return 0;
+    }
+    if (write_to_mailbox(ENV_DATA, env_data, 4) < 0) {
+        env_data_shadow.invalidate();
+        return -1;
+    }
+    env_data_shadow.store(env_data);
+    return 0;
 }
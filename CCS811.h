@@ -1,25 +1,34 @@
 #ifndef IAQ_CCS811_H
 #define IAQ_CCS811_H
 
+#include "I2CTransport.h"
+#include "MeasurementCycle.h"
+#include "RegisterShadow.h"
+#include "Tracer.h"
+
 #include <cstring>
-#include <memory>
 #include <string>
 #include <utility>
 #include <unistd.h>
-#include <vector>
 #include <iostream>
 #include <thread>
 
 // CCS811 interface per specifications in
 // https://cdn.sparkfun.com/assets/learn_tutorials/1/4/3/CCS811_Datasheet-DS000459.pdf
-class CCS811 {
+class CCS811 : public PhasedMeasurement {
 public:
-    CCS811(std::string i2c_dev_name, uint8_t ccs811_addr);
+    CCS811(I2CTransport &bus, uint8_t ccs811_addr);
 
     ~CCS811();
 
+    // Reads the algorithm results (blocking).
     int read_sensors();
 
+    // read_sensors() split into phases, see PhasedMeasurement.
+    int start_measurement(uint32_t &wait_mys) override;
+
+    int continue_measurement(uint32_t &wait_mys) override;
+
     /* The equivalent CO2 (eCO2) output range for CCS811 is from 400ppm to 8192ppm. 
        Values outside this range are clipped. */
     uint16_t get_co2();
@@ -28,8 +37,58 @@ public:
        Values outside this range are clipped. */
     uint16_t get_tvoc();
 
+    // Writes ENV_DATA; skipped if the encoded values did not change since the last write.
     int set_env_data(double rel_humidity, double temperature);
 
+    // Drive mode 0 (idle) to 4 (raw data every 250 ms), see MEAS_MODE. The algorithm results
+    // are only computed in the modes 1 to 3; in the other modes a measurement completes at once
+    // without new values.
+    int set_drive_mode(uint8_t mode);
+
+    uint8_t get_drive_mode() const { return drive_mode; }
+
+    bool has_alg_results() const { return (drive_mode >= 1) && (drive_mode <= 3); }
+
+    // Sensor current and voltage from RAW_DATA (updated every 250 ms in drive mode 4).
+    struct RawData {
+        uint8_t current_ua;     // 0..63 uA
+        uint16_t voltage_adc;   // 10 bit, 1023 = 1.65 V
+    };
+
+    // Reads RAW_DATA if DATA_READY is set. Returns 1 (new sample), 0 (not ready) or -1.
+    int read_raw_data(RawData &raw);
+
+    // Versions of the sensor, read by the start.
+    struct Identity {
+        uint8_t hw_id;
+        uint8_t hw_version;
+        uint8_t fw_app_version[2];
+    };
+
+    const Identity &get_identity() const { return identity; }
+
+    // BASELINE of the latest good measurement. Returns false if there is none yet.
+    bool get_baseline(uint8_t *bl) const {
+        memcpy(bl, baseline, sizeof(baseline));
+        return (baseline[0] != 0) || (baseline[1] != 0);
+    }
+
+    // Writes a saved BASELINE to the sensor, e.g. after a restart, so the algorithm does not
+    // have to learn it again. Returns 0 on success, -1 on error.
+    int restore_baseline(const uint8_t *bl);
+
+    static void decode_raw_data(const uint8_t *data, RawData &raw) {
+        raw.current_ua = data[0] >> 2;
+        raw.voltage_adc = (uint16_t) (((data[0] & 0x03) << 8) | data[1]);
+    }
+
+    // Asserts nINT whenever a new result is ready (INT_DATARDY in MEAS_MODE), so the result
+    // can be read on the falling edge instead of by polling the status.
+    int set_data_ready_interrupt(bool enable);
+
+    // Number of mailbox writes suppressed because the mailbox already held the value.
+    uint32_t get_suppressed_transactions();
+
     struct MailboxInfo {
         uint8_t id;
         size_t size;
@@ -60,15 +119,45 @@ public:
 
     uint8_t verbose = 0;
 
+    // Decodes eCO2 and TVOC from the first 4 bytes of ALG_RESULT_DATA (big endian).
+    static void decode_alg_result(const uint8_t *data, uint16_t &co2, uint16_t &tvoc) {
+        co2 = (data[0] << 8) | data[1];
+        tvoc = (data[2] << 8) | data[3];
+
+        // Mask out the 16th bit from measurements. Sensor can randomly set values with the 16th bit set.
+        co2 &= ~(1 << 15);
+        tvoc &= ~(1 << 15);
+    }
+
 private:
-    const std::string i2c_dev_name;
+    I2CTransport &bus;
     const uint8_t ccs811_addr;
-    int i2c_fd = -1;
     time_t last_measurement = 0;
     uint16_t co2 = 0;
     uint16_t tvoc = 0;
+    uint8_t drive_mode;
     uint8_t measurement_mode[1] = {0x00};
+    bool data_ready_interrupt = false;
     uint8_t baseline[2] = {0x00, 0x00};
+    Identity identity = {0x00, 0x00, {0x00, 0x00}};
+    RegisterShadow<1> meas_mode_shadow;
+    RegisterShadow<4> env_data_shadow;
+    uint32_t suppressed_transactions = 0;
+
+    enum MeasurementPhase {
+        IDLE,
+        READ_STATUS
+    } phase = IDLE;
+    int polls_left = 0;
+
+    enum Timing : uint32_t {
+        APP_START_TIME_MYS = 62500,     // switch from boot loader to application firmware (max)
+        APP_START_POLL_INTERVAL_MYS = 1000,
+        READY_POLL_INTERVAL_MYS = 10000
+    };
+
+    // How long a measurement may poll for DATA_READY in the configured drive mode.
+    uint32_t ready_poll_budget_mys();
 
     MailboxInfo mailbox_info(Mailbox m) {
         // These values should correspond to the Mailbox values above.
@@ -108,23 +197,35 @@ private:
 
     int init();
 
-    void open_device();
+    // Polls FW_MODE after APP_START. Returns 0 or -1 if the application did not start.
+    int wait_app_started();
 
     int set_measurement_mode();
     
-    int read_baseline();
-
     int write_baseline();
 
-    std::unique_ptr<std::vector<uint8_t>> read_mailbox(Mailbox m, uint32_t delay_mys=62500);
+    // Reads mailbox m into buffer (at least the size of the mailbox).
+    // Returns the number of bytes read or -1 on error.
+    // The mailboxes need no conversion time, delay_mys is only an optional settle time.
+    int read_mailbox(Mailbox m, uint8_t *buffer, size_t buffer_len, uint32_t delay_mys=0);
+
+    template<size_t N>
+    int read_mailbox(Mailbox m, uint8_t (&buffer)[N], uint32_t delay_mys=0) {
+        return read_mailbox(m, buffer, N, delay_mys);
+    }
+
+    // The two halves of read_mailbox(): select the mailbox, read it after the delay.
+    int select_mailbox(Mailbox m);
+
+    int fetch_mailbox(Mailbox m, uint8_t *buffer, size_t buffer_len);
+
+    int abort_measurement();
 
     int write_to_mailbox(Mailbox m, uint8_t *buffer, size_t buffer_len);
 
     int write_data(uint8_t *buffer, size_t buffer_len);
 
     int version_to_str(uint8_t version, char *buffer);
-
-    void close_device() const;
 };
 
 
@@ -0,0 +1,79 @@
+#include "ChannelRegistry.h"
+
+#include <cstring>
+
+size_t ChannelRegistry::add(const ChannelSpec &spec) {
+    uint32_t channel = (uint32_t) specs.size();
+
+    specs.push_back(spec);
+    raw.push_back(0);
+    values.push_back(0);
+    stamps.push_back(0);
+    flags.push_back(0);
+    pending.push_back(0);
+    rejected.push_back(0);
+
+    switch (spec.filter) {
+        case CHANNEL_MEDIAN:
+            median.push_back(MedianFilter(Median<5>()));
+            median_channels.push_back(channel);
+            break;
+        case CHANNEL_GATED:
+            gated.push_back(GatedFilter(ToleranceGate(spec.tolerance, spec.timeout)));
+            gated_channels.push_back(channel);
+            break;
+        case CHANNEL_SMOOTHED:
+            smoothed.push_back(SmoothedFilter(ToleranceGate(spec.tolerance, spec.timeout), Median<5>(), Ema<1, 4>()));
+            smoothed_channels.push_back(channel);
+            break;
+        default:
+            raw_channels.push_back(channel);
+            break;
+    }
+    return channel;
+}
+
+template<class Filter>
+void ChannelRegistry::sweep(std::vector<Filter> &filters, const std::vector<uint32_t> &channels, time_t now) {
+    for (size_t i = 0; i < filters.size(); i++) {
+        uint32_t channel = channels[i];
+        if (!pending[channel]) {
+            continue;
+        }
+        uint64_t dropped = filters[i].get_rejected();
+        filters[i].set(raw[channel], now);
+        if (filters[i].get_rejected() != dropped) {
+            flags[channel] |= CHANNEL_REJECTED;
+            rejected[channel]++;
+        } else {
+            flags[channel] = (uint8_t) ((flags[channel] & ~CHANNEL_REJECTED) | CHANNEL_VALID);
+            values[channel] = filters[i].get();
+            stamps[channel] = now;
+        }
+    }
+}
+
+void ChannelRegistry::update(time_t now) {
+    for (uint32_t channel : raw_channels) {
+        if (pending[channel]) {
+            values[channel] = raw[channel];
+            stamps[channel] = now;
+            flags[channel] |= CHANNEL_VALID;
+        }
+    }
+    sweep(median, median_channels, now);
+    sweep(gated, gated_channels, now);
+    sweep(smoothed, smoothed_channels, now);
+
+    // the cycle is complete: clear the inputs and the failures of the channels which got input
+    for (size_t channel = 0; channel < pending.size(); channel++) {
+        if (pending[channel]) {
+            flags[channel] &= (uint8_t) ~CHANNEL_FAILED;
+        }
+        pending[channel] = 0;
+    }
+}
+
+void ChannelRegistry::copy_values(size_t first, size_t count, double *out) const {
+    memcpy(out, values.data() + first, count * sizeof(double));
+}
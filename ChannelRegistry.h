@@ -0,0 +1,99 @@
+#ifndef IAQ_CHANNEL_REGISTRY_H
+#define IAQ_CHANNEL_REGISTRY_H
+
+#include "FilterPipeline.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+// Filter of a channel.
+enum ChannelFilter : uint8_t {
+    CHANNEL_RAW,        // no filter
+    CHANNEL_MEDIAN,     // Median<5>
+    CHANNEL_GATED,      // ToleranceGate
+    CHANNEL_SMOOTHED    // ToleranceGate, Median<5>, Ema<1, 4>
+};
+
+enum ChannelFlags : uint8_t {
+    CHANNEL_VALID = 1,      // a value has been accepted
+    CHANNEL_REJECTED = 2,   // the last input was dropped by the filter
+    CHANNEL_FAILED = 4      // the last reading of the sensor failed
+};
+
+// Static description of a channel.
+struct ChannelSpec {
+    const char *name;
+    ChannelFilter filter;
+    double tolerance;       // of the ToleranceGate (0: accept all)
+    time_t timeout;         // of the ToleranceGate (0: never initialise again)
+};
+
+// All measured quantities (channels) of a measurement worker, stored as structure of arrays:
+// inputs, filtered values, time stamps and flags are contiguous arrays indexed by channel,
+// the filter states are contiguous arrays per filter type. A measurement cycle stores the
+// raw inputs and then updates all channels in one sweep per filter type; the values of
+// consecutive channels (e.g. all channels of a board) can be copied in one block.
+class ChannelRegistry {
+public:
+    typedef Pipeline<Median<5> > MedianFilter;
+    typedef Pipeline<ToleranceGate> GatedFilter;
+    typedef Pipeline<ToleranceGate, Median<5>, Ema<1, 4> > SmoothedFilter;
+
+    // Adds a channel; returns its index. Channels are numbered consecutively.
+    size_t add(const ChannelSpec &spec);
+
+    size_t size() const { return specs.size(); }
+
+    const ChannelSpec &spec(size_t channel) const { return specs[channel]; }
+
+    // Raw input of the current cycle. Channels without input keep their value.
+    void input(size_t channel, double x) {
+        raw[channel] = x;
+        pending[channel] = 1;
+    }
+
+    // The sensor of the channel could not be read in the current cycle.
+    void input_failed(size_t channel) { flags[channel] |= CHANNEL_FAILED; }
+
+    // Filters the inputs of the cycle, all taken at time now.
+    void update(time_t now);
+
+    double value(size_t channel) const { return values[channel]; }
+
+    time_t time(size_t channel) const { return (time_t) stamps[channel]; }
+
+    uint8_t get_flags(size_t channel) const { return flags[channel]; }
+
+    // Inputs dropped by the filter of the channel.
+    uint64_t get_rejected(size_t channel) const { return rejected[channel]; }
+
+    // Copies the values of count consecutive channels starting with first.
+    void copy_values(size_t first, size_t count, double *out) const;
+
+private:
+    std::vector<ChannelSpec> specs;
+
+    // by channel
+    std::vector<double> raw;
+    std::vector<double> values;
+    std::vector<int64_t> stamps;    // time of the last accepted input
+    std::vector<uint8_t> flags;
+    std::vector<uint8_t> pending;
+    std::vector<uint64_t> rejected;
+
+    // filter states by type, each with the channel it belongs to
+    std::vector<uint32_t> raw_channels;
+    std::vector<MedianFilter> median;
+    std::vector<uint32_t> median_channels;
+    std::vector<GatedFilter> gated;
+    std::vector<uint32_t> gated_channels;
+    std::vector<SmoothedFilter> smoothed;
+    std::vector<uint32_t> smoothed_channels;
+
+    template<class Filter>
+    void sweep(std::vector<Filter> &filters, const std::vector<uint32_t> &channels, time_t now);
+};
+
+#endif //IAQ_CHANNEL_REGISTRY_H
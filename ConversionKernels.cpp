@@ -0,0 +1,383 @@
+#include "ConversionKernels.h"
+
+#include "CCS811.h"
+#include "HDC1080.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define CONVERSION_KERNELS_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define CONVERSION_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+// The vector code below repeats the expressions of the scalar functions operation by
+// operation (no reassociation, no fused multiply-add, see -ffp-contract=off in
+// CMakeLists.txt). Constant sub-expressions that only depend on the calibration are
+// computed once with the same scalar operation as in the per-sample code.
+
+namespace {
+
+#ifndef BMP280_INTEGER_COMPENSATION
+
+// Calibration dependent terms of the double compensation.
+struct DoubleTerms {
+    double T1_1024, T1_8192, T2, T3;
+    double P1, P2, P3, P4_65536, P5, P6, P7, P8, P9;
+
+    explicit DoubleTerms(const BMP280Calibration &cal)
+            : T1_1024(((double) cal.dig_T1) / 1024.0), T1_8192(((double) cal.dig_T1) / 8192.0),
+              T2((double) cal.dig_T2), T3((double) cal.dig_T3),
+              P1((double) cal.dig_P1), P2((double) cal.dig_P2), P3((double) cal.dig_P3),
+              P4_65536(((double) cal.dig_P4) * 65536.0), P5((double) cal.dig_P5), P6((double) cal.dig_P6),
+              P7((double) cal.dig_P7), P8((double) cal.dig_P8), P9((double) cal.dig_P9) {
+    }
+};
+
+#endif
+
+void bmp280_compensate_scalar(const BMP280Calibration &cal, const int32_t *adc_T, const int32_t *adc_P,
+                              size_t begin, size_t n, double *temperature, double *pressure) {
+    int32_t t_fine;
+    for (size_t i = begin; i < n; i++) {
+        temperature[i] = BMP280Compensation::temperature(cal, adc_T[i], t_fine);
+        pressure[i] = BMP280Compensation::pressure(cal, adc_P[i], t_fine);
+    }
+}
+
+void hdc1080_convert_scalar(const uint16_t *raw_T, const uint16_t *raw_H, size_t begin, size_t n,
+                            float *temperature, float *humidity) {
+    for (size_t i = begin; i < n; i++) {
+        temperature[i] = HDC1080::temperature_from_raw(raw_T[i]);
+        humidity[i] = HDC1080::humidity_from_raw(raw_H[i]);
+    }
+}
+
+void ccs811_unpack_scalar(const uint8_t *alg_result_data, size_t begin, size_t n, uint16_t *co2, uint16_t *tvoc) {
+    for (size_t i = begin; i < n; i++) {
+        CCS811::decode_alg_result(alg_result_data + 8 * i, co2[i], tvoc[i]);
+    }
+}
+
+#ifdef CONVERSION_KERNELS_X86
+
+bool has_avx2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+#ifndef BMP280_INTEGER_COMPENSATION
+
+// 2 samples per step
+size_t bmp280_compensate_sse2(const BMP280Calibration &cal, const int32_t *adc_T, const int32_t *adc_P, size_t n,
+                              double *temperature, double *pressure) {
+    const DoubleTerms k(cal);
+    const __m128d zero = _mm_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        __m128d t = _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(adc_T + i)));
+        __m128d var1 = _mm_mul_pd(_mm_sub_pd(_mm_div_pd(t, _mm_set1_pd(16384.0)), _mm_set1_pd(k.T1_1024)),
+                                  _mm_set1_pd(k.T2));
+        __m128d d = _mm_sub_pd(_mm_div_pd(t, _mm_set1_pd(131072.0)), _mm_set1_pd(k.T1_8192));
+        __m128d var2 = _mm_mul_pd(_mm_mul_pd(d, d), _mm_set1_pd(k.T3));
+        __m128i t_fine = _mm_cvttpd_epi32(_mm_add_pd(var1, var2));
+        __m128d t_fine_d = _mm_cvtepi32_pd(t_fine);
+        _mm_storeu_pd(temperature + i, _mm_div_pd(t_fine_d, _mm_set1_pd(5120.0)));
+
+        var1 = _mm_sub_pd(_mm_div_pd(t_fine_d, _mm_set1_pd(2.0)), _mm_set1_pd(64000.0));
+        var2 = _mm_div_pd(_mm_mul_pd(_mm_mul_pd(var1, var1), _mm_set1_pd(k.P6)), _mm_set1_pd(32768.0));
+        var2 = _mm_add_pd(var2, _mm_mul_pd(_mm_mul_pd(var1, _mm_set1_pd(k.P5)), _mm_set1_pd(2.0)));
+        var2 = _mm_add_pd(_mm_div_pd(var2, _mm_set1_pd(4.0)), _mm_set1_pd(k.P4_65536));
+        var1 = _mm_div_pd(_mm_add_pd(_mm_div_pd(_mm_mul_pd(_mm_mul_pd(_mm_set1_pd(k.P3), var1), var1),
+                                                _mm_set1_pd(524288.0)),
+                                     _mm_mul_pd(_mm_set1_pd(k.P2), var1)),
+                          _mm_set1_pd(524288.0));
+        var1 = _mm_mul_pd(_mm_add_pd(_mm_set1_pd(1.0), _mm_div_pd(var1, _mm_set1_pd(32768.0))), _mm_set1_pd(k.P1));
+        __m128d invalid = _mm_cmpeq_pd(var1, zero);
+        __m128d p = _mm_sub_pd(_mm_set1_pd(1048576.0),
+                               _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(adc_P + i))));
+        p = _mm_div_pd(_mm_mul_pd(_mm_sub_pd(p, _mm_div_pd(var2, _mm_set1_pd(4096.0))), _mm_set1_pd(6250.0)), var1);
+        var1 = _mm_div_pd(_mm_mul_pd(_mm_mul_pd(_mm_set1_pd(k.P9), p), p), _mm_set1_pd(2147483648.0));
+        var2 = _mm_div_pd(_mm_mul_pd(p, _mm_set1_pd(k.P8)), _mm_set1_pd(32768.0));
+        p = _mm_div_pd(_mm_add_pd(p, _mm_div_pd(_mm_add_pd(_mm_add_pd(var1, var2), _mm_set1_pd(k.P7)),
+                                                _mm_set1_pd(16.0))),
+                       _mm_set1_pd(100.0));
+        _mm_storeu_pd(pressure + i, _mm_andnot_pd(invalid, p));
+    }
+    return i;
+}
+
+// 4 samples per step
+__attribute__((target("avx2")))
+size_t bmp280_compensate_avx2(const BMP280Calibration &cal, const int32_t *adc_T, const int32_t *adc_P, size_t n,
+                              double *temperature, double *pressure) {
+    const DoubleTerms k(cal);
+    const __m256d zero = _mm256_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m256d t = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(adc_T + i)));
+        __m256d var1 = _mm256_mul_pd(_mm256_sub_pd(_mm256_div_pd(t, _mm256_set1_pd(16384.0)),
+                                                   _mm256_set1_pd(k.T1_1024)),
+                                     _mm256_set1_pd(k.T2));
+        __m256d d = _mm256_sub_pd(_mm256_div_pd(t, _mm256_set1_pd(131072.0)), _mm256_set1_pd(k.T1_8192));
+        __m256d var2 = _mm256_mul_pd(_mm256_mul_pd(d, d), _mm256_set1_pd(k.T3));
+        __m128i t_fine = _mm256_cvttpd_epi32(_mm256_add_pd(var1, var2));
+        __m256d t_fine_d = _mm256_cvtepi32_pd(t_fine);
+        _mm256_storeu_pd(temperature + i, _mm256_div_pd(t_fine_d, _mm256_set1_pd(5120.0)));
+
+        var1 = _mm256_sub_pd(_mm256_div_pd(t_fine_d, _mm256_set1_pd(2.0)), _mm256_set1_pd(64000.0));
+        var2 = _mm256_div_pd(_mm256_mul_pd(_mm256_mul_pd(var1, var1), _mm256_set1_pd(k.P6)),
+                             _mm256_set1_pd(32768.0));
+        var2 = _mm256_add_pd(var2, _mm256_mul_pd(_mm256_mul_pd(var1, _mm256_set1_pd(k.P5)), _mm256_set1_pd(2.0)));
+        var2 = _mm256_add_pd(_mm256_div_pd(var2, _mm256_set1_pd(4.0)), _mm256_set1_pd(k.P4_65536));
+        var1 = _mm256_div_pd(_mm256_add_pd(_mm256_div_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(k.P3), var1),
+                                                                       var1),
+                                                         _mm256_set1_pd(524288.0)),
+                                           _mm256_mul_pd(_mm256_set1_pd(k.P2), var1)),
+                             _mm256_set1_pd(524288.0));
+        var1 = _mm256_mul_pd(_mm256_add_pd(_mm256_set1_pd(1.0), _mm256_div_pd(var1, _mm256_set1_pd(32768.0))),
+                             _mm256_set1_pd(k.P1));
+        __m256d invalid = _mm256_cmp_pd(var1, zero, _CMP_EQ_OQ);
+        __m256d p = _mm256_sub_pd(_mm256_set1_pd(1048576.0),
+                                  _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(adc_P + i))));
+        p = _mm256_div_pd(_mm256_mul_pd(_mm256_sub_pd(p, _mm256_div_pd(var2, _mm256_set1_pd(4096.0))),
+                                        _mm256_set1_pd(6250.0)),
+                          var1);
+        var1 = _mm256_div_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(k.P9), p), p),
+                             _mm256_set1_pd(2147483648.0));
+        var2 = _mm256_div_pd(_mm256_mul_pd(p, _mm256_set1_pd(k.P8)), _mm256_set1_pd(32768.0));
+        p = _mm256_div_pd(_mm256_add_pd(p, _mm256_div_pd(_mm256_add_pd(_mm256_add_pd(var1, var2),
+                                                                       _mm256_set1_pd(k.P7)),
+                                                         _mm256_set1_pd(16.0))),
+                          _mm256_set1_pd(100.0));
+        _mm256_storeu_pd(pressure + i, _mm256_andnot_pd(invalid, p));
+    }
+    return i;
+}
+
+#endif
+
+// 8 samples per step
+size_t hdc1080_convert_sse2(const uint16_t *raw_T, const uint16_t *raw_H, size_t n,
+                            float *temperature, float *humidity) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(raw_T + i));
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(raw_H + i));
+        __m128 t_lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(t, zero));
+        __m128 t_hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(t, zero));
+        __m128 h_lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(h, zero));
+        __m128 h_hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(h, zero));
+
+        t_lo = _mm_sub_ps(_mm_div_ps(_mm_mul_ps(t_lo, _mm_set1_ps(165)), _mm_set1_ps(65536)), _mm_set1_ps(40));
+        t_hi = _mm_sub_ps(_mm_div_ps(_mm_mul_ps(t_hi, _mm_set1_ps(165)), _mm_set1_ps(65536)), _mm_set1_ps(40));
+        h_lo = _mm_div_ps(_mm_mul_ps(h_lo, _mm_set1_ps(100)), _mm_set1_ps(65536));
+        h_hi = _mm_div_ps(_mm_mul_ps(h_hi, _mm_set1_ps(100)), _mm_set1_ps(65536));
+
+        _mm_storeu_ps(temperature + i, t_lo);
+        _mm_storeu_ps(temperature + i + 4, t_hi);
+        _mm_storeu_ps(humidity + i, h_lo);
+        _mm_storeu_ps(humidity + i + 4, h_hi);
+    }
+    return i;
+}
+
+// 8 samples per step
+__attribute__((target("avx2")))
+size_t hdc1080_convert_avx2(const uint16_t *raw_T, const uint16_t *raw_H, size_t n,
+                            float *temperature, float *humidity) {
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 t = _mm256_cvtepi32_ps(
+                _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(raw_T + i))));
+        __m256 h = _mm256_cvtepi32_ps(
+                _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(raw_H + i))));
+
+        t = _mm256_sub_ps(_mm256_div_ps(_mm256_mul_ps(t, _mm256_set1_ps(165)), _mm256_set1_ps(65536)),
+                          _mm256_set1_ps(40));
+        h = _mm256_div_ps(_mm256_mul_ps(h, _mm256_set1_ps(100)), _mm256_set1_ps(65536));
+
+        _mm256_storeu_ps(temperature + i, t);
+        _mm256_storeu_ps(humidity + i, h);
+    }
+    return i;
+}
+
+// Byte swaps the 16 bit words of 2 records and packs their first two words into the low half.
+inline __m128i ccs811_load_pairs(const uint8_t *records) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(records));
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    return _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// 8 records per step
+size_t ccs811_unpack_sse2(const uint8_t *alg_result_data, size_t n, uint16_t *co2, uint16_t *tvoc) {
+    const __m128i mask = _mm_set1_epi16(0x7fff);
+    const __m128i low_word = _mm_set1_epi32(0xffff);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        const uint8_t *records = alg_result_data + 8 * i;
+        // co2/tvoc pairs of records 0..3 and 4..7
+        __m128i a = _mm_unpacklo_epi64(ccs811_load_pairs(records), ccs811_load_pairs(records + 16));
+        __m128i b = _mm_unpacklo_epi64(ccs811_load_pairs(records + 32), ccs811_load_pairs(records + 48));
+        a = _mm_and_si128(a, mask);
+        b = _mm_and_si128(b, mask);
+
+        // all values are < 0x8000, the signed saturation of packs does not apply
+        __m128i c = _mm_packs_epi32(_mm_and_si128(a, low_word), _mm_and_si128(b, low_word));
+        __m128i t = _mm_packs_epi32(_mm_srli_epi32(a, 16), _mm_srli_epi32(b, 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(co2 + i), c);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(tvoc + i), t);
+    }
+    return i;
+}
+
+#endif //CONVERSION_KERNELS_X86
+
+#ifdef CONVERSION_KERNELS_NEON
+
+#ifndef BMP280_INTEGER_COMPENSATION
+
+// 2 samples per step
+size_t bmp280_compensate_neon(const BMP280Calibration &cal, const int32_t *adc_T, const int32_t *adc_P, size_t n,
+                              double *temperature, double *pressure) {
+    const DoubleTerms k(cal);
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        float64x2_t t = vcvtq_f64_s64(vmovl_s32(vld1_s32(adc_T + i)));
+        float64x2_t var1 = vmulq_f64(vsubq_f64(vdivq_f64(t, vdupq_n_f64(16384.0)), vdupq_n_f64(k.T1_1024)),
+                                     vdupq_n_f64(k.T2));
+        float64x2_t d = vsubq_f64(vdivq_f64(t, vdupq_n_f64(131072.0)), vdupq_n_f64(k.T1_8192));
+        float64x2_t var2 = vmulq_f64(vmulq_f64(d, d), vdupq_n_f64(k.T3));
+        int32x2_t t_fine = vmovn_s64(vcvtq_s64_f64(vaddq_f64(var1, var2)));
+        float64x2_t t_fine_d = vcvtq_f64_s64(vmovl_s32(t_fine));
+        vst1q_f64(temperature + i, vdivq_f64(t_fine_d, vdupq_n_f64(5120.0)));
+
+        var1 = vsubq_f64(vdivq_f64(t_fine_d, vdupq_n_f64(2.0)), vdupq_n_f64(64000.0));
+        var2 = vdivq_f64(vmulq_f64(vmulq_f64(var1, var1), vdupq_n_f64(k.P6)), vdupq_n_f64(32768.0));
+        var2 = vaddq_f64(var2, vmulq_f64(vmulq_f64(var1, vdupq_n_f64(k.P5)), vdupq_n_f64(2.0)));
+        var2 = vaddq_f64(vdivq_f64(var2, vdupq_n_f64(4.0)), vdupq_n_f64(k.P4_65536));
+        var1 = vdivq_f64(vaddq_f64(vdivq_f64(vmulq_f64(vmulq_f64(vdupq_n_f64(k.P3), var1), var1),
+                                             vdupq_n_f64(524288.0)),
+                                   vmulq_f64(vdupq_n_f64(k.P2), var1)),
+                         vdupq_n_f64(524288.0));
+        var1 = vmulq_f64(vaddq_f64(vdupq_n_f64(1.0), vdivq_f64(var1, vdupq_n_f64(32768.0))), vdupq_n_f64(k.P1));
+        uint64x2_t invalid = vceqq_f64(var1, vdupq_n_f64(0.0));
+        float64x2_t p = vsubq_f64(vdupq_n_f64(1048576.0), vcvtq_f64_s64(vmovl_s32(vld1_s32(adc_P + i))));
+        p = vdivq_f64(vmulq_f64(vsubq_f64(p, vdivq_f64(var2, vdupq_n_f64(4096.0))), vdupq_n_f64(6250.0)), var1);
+        var1 = vdivq_f64(vmulq_f64(vmulq_f64(vdupq_n_f64(k.P9), p), p), vdupq_n_f64(2147483648.0));
+        var2 = vdivq_f64(vmulq_f64(p, vdupq_n_f64(k.P8)), vdupq_n_f64(32768.0));
+        p = vdivq_f64(vaddq_f64(p, vdivq_f64(vaddq_f64(vaddq_f64(var1, var2), vdupq_n_f64(k.P7)),
+                                             vdupq_n_f64(16.0))),
+                      vdupq_n_f64(100.0));
+        vst1q_f64(pressure + i, vbslq_f64(invalid, vdupq_n_f64(0.0), p));
+    }
+    return i;
+}
+
+#endif
+
+// 8 samples per step
+size_t hdc1080_convert_neon(const uint16_t *raw_T, const uint16_t *raw_H, size_t n,
+                            float *temperature, float *humidity) {
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t t = vld1q_u16(raw_T + i);
+        uint16x8_t h = vld1q_u16(raw_H + i);
+        float32x4_t t_lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(t)));
+        float32x4_t t_hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(t)));
+        float32x4_t h_lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(h)));
+        float32x4_t h_hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(h)));
+
+        t_lo = vsubq_f32(vdivq_f32(vmulq_f32(t_lo, vdupq_n_f32(165)), vdupq_n_f32(65536)), vdupq_n_f32(40));
+        t_hi = vsubq_f32(vdivq_f32(vmulq_f32(t_hi, vdupq_n_f32(165)), vdupq_n_f32(65536)), vdupq_n_f32(40));
+        h_lo = vdivq_f32(vmulq_f32(h_lo, vdupq_n_f32(100)), vdupq_n_f32(65536));
+        h_hi = vdivq_f32(vmulq_f32(h_hi, vdupq_n_f32(100)), vdupq_n_f32(65536));
+
+        vst1q_f32(temperature + i, t_lo);
+        vst1q_f32(temperature + i + 4, t_hi);
+        vst1q_f32(humidity + i, h_lo);
+        vst1q_f32(humidity + i + 4, h_hi);
+    }
+    return i;
+}
+
+// 8 records per step
+size_t ccs811_unpack_neon(const uint8_t *alg_result_data, size_t n, uint16_t *co2, uint16_t *tvoc) {
+    const uint16x8_t mask = vdupq_n_u16(0x7fff);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        // val[0]: eCO2 words, val[1]: TVOC words of the 8 records
+        uint16x8x4_t words = vld4q_u16(reinterpret_cast<const uint16_t *>(alg_result_data + 8 * i));
+        uint16x8_t c = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(words.val[0])));
+        uint16x8_t t = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(words.val[1])));
+        vst1q_u16(co2 + i, vandq_u16(c, mask));
+        vst1q_u16(tvoc + i, vandq_u16(t, mask));
+    }
+    return i;
+}
+
+#endif //CONVERSION_KERNELS_NEON
+
+}
+
+void bmp280_compensate_batch(const BMP280Calibration &cal, const int32_t *adc_T, const int32_t *adc_P, size_t n,
+                             double *temperature, double *pressure) {
+    size_t done = 0;
+#ifndef BMP280_INTEGER_COMPENSATION
+#if defined(CONVERSION_KERNELS_X86)
+    if (has_avx2()) {
+        done = bmp280_compensate_avx2(cal, adc_T, adc_P, n, temperature, pressure);
+    } else {
+        done = bmp280_compensate_sse2(cal, adc_T, adc_P, n, temperature, pressure);
+    }
+#elif defined(CONVERSION_KERNELS_NEON)
+    done = bmp280_compensate_neon(cal, adc_T, adc_P, n, temperature, pressure);
+#endif
+#endif
+    bmp280_compensate_scalar(cal, adc_T, adc_P, done, n, temperature, pressure);
+}
+
+void hdc1080_convert_batch(const uint16_t *raw_T, const uint16_t *raw_H, size_t n,
+                           float *temperature, float *humidity) {
+    size_t done = 0;
+#if defined(CONVERSION_KERNELS_X86)
+    if (has_avx2()) {
+        done = hdc1080_convert_avx2(raw_T, raw_H, n, temperature, humidity);
+    } else {
+        done = hdc1080_convert_sse2(raw_T, raw_H, n, temperature, humidity);
+    }
+#elif defined(CONVERSION_KERNELS_NEON)
+    done = hdc1080_convert_neon(raw_T, raw_H, n, temperature, humidity);
+#endif
+    hdc1080_convert_scalar(raw_T, raw_H, done, n, temperature, humidity);
+}
+
+void ccs811_unpack_batch(const uint8_t *alg_result_data, size_t n, uint16_t *co2, uint16_t *tvoc) {
+    size_t done = 0;
+#if defined(CONVERSION_KERNELS_X86)
+    done = ccs811_unpack_sse2(alg_result_data, n, co2, tvoc);
+#elif defined(CONVERSION_KERNELS_NEON)
+    done = ccs811_unpack_neon(alg_result_data, n, co2, tvoc);
+#endif
+    ccs811_unpack_scalar(alg_result_data, done, n, co2, tvoc);
+}
+
+const char *conversion_kernels_isa() {
+#if defined(CONVERSION_KERNELS_X86)
+    return has_avx2() ? "avx2" : "sse2";
+#elif defined(CONVERSION_KERNELS_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,36 @@
+#ifndef IAQ_CONVERSION_KERNELS_H
+#define IAQ_CONVERSION_KERNELS_H
+
+#include "BMP280Compensation.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Array-at-a-time versions of the per-sample conversions of the drivers, for reprocessing
+// logged raw data or converting the samples of many boards at once.
+//
+// The results are bit-identical to the per-sample functions (BMP280Compensation,
+// HDC1080::temperature_from_raw/humidity_from_raw, CCS811::decode_alg_result): the vector
+// code performs the same operations in the same order, only on several samples at once.
+// The best instruction set is selected at runtime on x86-64 (AVX2, otherwise SSE2) and at
+// compile time on ARM (NEON); other targets and the tails of the arrays use the scalar code.
+// Input and output arrays must not overlap.
+
+// Temperature (DegC) and pressure (hPa) of n raw BMP280 samples, using BMP280Compensation.
+// The integer compensation (BMP280_INTEGER_COMPENSATION) needs a 64 bit division per
+// sample and is always computed with the scalar code.
+void bmp280_compensate_batch(const BMP280Calibration &cal, const int32_t *adc_T, const int32_t *adc_P, size_t n,
+                             double *temperature, double *pressure);
+
+// Temperature (DegC) and relative humidity (%) of n raw HDC1080 samples.
+void hdc1080_convert_batch(const uint16_t *raw_T, const uint16_t *raw_H, size_t n,
+                           float *temperature, float *humidity);
+
+// eCO2 (ppm) and TVOC (ppb) of n CCS811 ALG_RESULT_DATA records of 8 bytes each, as read
+// from the sensor (only the first 4 bytes of every record are used).
+void ccs811_unpack_batch(const uint8_t *alg_result_data, size_t n, uint16_t *co2, uint16_t *tvoc);
+
+// Name of the instruction set used by the kernels on this machine ("avx2", "sse2", "neon", "scalar").
+const char *conversion_kernels_isa();
+
+#endif //IAQ_CONVERSION_KERNELS_H
@@ -0,0 +1,75 @@
+#ifndef IAQ_COUNTING_I2C_H
+#define IAQ_COUNTING_I2C_H
+
+#include "I2CTransport.h"
+
+#include <atomic>
+#include <memory>
+
+// Passes all calls to another transport and counts them per slave address (for the metrics
+// of the daemon). The counters are updated by the thread using the bus and may be read by
+// any other thread at any time.
+class CountingI2C : public I2CTransport {
+public:
+    struct Counters {
+        std::atomic<uint64_t> transactions{0};
+        std::atomic<uint64_t> bytes_written{0};
+        std::atomic<uint64_t> bytes_read{0};
+        std::atomic<uint64_t> write_failures{0};    // write()
+        std::atomic<uint64_t> read_failures{0};     // read() and write_read()
+    };
+
+    explicit CountingI2C(std::unique_ptr<I2CTransport> bus) : bus(std::move(bus)) {}
+
+    ssize_t write(uint8_t addr, const uint8_t *buffer, size_t buffer_len) override {
+        ssize_t ret = bus->write(addr, buffer, buffer_len);
+        Counters &c = stats[addr & 0x7f];
+        add(c.transactions, 1);
+        if (ret < 0) {
+            add(c.write_failures, 1);
+        } else {
+            add(c.bytes_written, (uint64_t) ret);
+        }
+        return ret;
+    }
+
+    ssize_t read(uint8_t addr, uint8_t *buffer, size_t buffer_len) override {
+        ssize_t ret = bus->read(addr, buffer, buffer_len);
+        Counters &c = stats[addr & 0x7f];
+        add(c.transactions, 1);
+        if (ret < 0) {
+            add(c.read_failures, 1);
+        } else {
+            add(c.bytes_read, (uint64_t) ret);
+        }
+        return ret;
+    }
+
+    ssize_t write_read(uint8_t addr, const uint8_t *write_buffer, size_t write_len,
+                       uint8_t *read_buffer, size_t read_len) override {
+        ssize_t ret = bus->write_read(addr, write_buffer, write_len, read_buffer, read_len);
+        Counters &c = stats[addr & 0x7f];
+        add(c.transactions, 1);
+        if (ret < 0) {
+            add(c.read_failures, 1);
+        } else {
+            add(c.bytes_written, write_len);
+            add(c.bytes_read, (uint64_t) ret);
+        }
+        return ret;
+    }
+
+    const Counters &counters(uint8_t addr) const { return stats[addr & 0x7f]; }
+
+    I2CTransport &get_bus() { return *bus; }
+
+private:
+    std::unique_ptr<I2CTransport> bus;
+    Counters stats[128];
+
+    static void add(std::atomic<uint64_t> &counter, uint64_t n) {
+        counter.fetch_add(n, std::memory_order_relaxed);
+    }
+};
+
+#endif //IAQ_COUNTING_I2C_H
@@ -0,0 +1,85 @@
+#include "DataReady.h"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+GpioDataReady::~GpioDataReady() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+int GpioDataReady::open(const char *chip, uint32_t line) {
+    std::string path = (chip[0] == '/') ? chip : std::string("/dev/") + chip;
+    struct gpioevent_request request;
+    int chip_fd;
+
+    chip_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (chip_fd < 0) {
+        return -1;
+    }
+    memset(&request, 0, sizeof(request));
+    request.lineoffset = line;
+    request.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    request.eventflags = GPIOEVENT_REQUEST_FALLING_EDGE;
+    strncpy(request.consumer_label, "cjmcu nINT", sizeof(request.consumer_label) - 1);
+    if (ioctl(chip_fd, GPIO_GET_LINEEVENT_IOCTL, &request) < 0) {
+        int saved_errno = errno;
+        close(chip_fd);
+        errno = saved_errno;
+        return -1;
+    }
+    close(chip_fd);     // the line stays requested through the event fd
+    fd = request.fd;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return 0;
+}
+
+int GpioDataReady::acknowledge() {
+    struct gpioevent_data events[16];
+    int count = 0;
+
+    while (true) {
+        ssize_t ret = read(fd, events, sizeof(events));
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return ((errno == EAGAIN) || (count > 0)) ? count : -1;
+        }
+        count += (int) (ret / sizeof(events[0]));
+        if ((size_t) ret < sizeof(events)) {
+            return count;
+        }
+    }
+}
+
+EventfdDataReady::~EventfdDataReady() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+int EventfdDataReady::open() {
+    fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return (fd < 0) ? -1 : 0;
+}
+
+void EventfdDataReady::signal() {
+    eventfd_write(fd, 1);
+}
+
+int EventfdDataReady::acknowledge() {
+    eventfd_t count;
+
+    if (eventfd_read(fd, &count) < 0) {
+        return (errno == EAGAIN) ? 0 : -1;
+    }
+    return (int) count;
+}
@@ -0,0 +1,48 @@
+#ifndef IAQ_DATA_READY_H
+#define IAQ_DATA_READY_H
+
+#include <cstdint>
+
+// Source of data-ready events for the event loop of a measurement worker: a file descriptor
+// which becomes readable when the sensor has a new result.
+class DataReadySource {
+public:
+    virtual ~DataReadySource() = default;
+
+    int get_fd() const { return fd; }
+
+    // Consumes the pending events. Returns their number (0: nothing pending) or -1.
+    virtual int acknowledge() = 0;
+
+protected:
+    int fd = -1;
+};
+
+// Falling edges of a GPIO line, e.g. the open drain nINT output of the CCS811, which is
+// asserted (low) when a new result is ready. Uses the line event interface of the Linux GPIO
+// character device (/dev/gpiochipN), which all kernels since 4.8 provide.
+class GpioDataReady : public DataReadySource {
+public:
+    ~GpioDataReady() override;
+
+    // chip: "gpiochip0" or "/dev/gpiochip0". Returns -1 with errno set on failure.
+    int open(const char *chip, uint32_t line);
+
+    int acknowledge() override;
+};
+
+// Data ready signalled in software by signal(), e.g. by the simulated CCS811 or a test.
+// Thread safe.
+class EventfdDataReady : public DataReadySource {
+public:
+    ~EventfdDataReady() override;
+
+    // Returns -1 with errno set on failure.
+    int open();
+
+    void signal();
+
+    int acknowledge() override;
+};
+
+#endif //IAQ_DATA_READY_H
@@ -0,0 +1,212 @@
+#ifndef IAQ_FILTER_PIPELINE_H
+#define IAQ_FILTER_PIPELINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <syslog.h>
+#include <tuple>
+#include <type_traits>
+
+// Filter chain for measured values, composed at compile time:
+//
+//   Pipeline<ToleranceGate, Median<5>, Ema<1, 4>> humidity(ToleranceGate(10.0, 600), Median<5>(), Ema<1, 4>());
+//   humidity.set(x, now);
+//   humidity.get();
+//
+// A sample passes the stages in order. Every stage may change it or drop it; a dropped sample
+// (and a NaN) leaves get() at the last output. The cost per sample is constant (no
+// allocation, the stages are inlined).
+//
+// The time stamp of a sample is passed by the caller (e.g. one time stamp per measurement
+// cycle); set(x) without it asks the Clock policy. Diagnostics of the stages go to the Log
+// policy, the default NoLog compiles them away.
+
+// Clock policies: static time_t now().
+struct SystemClock {
+    static time_t now() { return time(nullptr); }
+};
+
+// Log policies: event(stage, message, value, time stamp).
+struct NoLog {
+    void event(const char *, const char *, double, time_t) {}
+};
+
+struct SyslogLog {
+    int priority = LOG_INFO;
+
+    void event(const char *stage, const char *message, double x, time_t now) {
+        syslog(priority, "%s: %s (x=%.2lf, t=%lld)", stage, message, x, (long long) now);
+    }
+};
+
+// Drops samples which differ by more than tolerance from the last accepted one (tolerance 0:
+// accept all), the behaviour of value_check:
+// - during the initialisation phase (init_duration seconds from the first sample) all samples
+//   are accepted,
+// - if no sample was accepted for timeout seconds (0: never), the initialisation phase starts
+//   again.
+class ToleranceGate {
+public:
+    explicit ToleranceGate(double tolerance, time_t timeout = 0, time_t init_duration = 300)
+            : tolerance(tolerance), timeout(timeout), init_duration(init_duration) {}
+
+    template<class Log>
+    bool apply(double &x, time_t now, Log &log) {
+        if (init) {
+            if (!started) {
+                started = true;
+                init_start = now;
+                log.event("ToleranceGate", "startup", x, now);
+            } else if (now - init_start >= init_duration) {
+                init = false;
+                log.event("ToleranceGate", "initialised", x, now);
+            }
+        } else if ((timeout > 0) && (now - accepted_time > timeout)) {
+            init = true;
+            init_start = now;
+            log.event("ToleranceGate", "timeout, initialising again", x, now);
+        }
+
+        if (!init && (tolerance != 0) && ((x - accepted > tolerance) || (accepted - x > tolerance))) {
+            log.event("ToleranceGate", "rejected", x, now);
+            return false;
+        }
+        accepted = x;
+        accepted_time = now;
+        return true;
+    }
+
+    // Starts the initialisation phase again with the next sample.
+    void reset() {
+        init = true;
+        started = false;
+    }
+
+private:
+    double tolerance;
+    time_t timeout;
+    time_t init_duration;
+    bool init = true;
+    bool started = false;
+    time_t init_start = 0;
+    double accepted = 0;
+    time_t accepted_time = 0;
+};
+
+// Median of the last N samples (of the samples so far while fewer than N arrived). The
+// window is kept sorted; a sample costs one removal and one insertion, O(N) with constant N.
+template<size_t N>
+class Median {
+    static_assert((N > 0) && (N % 2 == 1), "N must be odd");
+
+public:
+    template<class Log>
+    bool apply(double &x, time_t, Log &) {
+        if (count == N) {
+            // remove the oldest sample from the sorted window
+            double old = window[next];
+            size_t i = 0;
+            while (sorted[i] != old) {
+                i++;
+            }
+            for (; i + 1 < count; i++) {
+                sorted[i] = sorted[i + 1];
+            }
+            count--;
+        }
+        window[next] = x;
+        next = (next + 1) % N;
+
+        size_t i = count;
+        while ((i > 0) && (sorted[i - 1] > x)) {
+            sorted[i] = sorted[i - 1];
+            i--;
+        }
+        sorted[i] = x;
+        count++;
+
+        x = sorted[count / 2];
+        return true;
+    }
+
+private:
+    double window[N];   // ring in arrival order
+    double sorted[N];
+    size_t next = 0;
+    size_t count = 0;
+};
+
+// Exponential moving average with alpha = Num / Den; the first sample initialises it.
+template<unsigned Num, unsigned Den>
+class Ema {
+    static_assert((Num > 0) && (Num <= Den), "alpha must be in (0, 1]");
+
+public:
+    template<class Log>
+    bool apply(double &x, time_t, Log &) {
+        if (!valid) {
+            valid = true;
+            average = x;
+        } else {
+            average += (x - average) * ((double) Num / Den);
+        }
+        x = average;
+        return true;
+    }
+
+private:
+    double average = 0;
+    bool valid = false;
+};
+
+template<class Clock, class Log, class... Stages>
+class BasicPipeline {
+public:
+    explicit BasicPipeline(Stages... stages, Log log = Log()) : stages(stages...), log(log) {}
+
+    void set(double x) {
+        set(x, Clock::now());
+    }
+
+    void set(double x, time_t now) {
+        if ((x == x) && run<0>(x, now)) {   // NaN is never passed to the stages
+            output = x;
+        } else {
+            rejected++;
+        }
+    }
+
+    // Last output (the last sample which passed all stages).
+    double get() const { return output; }
+
+    // Samples dropped by a stage.
+    uint64_t get_rejected() const { return rejected; }
+
+    template<size_t I>
+    typename std::tuple_element<I, std::tuple<Stages...> >::type &stage() { return std::get<I>(stages); }
+
+private:
+    std::tuple<Stages...> stages;
+    Log log;
+    double output = 0;
+    uint64_t rejected = 0;
+
+    template<size_t I>
+    typename std::enable_if<(I == sizeof...(Stages)), bool>::type run(double &, time_t) {
+        return true;
+    }
+
+    template<size_t I>
+    typename std::enable_if<(I < sizeof...(Stages)), bool>::type run(double &x, time_t now) {
+        return std::get<I>(stages).apply(x, now, log) && run<I + 1>(x, now);
+    }
+};
+
+template<class... Stages>
+using Pipeline = BasicPipeline<SystemClock, NoLog, Stages...>;
+
+template<class... Stages>
+using LoggedPipeline = BasicPipeline<SystemClock, SyslogLog, Stages...>;
+
+#endif //IAQ_FILTER_PIPELINE_H
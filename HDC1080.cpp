@@ -1,28 +1,20 @@
 #include "HDC1080.h"
 
-#include <fcntl.h>
-#include <unistd.h>
+#include <cerrno>
 #include <cstring>
-#include <linux/i2c-dev.h>
-#include <sys/ioctl.h>
 #include <iostream>
 #include <chrono>
 #include <thread>
 
 // #define DBG
 
-HDC1080::HDC1080(std::string i2c_dev_name, uint8_t hdc1080_addr)
-        : i2c_dev_name(std::move(i2c_dev_name)),
+HDC1080::HDC1080(I2CTransport &bus, uint8_t hdc1080_addr)
+        : bus(bus),
           hdc1080_addr(hdc1080_addr) {
-    open_device();
     init();
 }
 
-HDC1080::~HDC1080() {
-    close_device();
-}
-
-void HDC1080::close_device() { if (i2c_fd >= 0) close(i2c_fd); }
+HDC1080::~HDC1080() = default;
 
 void HDC1080::init() {
     uint16_t config;
@@ -54,19 +46,6 @@ void HDC1080::init() {
     }
 }
 
-void HDC1080::open_device() {
-    i2c_fd = open(i2c_dev_name.c_str(), O_RDWR);
-    if (i2c_fd < 0) {
-        std::cerr << "[HDC1080] Unable to open" << i2c_dev_name << ". " << strerror(errno) << std::endl;
-        throw 1;
-    }
-
-    if (ioctl(i2c_fd, I2C_SLAVE, hdc1080_addr) < 0) {
-        std::cerr << "[HDC1080] Failed to communicate with the device. " << strerror(errno) << std::endl;
-        throw 1;
-    }
-}
-
 uint16_t HDC1080::get_device_id() {
     return device_id;
 }
@@ -88,7 +67,9 @@ int HDC1080::write_data(uint8_t *buffer, size_t buffer_len) {
     std::cout << std::endl;
 #endif
 
-    auto write_c = write(i2c_fd, buffer, buffer_len);
+    TraceSpan span("hdc1080 write", Tracer::TRACE_I2C, hdc1080_addr);
+    auto write_c = bus.write(hdc1080_addr, buffer, buffer_len);
+    span.result((int32_t) write_c);
     if (write_c < 0) {
         std::cerr << "Unable to send command. Retcode: " << write_c << std::endl;
         // TODO - Have better exceptions.
@@ -100,30 +81,27 @@ int HDC1080::write_data(uint8_t *buffer, size_t buffer_len) {
     return 0;
 }
 
-std::unique_ptr<std::vector<uint8_t>> HDC1080::read_data(size_t buffer_size) {
-    auto *read_buffer = new uint8_t[buffer_size];
-    auto bytes_read = read(i2c_fd, read_buffer, buffer_size);
+int HDC1080::read_data(uint8_t *buffer, size_t buffer_size) {
+    TraceSpan span("hdc1080 read", Tracer::TRACE_I2C, hdc1080_addr);
+    auto bytes_read = bus.read(hdc1080_addr, buffer, buffer_size);
+    span.result((int32_t) bytes_read);
 
 #ifdef DBG
     std::cout << "[HDC1080] Read " << std::dec << bytes_read << " bytes" << std::endl;
 #endif
-    if (bytes_read < 0) {
-        // return an empty vector if we can't read anything.
-        return std::make_unique<std::vector<uint8_t>>();
+    if (bytes_read != (ssize_t) buffer_size) {
+        std::cerr << "[HDC1080] Unable to read data (" << strerror(errno) << ")." << std::endl;
+        return -1;
     }
 
-    auto result = std::make_unique<std::vector<uint8_t>>(read_buffer, read_buffer + bytes_read);
-
-    delete[] read_buffer;
-
 #ifdef DBG
     std::cout << "[HDC1080] Read: ";
-    for (auto e : *result) {
-        std::cout << std::hex << (int) e << " ";
+    for (size_t i = 0; i < buffer_size; i++) {
+        std::cout << std::hex << (int) buffer[i] << " ";
     }
     std::cout << std::endl;
 #endif
-    return result;
+    return (int) bytes_read;
 }
 
 int HDC1080::reset() {
@@ -137,10 +115,12 @@ int HDC1080::read_deviceId() {
     if (write_data(cmd, 1) < 0) {
         return -1;
     }
-    std::this_thread::sleep_for(std::chrono::microseconds(62500));
-    auto response = read_data(2);
+    uint8_t response[2];
+    if (read_data(response) < 0) {
+        return -1;
+    }
 
-    device_id = response->at(0) * 256 + response->at(1);
+    device_id = response[0] * 256 + response[1];
     return 0;
 }
 
@@ -149,15 +129,18 @@ int HDC1080::read_manufacturerId() {
     if (write_data(cmd, 1) < 0) {
         return -1;
     }
-    std::this_thread::sleep_for(std::chrono::microseconds(62500));
-    auto response = read_data(2);
+    uint8_t response[2];
+    if (read_data(response) < 0) {
+        return -1;
+    }
 
-    manufacturer_id = response->at(0) * 256 + response->at(1);
+    manufacturer_id = response[0] * 256 + response[1];
     return 0;
 }
 
 int HDC1080::read_serialNumber() {
     uint32_t serialNumber = 0;
+    uint8_t response[2];
     uint8_t cmd_h[] = {GET_SERIAL_NR_HIGH};
     uint8_t cmd_m[] = {GET_SERIAL_NR_MID};
     uint8_t cmd_l[] = {GET_SERIAL_NR_LOW};
@@ -165,56 +148,117 @@ int HDC1080::read_serialNumber() {
         return -1;
     }
 
-    std::this_thread::sleep_for(std::chrono::microseconds(62500));
-    auto response = read_data(2);
+    if (read_data(response) < 0) {
+        return -1;
+    }
 
-    serialNumber = response->at(0) * 256 + response->at(1);
+    serialNumber = response[0] * 256 + response[1];
 
     if (write_data(cmd_m, 1) < 0) {
         return -1;
     }
 
-    std::this_thread::sleep_for(std::chrono::microseconds(62500));
-    response = read_data(2);
+    if (read_data(response) < 0) {
+        return -1;
+    }
 
-    serialNumber = serialNumber * 256 + response->at(0) * 256 + response->at(1);
+    serialNumber = serialNumber * 256 + response[0] * 256 + response[1];
 
     if (write_data(cmd_l, 1) < 0) {
         return -1;
     }
 
-    std::this_thread::sleep_for(std::chrono::microseconds(62500));
-    response = read_data(2);
+    if (read_data(response) < 0) {
+        return -1;
+    }
 
-    serialNumber = serialNumber * 256 + response->at(0) * 256 + response->at(1);
+    serialNumber = serialNumber * 256 + response[0] * 256 + response[1];
 
     serial_number = serialNumber;
 
     return 0;
 }
 
+uint32_t HDC1080::get_suppressed_transactions() {
+    return suppressed_transactions;
+}
+
 uint16_t HDC1080::read_configRegister() {
+    if (config_shadow.is_valid()) {
+        suppressed_transactions++;
+        return config_shadow.value()[0] * 256 + config_shadow.value()[1];
+    }
+
     uint8_t cmd[] = {CONGIGURATION_REGISTER};
     if (write_data(cmd, 1) < 0) {
         return 0;
     }
 
-    std::this_thread::sleep_for(std::chrono::microseconds(62500));
-    auto response = read_data(2);
+    uint8_t response[2];
+    if (read_data(response) < 0) {
+        return 0;
+    }
+    config_shadow.store(response);
 
-    return response->at(0) * 256 + response->at(1);
+    return response[0] * 256 + response[1];
 }
 
-int HDC1080::write_configRegister(uint16_t config) {
+int HDC1080::write_config(uint16_t config) {
     uint8_t cmd[] = {CONGIGURATION_REGISTER, (uint8_t)(config>>8), 0x00};
+    if (config_shadow.unchanged(&cmd[1])) {
+        suppressed_transactions++;
+        return 0;
+    }
     if (write_data(cmd, 3) < 0) {
+        config_shadow.invalidate();
         return -1;
     }
+    if (config & 0x8000) {
+        config_shadow.invalidate();     // soft reset restores the default configuration
+    } else {
+        config_shadow.store(&cmd[1]);
+    }
+    return 1;
+}
 
-    std::this_thread::sleep_for(std::chrono::microseconds(15000));
+int HDC1080::write_configRegister(uint16_t config) {
+    int rc = write_config(config);
+    if (rc < 0) {
+        return -1;
+    }
+
+    if ((rc > 0) && (config & 0x8000)) {
+        // start-up time after soft reset
+        TraceSpan span("hdc1080 soft reset", Tracer::TRACE_SLEEP, SOFT_RESET_TIME_MYS);
+        std::this_thread::sleep_for(std::chrono::microseconds(SOFT_RESET_TIME_MYS));
+    }
     return 0;
 }
 
+uint32_t HDC1080::conversion_time_mys(bool temperature, bool humidity) {
+    // conversion times (max) from the datasheet, depending on the resolution in the
+    // configuration register; unknown configuration -> 14 bit
+    uint16_t config = config_shadow.is_valid() ? (config_shadow.value()[0] << 8) : 0;
+    uint32_t t = 0;
+    if (temperature) {
+        t += (config & 0x0400) ? 3650 : 6350;
+    }
+    if (humidity) {
+        switch ((config >> 8) & 3) {
+            case 0:
+                t += 6500;
+                break;
+            case 1:
+                t += 3850;
+                break;
+            default:
+                t += 2500;
+                break;
+        }
+    }
+    return t;
+}
+
 int HDC1080::set_resolution(enum MeasurementResolution res_temperture, enum MeasurementResolution res_humidity) {
     uint16_t config = read_configRegister();
     // temperature:
@@ -266,12 +310,18 @@ float HDC1080::measure_humidity() {
         return recent_humidity; // fallback to old value
     }
 
-    std::this_thread::sleep_for(std::chrono::microseconds(62500));
-    auto response = read_data(2);
+    {
+        TraceSpan span("hdc1080 conversion", Tracer::TRACE_SLEEP, (int32_t) conversion_time_mys(false, true));
+        std::this_thread::sleep_for(std::chrono::microseconds(conversion_time_mys(false, true)));
+    }
+    uint8_t response[2];
+    if (read_data(response) < 0) {
+        return recent_humidity; // fallback to old value
+    }
 
-    uint16_t raw = response->at(0) * 256 + response->at(1);
+    uint16_t raw = response[0] * 256 + response[1];
 
-    recent_humidity = ((float)raw) *100/65536;
+    recent_humidity = humidity_from_raw(raw);
     return recent_humidity;
 }
 
@@ -285,35 +335,80 @@ float HDC1080::measure_temperature() {
         return recent_temperature; // fallback to old value
     }
 
-    std::this_thread::sleep_for(std::chrono::microseconds(62500));
-    auto response = read_data(2);
+    {
+        TraceSpan span("hdc1080 conversion", Tracer::TRACE_SLEEP, (int32_t) conversion_time_mys(true, false));
+        std::this_thread::sleep_for(std::chrono::microseconds(conversion_time_mys(true, false)));
+    }
+    uint8_t response[2];
+    if (read_data(response) < 0) {
+        return recent_temperature; // fallback to old value
+    }
 
-    uint16_t raw = response->at(0) * 256 + response->at(1);
+    uint16_t raw = response[0] * 256 + response[1];
 
-    recent_temperature = ((float)raw) *165/65536 - 40;
+    recent_temperature = temperature_from_raw(raw);
     return recent_temperature;
 }
 
 int HDC1080::measure() {
-    uint8_t cmd[] = {TEMPERATURE_REGISTER};
+    return measure_blocking();
+}
 
-    if (set_acquisition(1) < 0) {
-        return -1;
+int HDC1080::abort_measurement() {
+    phase = IDLE;
+    return -1;
+}
+
+int HDC1080::start_measurement(uint32_t &wait_mys) {
+    // set_acquisition(1): temperature AND humidity
+    uint16_t config = read_configRegister();
+    if (!config_shadow.is_valid()) {
+        return abort_measurement();
+    }
+    if (write_config(config | 0x1000) < 0) {
+        return abort_measurement();
     }
+
+    uint8_t cmd[] = {TEMPERATURE_REGISTER};
     if (write_data(cmd, 1) < 0) {
-        return -1;
+        return abort_measurement();
     }
+    phase = READ_RESULT;
+    polls_left = MAX_READY_POLLS;
+    wait_mys = conversion_time_mys(true, true);
+    return PHASE_PENDING;
+}
 
-    std::this_thread::sleep_for(std::chrono::microseconds(62500));
-    auto response = read_data(4);
+int HDC1080::continue_measurement(uint32_t &wait_mys) {
+    if (phase != READ_RESULT) {
+        return abort_measurement();
+    }
 
-    uint16_t raw = response->at(0) * 256 + response->at(1);
-    recent_temperature = ((float)raw) *165/65536 - 40;
+    uint8_t response[4];
+    // the HDC1080 NACKs the read while the conversion is still running
+    ssize_t bytes_read;
+    {
+        TraceSpan span("hdc1080 read", Tracer::TRACE_I2C, hdc1080_addr);
+        bytes_read = bus.read(hdc1080_addr, response, sizeof(response));
+        span.result((int32_t) bytes_read);
+    }
+    if (bytes_read != sizeof(response)) {
+        if (polls_left-- > 0) {
+            wait_mys = READY_POLL_INTERVAL_MYS;
+            return PHASE_PENDING;
+        }
+        std::cerr << "[HDC1080] Conversion not finished (" << strerror(errno) << ")." << std::endl;
+        return abort_measurement();
+    }
 
-    raw = response->at(2) * 256 + response->at(3);
-    recent_humidity = ((float)raw) *100/65536;
+    uint16_t raw = response[0] * 256 + response[1];
+    recent_temperature = temperature_from_raw(raw);
 
-    return 0;
+    raw = response[2] * 256 + response[3];
+    recent_humidity = humidity_from_raw(raw);
+
+    phase = IDLE;
+    return PHASE_DONE;
 }
 
 int HDC1080::heater_on() {
@@ -1,14 +1,17 @@
 #ifndef IAQ_HDC1080_H
 #define IAQ_HDC1080_H
 
-#include <memory>
+#include "I2CTransport.h"
+#include "MeasurementCycle.h"
+#include "RegisterShadow.h"
+#include "Tracer.h"
+
 #include <string>
-#include <vector>
 
 // HDC1080, see also https://github.com/jshnaidman/HDC1080/blob/master/src/HDC1080JS.cpp
-class HDC1080 {
+class HDC1080 : public PhasedMeasurement {
 public:
-    HDC1080(std::string i2c_dev_name, uint8_t hdc1080_addr);
+    HDC1080(I2CTransport &bus, uint8_t hdc1080_addr);
 
     ~HDC1080();
 
@@ -30,12 +33,27 @@ public:
     };
     uint8_t verbose = 0;
 
+    // Conversion of the raw register values (datasheet chapter 8.6.1 / 8.6.2).
+    static float temperature_from_raw(uint16_t raw) {
+        return ((float)raw) *165/65536 - 40;
+    }
+
+    static float humidity_from_raw(uint16_t raw) {
+        return ((float)raw) *100/65536;
+    }
+
     float measure_humidity();
     float measure_temperature();
     float get_recent_humidity();
     float get_recent_temperature();
+    // Measures temperature and humidity in one acquisition (blocking).
     int measure();
 
+    // measure() split into phases, see PhasedMeasurement.
+    int start_measurement(uint32_t &wait_mys) override;
+
+    int continue_measurement(uint32_t &wait_mys) override;
+
     uint16_t get_device_id();
     uint16_t get_manufacturer_id();
     uint32_t get_serial_number();
@@ -43,23 +61,45 @@ public:
     int heater_on();
     int heater_off();
 
+    // Number of configuration register transfers answered from / suppressed by the shadow.
+    uint32_t get_suppressed_transactions();
+
 private:
-    const std::string i2c_dev_name;
+    I2CTransport &bus;
     const uint8_t hdc1080_addr;
-    int i2c_fd = -1;
     uint16_t device_id = 0;
     uint16_t manufacturer_id = 0;
     uint32_t serial_number = 0;
     float recent_humidity = 0.0;
     float recent_temperature = 0.0;
+    RegisterShadow<2> config_shadow;
+    uint32_t suppressed_transactions = 0;
+
+    enum MeasurementPhase {
+        IDLE,
+        READ_RESULT
+    } phase = IDLE;
+    int polls_left = 0;
+
+    enum Timing : uint32_t {
+        SOFT_RESET_TIME_MYS = 15000,
+        READY_POLL_INTERVAL_MYS = 500,
+        MAX_READY_POLLS = 20
+    };
 
-    void close_device();
+    // Conversion time per datasheet for the configured resolution.
+    uint32_t conversion_time_mys(bool temperature, bool humidity);
 
     void init();
 
-    void open_device();
+    // Reads buffer_size bytes from the current register pointer.
+    // Returns the number of bytes read or -1 on error.
+    int read_data(uint8_t *buffer, size_t buffer_size);
 
-    std::unique_ptr<std::vector<uint8_t>> read_data(size_t buffer_size);
+    template<size_t N>
+    int read_data(uint8_t (&buffer)[N]) {
+        return read_data(buffer, N);
+    }
 
     int read_deviceId();
 
@@ -71,11 +111,17 @@ private:
 
     int write_configRegister(uint16_t config);
 
+    // write_configRegister() without the delay: returns 1 if written, 0 if the register
+    // already holds the value, -1 on error.
+    int write_config(uint16_t config);
+
     int set_acquisition(uint8_t value);
 
     int reset();
 
     int write_data(uint8_t *buffer, size_t buffer_len);
+
+    int abort_measurement();
 };
 
 #endif //IAQ_HDC1080_H
@@ -0,0 +1,30 @@
+#ifndef IAQ_I2C_TRANSPORT_H
+#define IAQ_I2C_TRANSPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+
+// Byte level access to an I2C bus. The sensor drivers (CCS811, HDC1080, BMP280) only talk to
+// their chip through this interface, so the same driver code runs on the Linux i2c-dev bus
+// (LinuxI2C) and on the in-process model of the CJMCU-8128 board (SimulatedI2C).
+//
+// Both calls behave like write(2)/read(2) on an i2c-dev file descriptor that has the slave
+// address selected: they return the number of bytes transferred or -1 on error (e.g. NACK).
+// Implementations must be safe to use from several threads.
+class I2CTransport {
+public:
+    virtual ~I2CTransport() = default;
+
+    virtual ssize_t write(uint8_t addr, const uint8_t *buffer, size_t buffer_len) = 0;
+
+    virtual ssize_t read(uint8_t addr, uint8_t *buffer, size_t buffer_len) = 0;
+
+    // Combined transaction: write, repeated start, read (no STOP in between, so no other master
+    // can access the device between selecting a register and reading it).
+    // Returns the number of bytes read or -1 on error.
+    virtual ssize_t write_read(uint8_t addr, const uint8_t *write_buffer, size_t write_len,
+                               uint8_t *read_buffer, size_t read_len) = 0;
+};
+
+#endif //IAQ_I2C_TRANSPORT_H
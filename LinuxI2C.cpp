@@ -0,0 +1,85 @@
+#include "LinuxI2C.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+LinuxI2C::LinuxI2C(std::string i2c_dev_name)
+        : i2c_dev_name(std::move(i2c_dev_name)) {
+    open_device();
+}
+
+LinuxI2C::~LinuxI2C() {
+    close_device();
+}
+
+void LinuxI2C::open_device() {
+    i2c_fd = open(i2c_dev_name.c_str(), O_RDWR);
+    if (i2c_fd < 0) {
+        std::cerr << "[I2C] Unable to open " << i2c_dev_name << ". " << strerror(errno) << std::endl;
+        throw 1;
+    }
+}
+
+void LinuxI2C::close_device() {
+    if (i2c_fd >= 0) close(i2c_fd);
+    i2c_fd = -1;
+}
+
+int LinuxI2C::select_device(uint8_t addr) {
+    if (selected_addr == addr) {
+        return 0;
+    }
+    if (ioctl(i2c_fd, I2C_SLAVE, addr) < 0) {
+        std::cerr << "[I2C] Failed to select device 0x" << std::hex << (int) addr << ". " << strerror(errno)
+                  << std::endl;
+        selected_addr = -1;
+        return -1;
+    }
+    selected_addr = addr;
+    return 0;
+}
+
+ssize_t LinuxI2C::write(uint8_t addr, const uint8_t *buffer, size_t buffer_len) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (select_device(addr) < 0) {
+        return -1;
+    }
+    return ::write(i2c_fd, buffer, buffer_len);
+}
+
+ssize_t LinuxI2C::read(uint8_t addr, uint8_t *buffer, size_t buffer_len) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (select_device(addr) < 0) {
+        return -1;
+    }
+    return ::read(i2c_fd, buffer, buffer_len);
+}
+
+ssize_t LinuxI2C::write_read(uint8_t addr, const uint8_t *write_buffer, size_t write_len,
+                             uint8_t *read_buffer, size_t read_len) {
+    struct i2c_msg msgs[2];
+    struct i2c_rdwr_ioctl_data transfer;
+
+    msgs[0].addr = addr;
+    msgs[0].flags = 0;
+    msgs[0].len = static_cast<__u16>(write_len);
+    msgs[0].buf = const_cast<uint8_t *>(write_buffer);
+    msgs[1].addr = addr;
+    msgs[1].flags = I2C_M_RD;
+    msgs[1].len = static_cast<__u16>(read_len);
+    msgs[1].buf = read_buffer;
+    transfer.msgs = msgs;
+    transfer.nmsgs = 2;
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (ioctl(i2c_fd, I2C_RDWR, &transfer) < 0) {
+        return -1;
+    }
+    return read_len;
+}
@@ -0,0 +1,39 @@
+#ifndef IAQ_LINUX_I2C_H
+#define IAQ_LINUX_I2C_H
+
+#include "I2CTransport.h"
+
+#include <mutex>
+#include <string>
+
+// I2CTransport on top of the Linux i2c-dev interface (e.g. /dev/i2c-1).
+// The bus is opened once and shared by all drivers; the slave address is only
+// re-selected (ioctl I2C_SLAVE) when a transfer targets a different device.
+class LinuxI2C : public I2CTransport {
+public:
+    explicit LinuxI2C(std::string i2c_dev_name);
+
+    ~LinuxI2C() override;
+
+    ssize_t write(uint8_t addr, const uint8_t *buffer, size_t buffer_len) override;
+
+    ssize_t read(uint8_t addr, uint8_t *buffer, size_t buffer_len) override;
+
+    // Uses one I2C_RDWR ioctl with two messages.
+    ssize_t write_read(uint8_t addr, const uint8_t *write_buffer, size_t write_len,
+                       uint8_t *read_buffer, size_t read_len) override;
+
+private:
+    const std::string i2c_dev_name;
+    int i2c_fd = -1;
+    int selected_addr = -1;
+    std::mutex lock;
+
+    void open_device();
+
+    void close_device();
+
+    int select_device(uint8_t addr);
+};
+
+#endif //IAQ_LINUX_I2C_H
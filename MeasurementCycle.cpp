@@ -0,0 +1,81 @@
+#include "MeasurementCycle.h"
+#include "Tracer.h"
+
+#include <thread>
+
+int PhasedMeasurement::measure_blocking() {
+    uint32_t wait_mys = 0;
+    int rc = start_measurement(wait_mys);
+    while (rc == PHASE_PENDING) {
+        {
+            TraceSpan span("wait", Tracer::TRACE_SLEEP, (int32_t) wait_mys);
+            std::this_thread::sleep_for(std::chrono::microseconds(wait_mys));
+        }
+        rc = continue_measurement(wait_mys);
+    }
+    return rc;
+}
+
+int MeasurementCycle::add(PhasedMeasurement *sensor) {
+    if ((sensor == nullptr) || (count >= MAX_SENSORS)) {
+        return -1;
+    }
+    entries[count].sensor = sensor;
+    entries[count].rc = PhasedMeasurement::PHASE_DONE;
+    return static_cast<int>(count++);
+}
+
+void MeasurementCycle::handle_phase(Entry &e, int rc, uint32_t wait_mys, clock::time_point now) {
+    e.rc = rc;
+    if (rc == PhasedMeasurement::PHASE_PENDING) {
+        e.due = now + std::chrono::microseconds(wait_mys);
+    }
+}
+
+int MeasurementCycle::run() {
+    TraceSpan cycle_span("cycle", Tracer::TRACE_PHASE, -1);
+    auto start = clock::now();
+    uint32_t wait_mys;
+
+    for (size_t i = 0; i < count; i++) {
+        TraceSpan span("start_measurement", Tracer::TRACE_PHASE, (int32_t) i);
+        wait_mys = 0;
+        int rc = entries[i].sensor->start_measurement(wait_mys);
+        span.result(rc);
+        handle_phase(entries[i], rc, wait_mys, clock::now());
+    }
+
+    while (true) {
+        Entry *next = nullptr;
+        for (size_t i = 0; i < count; i++) {
+            if ((entries[i].rc == PhasedMeasurement::PHASE_PENDING) && ((next == nullptr) || (entries[i].due < next->due))) {
+                next = &entries[i];
+            }
+        }
+        if (next == nullptr) {
+            break;
+        }
+        int32_t index = (int32_t) (next - entries);
+        {
+            int32_t wait = Tracer::enabled() ? (int32_t) std::chrono::duration_cast<std::chrono::microseconds>(
+                    next->due - clock::now()).count() : 0;
+            TraceSpan span("wait", Tracer::TRACE_SLEEP, wait);
+            std::this_thread::sleep_until(next->due);
+        }
+        TraceSpan span("continue_measurement", Tracer::TRACE_PHASE, index);
+        wait_mys = 0;
+        int rc = next->sensor->continue_measurement(wait_mys);
+        span.result(rc);
+        handle_phase(*next, rc, wait_mys, clock::now());
+    }
+
+    duration = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start);
+
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].rc != PhasedMeasurement::PHASE_DONE) {
+            cycle_span.result(-1);
+            return -1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+#ifndef IAQ_MEASUREMENT_CYCLE_H
+#define IAQ_MEASUREMENT_CYCLE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// A sensor measurement split into non-blocking phases. Each phase does its bus work and tells
+// the caller how long to wait (conversion time, mailbox delay, ...) before the next phase, so
+// the waits of several sensors can overlap instead of adding up.
+//
+// Both calls return:
+//   PHASE_DONE     the measurement is complete,
+//   PHASE_PENDING  call continue_measurement() again after wait_mys microseconds,
+//   < 0            error, the measurement is aborted.
+class PhasedMeasurement {
+public:
+    enum PhaseResult {
+        PHASE_DONE = 0,
+        PHASE_PENDING = 1
+    };
+
+    virtual ~PhasedMeasurement() = default;
+
+    virtual int start_measurement(uint32_t &wait_mys) = 0;
+
+    virtual int continue_measurement(uint32_t &wait_mys) = 0;
+
+    // Runs all phases, sleeping in between.
+    int measure_blocking();
+};
+
+// Runs the phased measurements of several sensors interleaved on the calling thread: the
+// next phase is always the one whose wait expires first. The cycle time therefore approaches
+// the longest single measurement instead of the sum of all of them.
+class MeasurementCycle {
+public:
+    static const size_t MAX_SENSORS = 8;
+
+    typedef std::chrono::steady_clock clock;
+
+    // Returns the index of the sensor (used for result()) or -1 if the cycle is full.
+    int add(PhasedMeasurement *sensor);
+
+    // Runs one measurement of all sensors. Returns 0 if all sensors succeeded, -1 otherwise.
+    int run();
+
+    // Result (PHASE_DONE or the error code) of the sensor in the last cycle.
+    int result(int index) const { return entries[index].rc; }
+
+    // Wall time of the last cycle.
+    std::chrono::microseconds last_duration() const { return duration; }
+
+private:
+    struct Entry {
+        PhasedMeasurement *sensor;
+        clock::time_point due;
+        int rc;
+    };
+
+    Entry entries[MAX_SENSORS];
+    size_t count = 0;
+    std::chrono::microseconds duration{0};
+
+    void handle_phase(Entry &e, int rc, uint32_t wait_mys, clock::time_point now);
+};
+
+#endif //IAQ_MEASUREMENT_CYCLE_H
@@ -0,0 +1,59 @@
+#include "Metrics.h"
+
+#include <cstdio>
+#include <utility>
+
+void metric_header(std::string &out, const char *name, const char *type, const char *help) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void metric_value(std::string &out, const char *name, const std::string &labels, double value) {
+    char number[32];
+
+    out += name;
+    if (!labels.empty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    snprintf(number, sizeof(number), " %.17g\n", value);
+    out += number;
+}
+
+Histogram::Histogram(std::vector<double> bounds)
+        : bounds(std::move(bounds)), buckets(this->bounds.size() + 1, 0) {
+}
+
+void Histogram::observe(double value) {
+    size_t i = 0;
+    while ((i < bounds.size()) && (value > bounds[i])) {
+        i++;
+    }
+    buckets[i]++;
+    sum += value;
+    count++;
+}
+
+void Histogram::write(std::string &out, const char *name, const std::string &labels) const {
+    std::string bucket = std::string(name) + "_bucket";
+    std::string prefix = labels.empty() ? "" : labels + ",";
+    char bound[32];
+    uint64_t cumulative = 0;
+
+    for (size_t i = 0; i < bounds.size(); i++) {
+        cumulative += buckets[i];
+        snprintf(bound, sizeof(bound), "%g", bounds[i]);
+        metric_value(out, bucket.c_str(), prefix + "le=\"" + bound + "\"", (double) cumulative);
+    }
+    metric_value(out, bucket.c_str(), prefix + "le=\"+Inf\"", (double) count);
+    metric_value(out, (std::string(name) + "_sum").c_str(), labels, sum);
+    metric_value(out, (std::string(name) + "_count").c_str(), labels, (double) count);
+}
@@ -0,0 +1,40 @@
+#ifndef IAQ_METRICS_H
+#define IAQ_METRICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Helpers for the metrics of the daemon in the text exposition format of Prometheus:
+//
+//   # HELP cjmcu_snapshot_age_seconds Age of the latest published values.
+//   # TYPE cjmcu_snapshot_age_seconds gauge
+//   cjmcu_snapshot_age_seconds{board="cjmcu"} 12
+//
+// Labels are passed preformatted without braces (e.g. "board=\"cjmcu\"", or "" for none).
+
+void metric_header(std::string &out, const char *name, const char *type, const char *help);
+
+void metric_value(std::string &out, const char *name, const std::string &labels, double value);
+
+// Cumulative histogram with fixed upper bounds (plus +Inf). Not thread safe.
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> bounds);
+
+    void observe(double value);
+
+    uint64_t get_count() const { return count; }
+
+    // Writes the _bucket, _sum and _count lines (without header).
+    void write(std::string &out, const char *name, const std::string &labels) const;
+
+private:
+    std::vector<double> bounds;
+    std::vector<uint64_t> buckets;  // not cumulative, the last one is +Inf
+    double sum = 0;
+    uint64_t count = 0;
+};
+
+#endif //IAQ_METRICS_H
@@ -0,0 +1,21 @@
+#include "RawDataBuffer.h"
+
+RawDataBuffer::RawDataBuffer(size_t capacity)
+        : ring((capacity > 0) ? capacity : 1) {
+}
+
+uint64_t RawDataBuffer::append(const RawSample &sample) {
+    RawSample &slot = ring[(next_seq - 1) % ring.size()];
+    slot = sample;
+    slot.seq = next_seq;
+    return next_seq++;
+}
+
+size_t RawDataBuffer::after(uint64_t seq, RawSample *out, size_t max) const {
+    uint64_t first = first_seq();
+    size_t n = 0;
+    for (seq = (seq < first) ? first : seq + 1; (seq < next_seq) && (n < max); seq++) {
+        out[n++] = ring[(seq - 1) % ring.size()];
+    }
+    return n;
+}
@@ -0,0 +1,44 @@
+#ifndef IAQ_RAW_DATA_BUFFER_H
+#define IAQ_RAW_DATA_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One RAW_DATA reading of the CCS811 (drive mode 4: every 250 ms).
+struct RawSample {
+    uint64_t seq;           // sequence number, starts with 1 and increases by 1 per sample
+    int64_t time_ms;        // time stamp in ms since the epoch
+    uint8_t current_ua;     // current through the sensor, 0..63 uA
+    uint16_t voltage_adc;   // voltage across the sensor, 10 bit, 1023 = 1.65 V
+};
+
+// Fixed capacity ring of the most recent raw samples, kept apart from the SampleHistory of the
+// measurement cycles, which gets one sample per cycle. Read like the SampleHistory: collectors
+// ask for the samples after the last sequence number they received.
+class RawDataBuffer {
+public:
+    explicit RawDataBuffer(size_t capacity);
+
+    // Stores the sample (the seq member is assigned) and returns its sequence number.
+    uint64_t append(const RawSample &sample);
+
+    size_t capacity() const { return ring.size(); }
+
+    // Sequence numbers of the oldest and latest sample, 0 if the buffer is empty.
+    uint64_t oldest_seq() const { return (next_seq == 1) ? 0 : first_seq(); }
+
+    uint64_t latest_seq() const { return next_seq - 1; }
+
+    // Copies up to max samples with a sequence number larger than seq to out, oldest first.
+    // Returns the number of samples copied.
+    size_t after(uint64_t seq, RawSample *out, size_t max) const;
+
+private:
+    std::vector<RawSample> ring;
+    uint64_t next_seq = 1;
+
+    uint64_t first_seq() const { return (next_seq > ring.size()) ? next_seq - ring.size() : 1; }
+};
+
+#endif //IAQ_RAW_DATA_BUFFER_H
@@ -0,0 +1,42 @@
+#ifndef IAQ_REGISTER_SHADOW_H
+#define IAQ_REGISTER_SHADOW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Write-through copy of a configuration register (or mailbox) of N bytes.
+// The driver stores every value it writes to or reads from the chip; as long as the shadow
+// is valid, reads can be answered from it and writes of an unchanged value can be skipped.
+// Anything that changes the register behind the driver's back (reset) must invalidate it.
+template<size_t N>
+class RegisterShadow {
+public:
+    bool is_valid() const {
+        return valid;
+    }
+
+    // true if the register is known to hold value already
+    bool unchanged(const uint8_t *value) const {
+        return valid && (memcmp(shadow, value, N) == 0);
+    }
+
+    void store(const uint8_t *value) {
+        memcpy(shadow, value, N);
+        valid = true;
+    }
+
+    const uint8_t *value() const {
+        return shadow;
+    }
+
+    void invalidate() {
+        valid = false;
+    }
+
+private:
+    uint8_t shadow[N] = {0};
+    bool valid = false;
+};
+
+#endif //IAQ_REGISTER_SHADOW_H
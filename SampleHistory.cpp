@@ -0,0 +1,71 @@
+#include "SampleHistory.h"
+
+SampleHistory::SampleHistory(size_t capacity)
+        : ring((capacity > 0) ? capacity : 1) {
+}
+
+uint64_t SampleHistory::append(const HistorySample &sample) {
+    HistorySample &slot = ring[(next_seq - 1) % ring.size()];
+    slot = sample;
+    slot.seq = next_seq;
+    return next_seq++;
+}
+
+void SampleHistory::restore(const HistorySample &sample) {
+    if (sample.seq < next_seq) {
+        return;
+    }
+    if (sample.seq != next_seq) {
+        base_seq = sample.seq;
+    }
+    ring[(sample.seq - 1) % ring.size()] = sample;
+    next_seq = sample.seq + 1;
+}
+
+size_t SampleHistory::copy(uint64_t seq, HistorySample *out, size_t max) const {
+    size_t n = 0;
+    for (; (seq < next_seq) && (n < max); seq++) {
+        out[n++] = at(seq);
+    }
+    return n;
+}
+
+size_t SampleHistory::after(uint64_t seq, HistorySample *out, size_t max) const {
+    uint64_t first = first_seq();
+    return copy((seq < first) ? first : seq + 1, out, max);
+}
+
+size_t SampleHistory::in_range(time_t from, time_t to, HistorySample *out, size_t max) const {
+    size_t n = 0;
+    for (uint64_t seq = search(from, false); (seq < next_seq) && (n < max) && (at(seq).time <= to); seq++) {
+        out[n++] = at(seq);
+    }
+    return n;
+}
+
+size_t SampleHistory::count_after(uint64_t seq) const {
+    uint64_t first = first_seq();
+    if (seq >= next_seq - 1) {
+        return 0;
+    }
+    return (size_t) (next_seq - ((seq < first) ? first : seq + 1));
+}
+
+size_t SampleHistory::count_in_range(time_t from, time_t to) const {
+    uint64_t first = search(from, false), end = search(to, true);
+    return (end > first) ? (size_t) (end - first) : 0;
+}
+
+uint64_t SampleHistory::search(time_t t, bool after) const {
+    // binary search, the time stamps are non-decreasing
+    uint64_t lo = first_seq(), hi = next_seq;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if ((at(mid).time < t) || (after && (at(mid).time == t))) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
@@ -0,0 +1,88 @@
+#ifndef IAQ_SAMPLE_HISTORY_H
+#define IAQ_SAMPLE_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+// One measurement cycle as kept in the history (the validated values).
+struct HistorySample {
+    uint64_t seq;           // sequence number, starts with 1 and increases by 1 per sample
+    time_t time;            // time stamp of the measurement
+    uint16_t co2;
+    uint16_t tvoc;
+    double humidity;
+    double temp_HDC;
+    double temp_BMP;
+    double pressure;
+    uint8_t bmp280_status;
+    // Bit i stands for channel i of the board (co2, tvoc, humidity, temp_HDC, temp_BMP,
+    // pressure); a set bit means the value is no reading of this cycle but the last accepted one.
+    uint8_t channels_failed;    // the reading failed
+    uint8_t channels_rejected;  // the reading was dropped by the filter
+    uint8_t channels_invalid;   // no reading has been accepted yet (the value is 0)
+    uint32_t cycle_time;    // duration of the measurement cycle in ms
+};
+
+// Fixed capacity ring of the most recent samples. The memory is allocated once in the
+// constructor; when the ring is full, append() overwrites the oldest sample.
+//
+// Collectors keep the sequence number of the last sample they received and ask for the
+// samples after it, so they neither miss nor duplicate samples as long as they poll at least
+// once per capacity samples. If oldest_seq() is larger than their sequence number + 1, the
+// samples in between have been overwritten.
+class SampleHistory {
+public:
+    explicit SampleHistory(size_t capacity);
+
+    // Stores the sample (the seq member is assigned) and returns its sequence number.
+    uint64_t append(const HistorySample &sample);
+
+    // Stores a sample with its own sequence number (e.g. read from the SampleLog after a
+    // restart), later appended samples continue after it. Samples older than the latest one
+    // are ignored; if sample.seq leaves a gap, the samples before the gap are dropped.
+    void restore(const HistorySample &sample);
+
+    size_t capacity() const { return ring.size(); }
+
+    size_t size() const { return (size_t) (next_seq - first_seq()); }
+
+    // Sequence numbers of the oldest and latest sample, 0 if the history is empty.
+    uint64_t oldest_seq() const { return (size() == 0) ? 0 : first_seq(); }
+
+    uint64_t latest_seq() const { return next_seq - 1; }
+
+    // Copies up to max samples with a sequence number larger than seq to out, oldest first.
+    // Returns the number of samples copied.
+    size_t after(uint64_t seq, HistorySample *out, size_t max) const;
+
+    // Copies up to max samples with from <= time <= to to out, oldest first. The time stamps
+    // are expected to be non-decreasing (a step of the system clock backwards shadows the
+    // older samples until they are overwritten).
+    size_t in_range(time_t from, time_t to, HistorySample *out, size_t max) const;
+
+    // Number of samples after() and in_range() would copy without a limit, to size the output
+    // before copying.
+    size_t count_after(uint64_t seq) const;
+
+    size_t count_in_range(time_t from, time_t to) const;
+
+private:
+    std::vector<HistorySample> ring;
+    uint64_t next_seq = 1;
+    uint64_t base_seq = 1;  // no samples before this one
+
+    uint64_t first_seq() const {
+        return ((next_seq > ring.size()) && (next_seq - ring.size() > base_seq)) ? next_seq - ring.size() : base_seq;
+    }
+
+    const HistorySample &at(uint64_t seq) const { return ring[(seq - 1) % ring.size()]; }
+
+    size_t copy(uint64_t seq, HistorySample *out, size_t max) const;
+
+    // First sequence number with a time stamp >= t (with after: > t), next_seq if there is none.
+    uint64_t search(time_t t, bool after) const;
+};
+
+#endif //IAQ_SAMPLE_HISTORY_H
@@ -0,0 +1,300 @@
+#include "SampleLog.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(SampleLogHeader) <= SampleLogView::HEADER_SIZE, "header does not fit into its page");
+static_assert(sizeof(SampleLogRecord) == 64, "records must not contain padding (checksum)");
+
+static const char LOG_MAGIC[8] = {'C', 'J', 'M', 'C', 'U', 'L', 'O', 'G'};
+
+const uint32_t SampleLogView::VERSION;
+const uint32_t SampleLogView::INDEX_STRIDE;
+const size_t SampleLogView::HEADER_SIZE;
+const size_t SampleLog::DEFAULT_CAPACITY;
+const unsigned SampleLog::DEFAULT_KEEP;
+
+static size_t index_entries(size_t capacity) {
+    return (capacity + SampleLogView::INDEX_STRIDE - 1) / SampleLogView::INDEX_STRIDE;
+}
+
+size_t SampleLogView::file_size(size_t capacity) {
+    return HEADER_SIZE + index_entries(capacity) * sizeof(int64_t) + capacity * sizeof(SampleLogRecord);
+}
+
+uint32_t SampleLogView::checksum(const SampleLogRecord &record) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&record);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(SampleLogRecord, checksum); i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+size_t SampleLogView::size() const {
+    if (header == nullptr) {
+        return 0;
+    }
+    uint64_t count = __atomic_load_n(&header->count, __ATOMIC_ACQUIRE);
+    return (count < header->capacity) ? (size_t) count : (size_t) header->capacity;
+}
+
+HistorySample SampleLogView::at(size_t i) const {
+    const SampleLogRecord &r = records[i];
+    HistorySample sample;
+
+    sample.seq = r.seq;
+    sample.time = (time_t) r.time;
+    sample.co2 = r.co2;
+    sample.tvoc = r.tvoc;
+    sample.humidity = r.humidity;
+    sample.temp_HDC = r.temp_HDC;
+    sample.temp_BMP = r.temp_BMP;
+    sample.pressure = r.pressure;
+    sample.bmp280_status = r.bmp280_status;
+    sample.channels_failed = r.channels_failed;
+    sample.channels_rejected = r.channels_rejected;
+    sample.channels_invalid = r.channels_invalid;
+    sample.cycle_time = r.cycle_time;
+    return sample;
+}
+
+size_t SampleLogView::lower_bound(time_t t) const {
+    size_t n = size();
+    if (n == 0) {
+        return 0;
+    }
+
+    // first index entry with time >= t
+    size_t lo = 0, hi = index_entries(n);
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index[mid] < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // the record is within the stride before that entry
+    size_t i = (lo == 0) ? 0 : (lo - 1) * INDEX_STRIDE;
+    while ((i < n) && (records[i].time < t)) {
+        i++;
+    }
+    return i;
+}
+
+int SampleLogView::map_file(const std::string &path, bool writable) {
+    struct stat st;
+    int fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    if ((fstat(fd, &st) < 0) || ((size_t) st.st_size < HEADER_SIZE)) {
+        ::close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    void *base = mmap(nullptr, (size_t) st.st_size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED,
+                      fd, 0);
+    ::close(fd);    // the mapping keeps the file
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+    map_base = static_cast<uint8_t *>(base);
+    map_len = (size_t) st.st_size;
+
+    const SampleLogHeader *h = reinterpret_cast<const SampleLogHeader *>(map_base);
+    if ((memcmp(h->magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0) || (h->version != VERSION) ||
+        (h->record_size != sizeof(SampleLogRecord)) || (h->index_stride != INDEX_STRIDE) || (h->capacity == 0) ||
+        (file_size(h->capacity) != map_len)) {
+        unmap();
+        errno = EINVAL;
+        return -1;
+    }
+    header = h;
+    index = reinterpret_cast<const int64_t *>(map_base + HEADER_SIZE);
+    records = reinterpret_cast<const SampleLogRecord *>(index + index_entries(h->capacity));
+    return 0;
+}
+
+void SampleLogView::unmap() {
+    if (map_base != nullptr) {
+        munmap(map_base, map_len);
+    }
+    map_base = nullptr;
+    map_len = 0;
+    header = nullptr;
+    index = nullptr;
+    records = nullptr;
+}
+
+SampleLogReader::~SampleLogReader() {
+    close();
+}
+
+int SampleLogReader::open(const std::string &path) {
+    close();
+    return map_file(path, false);
+}
+
+void SampleLogReader::close() {
+    unmap();
+}
+
+SampleLog::SampleLog(std::string path, size_t capacity, unsigned keep)
+        : path(std::move(path)), log_capacity((capacity > 0) ? capacity : DEFAULT_CAPACITY), keep(keep) {
+}
+
+SampleLog::~SampleLog() {
+    close();
+}
+
+std::string SampleLog::rotated_path(const std::string &path, unsigned n) {
+    return (n == 0) ? path : path + "." + std::to_string(n);
+}
+
+int SampleLog::open() {
+    close();
+    recovered_records = 0;
+    if (map_file(path, true) == 0) {
+        recover();
+        return 0;
+    }
+    if (errno == ENOENT) {
+        return create();
+    }
+    // not a (compatible) log: keep it as rotated file and start a new one
+    std::cerr << "[SampleLog] " << path << " is no valid sample log, rotating it. " << strerror(errno) << std::endl;
+    return rotate();
+}
+
+void SampleLog::close() {
+    if (map_base != nullptr) {
+        msync(map_base, map_len, MS_SYNC);
+    }
+    unmap();
+}
+
+int SampleLog::create() {
+    size_t len = file_size(log_capacity);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "[SampleLog] Unable to create " << path << ". " << strerror(errno) << std::endl;
+        return -1;
+    }
+    // the file is sparse, unused records read as zero (invalid checksum)
+    if (ftruncate(fd, (off_t) len) < 0) {
+        std::cerr << "[SampleLog] Unable to resize " << path << ". " << strerror(errno) << std::endl;
+        ::close(fd);
+        return -1;
+    }
+    void *base = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << "[SampleLog] Unable to map " << path << ". " << strerror(errno) << std::endl;
+        return -1;
+    }
+    map_base = static_cast<uint8_t *>(base);
+    map_len = len;
+
+    SampleLogHeader *h = writable_header();
+    memcpy(h->magic, LOG_MAGIC, sizeof(LOG_MAGIC));
+    h->version = VERSION;
+    h->record_size = sizeof(SampleLogRecord);
+    h->capacity = log_capacity;
+    h->index_stride = INDEX_STRIDE;
+    h->reserved = 0;
+    h->count = 0;
+    msync(map_base, HEADER_SIZE, MS_SYNC);
+
+    header = h;
+    index = reinterpret_cast<const int64_t *>(map_base + HEADER_SIZE);
+    records = reinterpret_cast<const SampleLogRecord *>(index + index_entries(log_capacity));
+    return 0;
+}
+
+void SampleLog::recover() {
+    SampleLogHeader *h = writable_header();
+    SampleLogRecord *r = writable_records();
+    size_t capacity = (size_t) h->capacity;
+    size_t count = (h->count < capacity) ? (size_t) h->count : capacity;
+
+    // records written completely, but the update of count was lost
+    while ((count < capacity) && is_valid(r[count]) && ((count == 0) || (r[count].seq == r[count - 1].seq + 1))) {
+        count++;
+    }
+    // records published, but not (completely) written to the disk
+    while ((count > 0) && !is_valid(r[count - 1])) {
+        memset(&r[count - 1], 0, sizeof(SampleLogRecord));
+        count--;
+        recovered_records++;
+    }
+    // a torn record behind the last valid one
+    if (count < capacity) {
+        static const SampleLogRecord empty = {};
+        if (memcmp(&r[count], &empty, sizeof(empty)) != 0) {
+            memset(&r[count], 0, sizeof(SampleLogRecord));
+            recovered_records++;
+        }
+    }
+
+    int64_t *idx = writable_index();
+    for (size_t i = 0; i < count; i += INDEX_STRIDE) {
+        idx[i / INDEX_STRIDE] = r[i].time;
+    }
+    __atomic_store_n(&h->count, (uint64_t) count, __ATOMIC_RELEASE);
+}
+
+int SampleLog::rotate() {
+    close();
+    if (keep == 0) {
+        unlink(path.c_str());
+    }
+    for (unsigned n = keep; n > 0; n--) {
+        std::string from = rotated_path(path, n - 1);
+        if ((rename(from.c_str(), rotated_path(path, n).c_str()) < 0) && (errno != ENOENT)) {
+            std::cerr << "[SampleLog] Unable to rotate " << from << ". " << strerror(errno) << std::endl;
+        }
+    }
+    return create();
+}
+
+int SampleLog::append(const HistorySample &sample) {
+    if (!is_open()) {
+        return -1;
+    }
+    if ((size() == capacity()) && (rotate() < 0)) {
+        return -1;
+    }
+
+    SampleLogRecord record;
+    memset(&record, 0, sizeof(record));
+    record.seq = sample.seq;
+    record.time = (int64_t) sample.time;
+    record.humidity = sample.humidity;
+    record.temp_HDC = sample.temp_HDC;
+    record.temp_BMP = sample.temp_BMP;
+    record.pressure = sample.pressure;
+    record.cycle_time = sample.cycle_time;
+    record.co2 = sample.co2;
+    record.tvoc = sample.tvoc;
+    record.bmp280_status = sample.bmp280_status;
+    record.channels_failed = sample.channels_failed;
+    record.channels_rejected = sample.channels_rejected;
+    record.channels_invalid = sample.channels_invalid;
+    record.checksum = checksum(record);
+
+    size_t count = size();
+    writable_records()[count] = record;
+    if ((count % INDEX_STRIDE) == 0) {
+        writable_index()[count / INDEX_STRIDE] = record.time;
+    }
+    __atomic_store_n(&writable_header()->count, (uint64_t) (count + 1), __ATOMIC_RELEASE);
+    return 0;
+}
@@ -0,0 +1,160 @@
+#ifndef IAQ_SAMPLE_LOG_H
+#define IAQ_SAMPLE_LOG_H
+
+#include "SampleHistory.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Persistent, append-only log of the samples in a memory mapped file.
+//
+// File layout (host byte order):
+//   SampleLogHeader            one page
+//   int64_t index[]            sparse time index: time of every INDEX_STRIDE-th record
+//   SampleLogRecord records[]  capacity fixed size records
+//
+// The file has its final size from the start, so readers can map it completely. A record is
+// written first and then published by increasing header.count (release store); readers load
+// count with acquire semantics and never see a partial record. After a crash the writer
+// checks the records around count with their checksum and cuts off a torn record.
+//
+// When the file is full it is rotated: <path> becomes <path>.1, <path>.1 becomes <path>.2 ...
+// up to the configured number of kept files, and a new file is started.
+
+struct SampleLogHeader {
+    char magic[8];          // "CJMCULOG"
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t capacity;      // records
+    uint32_t index_stride;
+    uint32_t reserved;
+    uint64_t count;         // committed records, accessed atomically
+};
+
+struct SampleLogRecord {
+    uint64_t seq;
+    int64_t time;
+    double humidity;
+    double temp_HDC;
+    double temp_BMP;
+    double pressure;
+    uint32_t cycle_time;
+    uint16_t co2;
+    uint16_t tvoc;
+    uint8_t bmp280_status;
+    uint8_t channels_failed;    // see HistorySample (0 in records of older versions)
+    uint8_t channels_rejected;
+    uint8_t channels_invalid;
+    uint32_t checksum;      // FNV-1a over all preceding bytes of the record
+};
+
+// Read access to a mapped log, shared by the writer and the read-only reader.
+class SampleLogView {
+public:
+    static const uint32_t VERSION = 1;
+    static const uint32_t INDEX_STRIDE = 64;
+    static const size_t HEADER_SIZE = 4096;
+
+    // Number of committed records (0 if no file is mapped).
+    size_t size() const;
+
+    size_t capacity() const { return header ? (size_t) header->capacity : 0; }
+
+    HistorySample at(size_t i) const;
+
+    // Index of the first record with time >= t (size() if there is none). The time stamps
+    // are expected to be non-decreasing. Uses the sparse index, O(log n).
+    size_t lower_bound(time_t t) const;
+
+    // File size of a log with the given capacity.
+    static size_t file_size(size_t capacity);
+
+protected:
+    const SampleLogHeader *header = nullptr;
+    const int64_t *index = nullptr;
+    const SampleLogRecord *records = nullptr;
+    uint8_t *map_base = nullptr;
+    size_t map_len = 0;
+
+    // Maps the file read-only or writable and checks the header; -1 if it is no valid log.
+    int map_file(const std::string &path, bool writable);
+
+    void unmap();
+
+    static uint32_t checksum(const SampleLogRecord &record);
+
+    static bool is_valid(const SampleLogRecord &record) { return record.checksum == checksum(record); }
+};
+
+// Maps an existing log read-only, e.g. in another process than the daemon.
+class SampleLogReader : public SampleLogView {
+public:
+    SampleLogReader() = default;
+
+    SampleLogReader(const SampleLogReader &) = delete;
+
+    SampleLogReader &operator=(const SampleLogReader &) = delete;
+
+    ~SampleLogReader();
+
+    // Returns 0 on success, -1 if the file does not exist or is no valid log.
+    int open(const std::string &path);
+
+    void close();
+};
+
+// The writing side, used by the daemon.
+class SampleLog : public SampleLogView {
+public:
+    // 16 MB per file, about three months at the 30 s measurement interval
+    static const size_t DEFAULT_CAPACITY = 262144;
+    static const unsigned DEFAULT_KEEP = 3;
+
+    // keep: number of rotated files kept besides the current one
+    explicit SampleLog(std::string path, size_t capacity = DEFAULT_CAPACITY, unsigned keep = DEFAULT_KEEP);
+
+    SampleLog(const SampleLog &) = delete;
+
+    SampleLog &operator=(const SampleLog &) = delete;
+
+    ~SampleLog();
+
+    // Opens (and recovers) the log or creates a new one. Returns 0 on success, -1 on error.
+    int open();
+
+    void close();
+
+    bool is_open() const { return header != nullptr; }
+
+    // Appends the sample, rotating the file if it is full. Returns 0 on success, -1 on error.
+    int append(const HistorySample &sample);
+
+    // Number of records cut off as torn by the recovery in open().
+    size_t get_recovered_records() const { return recovered_records; }
+
+    const std::string &get_path() const { return path; }
+
+    // Path of the n-th rotated file (0: the current file).
+    static std::string rotated_path(const std::string &path, unsigned n);
+
+private:
+    const std::string path;
+    const size_t log_capacity;
+    const unsigned keep;
+    size_t recovered_records = 0;
+
+    SampleLogHeader *writable_header() { return reinterpret_cast<SampleLogHeader *>(map_base); }
+
+    SampleLogRecord *writable_records() { return const_cast<SampleLogRecord *>(records); }
+
+    int64_t *writable_index() { return const_cast<int64_t *>(index); }
+
+    int create();
+
+    void recover();
+
+    int rotate();
+};
+
+#endif //IAQ_SAMPLE_LOG_H
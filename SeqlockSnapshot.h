@@ -0,0 +1,172 @@
+#ifndef IAQ_SEQLOCK_SNAPSHOT_H
+#define IAQ_SEQLOCK_SNAPSHOT_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+// Latest value of type T in a POSIX shared memory segment, published by one writer process
+// and read by any number of reader processes without a system call.
+//
+// The value is protected by a seqlock: the writer makes the sequence counter odd, writes the
+// value and makes the counter even again. A reader copies the value between two loads of the
+// counter and retries if the counter was odd or has changed. Readers never block the writer.
+//
+// The segment carries a layout version chosen by the user; a reader refuses a segment with a
+// different version or one whose writer process is gone (stale segment after a crash).
+template<class T>
+class SeqlockSnapshot {
+    static_assert(std::is_trivially_copyable<T>::value, "T is copied as bytes");
+    static_assert((sizeof(T) % sizeof(uint64_t)) == 0, "T is copied in 64 bit words");
+
+public:
+    static const uint32_t MAX_READ_RETRIES = 1000;
+
+    SeqlockSnapshot() = default;
+
+    SeqlockSnapshot(const SeqlockSnapshot &) = delete;
+
+    SeqlockSnapshot &operator=(const SeqlockSnapshot &) = delete;
+
+    ~SeqlockSnapshot() {
+        close();
+    }
+
+    // Writer: creates (or takes over) the segment. Returns 0 on success, -1 on error (errno).
+    int create(const char *name, uint32_t version) {
+        close();
+        int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+        if (fd < 0) {
+            return -1;
+        }
+        if (ftruncate(fd, sizeof(Segment)) < 0) {
+            ::close(fd);
+            return -1;
+        }
+        if (map(fd, true) < 0) {
+            return -1;
+        }
+        // invalid until the header is complete
+        __atomic_store_n(&segment->magic, 0u, __ATOMIC_RELAXED);
+        segment->version = version;
+        segment->size = sizeof(T);
+        segment->writer_pid = getpid();
+        __atomic_store_n(&segment->seq, 0u, __ATOMIC_RELAXED);
+        memset(segment->value, 0, sizeof(segment->value));
+        __atomic_store_n(&segment->magic, MAGIC, __ATOMIC_RELEASE);
+        return 0;
+    }
+
+    // Reader: maps an existing segment read-only. Returns -1 if it does not exist, has another
+    // layout version or its writer is not running any more.
+    int open(const char *name, uint32_t version) {
+        close();
+        int fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        if (map(fd, false) < 0) {
+            return -1;
+        }
+        if ((__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) != MAGIC) || (segment->version != version) ||
+            (segment->size != sizeof(T)) ||
+            ((kill(segment->writer_pid, 0) < 0) && (errno == ESRCH))) {
+            close();
+            errno = ENOENT;
+            return -1;
+        }
+        return 0;
+    }
+
+    void close() {
+        if (segment != nullptr) {
+            munmap(segment, sizeof(Segment));
+        }
+        segment = nullptr;
+    }
+
+    // Writer: removes the name; mapped readers keep their (now frozen) copy.
+    static void remove(const char *name) {
+        shm_unlink(name);
+    }
+
+    // Writer only (one writer).
+    void publish(const T &value) {
+        uint32_t seq = __atomic_load_n(&segment->seq, __ATOMIC_RELAXED);
+        uint64_t words[WORDS];
+
+        memcpy(words, &value, sizeof(T));
+        __atomic_store_n(&segment->seq, seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        for (size_t i = 0; i < WORDS; i++) {
+            __atomic_store_n(&segment->value[i], words[i], __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&segment->seq, seq + 2, __ATOMIC_RELEASE);
+    }
+
+    // Copies a consistent value. Returns false if nothing has been published yet or no
+    // consistent copy was possible within MAX_READ_RETRIES attempts.
+    bool read(T &value) const {
+        uint64_t words[WORDS];
+
+        for (uint32_t attempt = 0; attempt < MAX_READ_RETRIES; attempt++) {
+            uint32_t seq = __atomic_load_n(&segment->seq, __ATOMIC_ACQUIRE);
+            if (seq == 0) {
+                return false;
+            }
+            if (seq & 1) {
+                continue;   // write in progress
+            }
+            for (size_t i = 0; i < WORDS; i++) {
+                words[i] = __atomic_load_n(&segment->value[i], __ATOMIC_RELAXED);
+            }
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&segment->seq, __ATOMIC_RELAXED) == seq) {
+                memcpy(&value, words, sizeof(T));
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    static const uint32_t MAGIC = 0x534e4150;   // "SNAP"
+    static const size_t WORDS = sizeof(T) / sizeof(uint64_t);
+
+    struct Segment {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t size;
+        int32_t writer_pid;
+        uint32_t seq;       // odd while the value is written
+        uint32_t reserved;
+        uint64_t value[WORDS];
+    };
+
+    Segment *segment = nullptr;
+
+    int map(int fd, bool writable) {
+        struct stat st;
+        if ((fstat(fd, &st) < 0) || ((size_t) st.st_size < sizeof(Segment))) {
+            ::close(fd);
+            errno = EINVAL;
+            return -1;
+        }
+        void *p = mmap(nullptr, sizeof(Segment), writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            return -1;
+        }
+        segment = static_cast<Segment *>(p);
+        return 0;
+    }
+};
+
+#endif //IAQ_SEQLOCK_SNAPSHOT_H
@@ -0,0 +1,542 @@
+#include "SimulatedI2C.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+/***************************************************************************/
+/*  bus                                                                    */
+/***************************************************************************/
+
+void SimulatedI2C::attach(uint8_t addr, std::unique_ptr<SimDevice> dev) {
+    std::lock_guard<std::mutex> guard(lock);
+    devices[addr & 0x7f] = std::move(dev);
+}
+
+void SimulatedI2C::attach_cjmcu8128(uint8_t ccs811_addr, uint8_t hdc1080_addr, uint8_t bmp280_addr) {
+    attach(ccs811_addr, std::unique_ptr<SimDevice>(new SimCCS811()));
+    attach(hdc1080_addr, std::unique_ptr<SimDevice>(new SimHDC1080()));
+    attach(bmp280_addr, std::unique_ptr<SimDevice>(new SimBMP280()));
+}
+
+ssize_t SimulatedI2C::write(uint8_t addr, const uint8_t *buffer, size_t buffer_len) {
+    std::lock_guard<std::mutex> guard(lock);
+    SimDevice *dev = devices[addr & 0x7f].get();
+    if (dev == nullptr) {
+        errno = ENXIO;
+        return -1;
+    }
+    ssize_t ret = dev->write(buffer, buffer_len);
+    if (ret < 0) {
+        errno = EREMOTEIO;
+    }
+    return ret;
+}
+
+ssize_t SimulatedI2C::read(uint8_t addr, uint8_t *buffer, size_t buffer_len) {
+    std::lock_guard<std::mutex> guard(lock);
+    SimDevice *dev = devices[addr & 0x7f].get();
+    if (dev == nullptr) {
+        errno = ENXIO;
+        return -1;
+    }
+    ssize_t ret = dev->read(buffer, buffer_len);
+    if (ret < 0) {
+        errno = EREMOTEIO;
+    }
+    return ret;
+}
+
+ssize_t SimulatedI2C::write_read(uint8_t addr, const uint8_t *write_buffer, size_t write_len,
+                                 uint8_t *read_buffer, size_t read_len) {
+    std::lock_guard<std::mutex> guard(lock);
+    SimDevice *dev = devices[addr & 0x7f].get();
+    if (dev == nullptr) {
+        errno = ENXIO;
+        return -1;
+    }
+    if ((dev->write(write_buffer, write_len) < 0) || (dev->read(read_buffer, read_len) < 0)) {
+        errno = EREMOTEIO;
+        return -1;
+    }
+    return read_len;
+}
+
+/***************************************************************************/
+/*  CCS811                                                                 */
+/***************************************************************************/
+
+SimCCS811::SimCCS811() : last_sample(clock::now()) {}
+
+SimCCS811::~SimCCS811() {
+    {
+        std::lock_guard<std::mutex> guard(model_lock);
+        stopping = true;
+    }
+    changed.notify_all();
+    if (interrupt_thread.joinable()) {
+        interrupt_thread.join();
+    }
+}
+
+void SimCCS811::set_interrupt(std::function<void()> interrupt) {
+    std::lock_guard<std::mutex> guard(model_lock);
+    this->interrupt = std::move(interrupt);
+    if (this->interrupt && !interrupt_thread.joinable()) {
+        interrupt_thread = std::thread(&SimCCS811::interrupt_loop, this);
+    }
+    changed.notify_all();
+}
+
+// nINT follows DATA_READY: a new sample asserts it, reading ALG_RESULT_DATA releases it. Only
+// the falling edge is signalled.
+void SimCCS811::interrupt_loop() {
+    std::unique_lock<std::mutex> guard(model_lock);
+
+    while (!stopping) {
+        auto interval = sample_interval();
+        if (!interrupt || !app_mode || (drive_mode == 0) || !int_datardy || (interval.count() == 0)) {
+            changed.wait(guard);
+            continue;
+        }
+        if (changed.wait_until(guard, last_sample + interval) == std::cv_status::timeout) {
+            bool asserted = data_ready;
+            update();
+            if (data_ready && !asserted) {
+                interrupt();
+            }
+        }
+    }
+}
+
+std::chrono::microseconds SimCCS811::sample_interval() const {
+    if (interval_override.count() > 0) {
+        return interval_override;
+    }
+    switch (drive_mode) {
+        case 1:
+            return std::chrono::seconds(1);
+        case 2:
+            return std::chrono::seconds(10);
+        case 3:
+            return std::chrono::seconds(60);
+        case 4:
+            return std::chrono::milliseconds(250);
+        default:
+            return std::chrono::microseconds(0);
+    }
+}
+
+void SimCCS811::update() {
+    auto interval = sample_interval();
+    if (!app_mode || (drive_mode == 0) || (interval.count() == 0)) {
+        return;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - last_sample);
+    if (elapsed >= interval) {
+        data_ready = true;
+        last_sample += interval * (elapsed / interval);
+    }
+}
+
+uint8_t SimCCS811::status_register() const {
+    return static_cast<uint8_t>(0x10 /* APP_VALID */ | (app_mode ? 0x80 : 0) | (data_ready ? 0x08 : 0) |
+                                (error_id ? 0x01 : 0));
+}
+
+void SimCCS811::set_air_quality(uint16_t eco2, uint16_t tvoc) {
+    std::lock_guard<std::mutex> guard(model_lock);
+    this->eco2 = eco2;
+    this->tvoc = tvoc;
+}
+
+void SimCCS811::set_sample_interval(std::chrono::microseconds interval) {
+    std::lock_guard<std::mutex> guard(model_lock);
+    interval_override = interval;
+    changed.notify_all();
+}
+
+ssize_t SimCCS811::write(const uint8_t *buffer, size_t buffer_len) {
+    std::lock_guard<std::mutex> guard(model_lock);
+    changed.notify_all();   // the interrupt thread re-evaluates after the write
+    if (buffer_len == 0) {
+        return 0;
+    }
+    uint8_t id = buffer[0];
+    if (buffer_len == 1) {
+        if ((id == 0xF4) && !app_mode) {
+            app_mode = true;
+            last_sample = clock::now();
+        } else {
+            mailbox = id;
+        }
+        return 1;
+    }
+
+    const uint8_t *data = &buffer[1];
+    size_t data_len = buffer_len - 1;
+    switch (id) {
+        case 0x01:  // MEAS_MODE
+            if (!app_mode) {
+                error_id |= 0x01;  // WRITE_REG_INVALID
+                break;
+            }
+            drive_mode = (data[0] >> 4) & 7;
+            int_datardy = (data[0] & 0x08) != 0;
+            data_ready = false;
+            last_sample = clock::now();
+            break;
+        case 0x05:  // ENV_DATA
+            memcpy(env_data, data, std::min(data_len, sizeof(env_data)));
+            break;
+        case 0x10:  // THRESHOLDS
+            break;
+        case 0x11:  // BASELINE
+            memcpy(baseline, data, std::min(data_len, sizeof(baseline)));
+            break;
+        case 0xFF:  // SW_RESET
+            if ((data_len >= 4) && (data[0] == 0x11) && (data[1] == 0xE5) && (data[2] == 0x72) &&
+                (data[3] == 0x8A)) {
+                app_mode = false;
+                mailbox = 0x00;
+                drive_mode = 0;
+                int_datardy = false;
+                data_ready = false;
+                error_id = 0;
+            }
+            break;
+        default:
+            error_id |= 0x01;  // WRITE_REG_INVALID
+            break;
+    }
+    return buffer_len;
+}
+
+ssize_t SimCCS811::read(uint8_t *buffer, size_t buffer_len) {
+    std::lock_guard<std::mutex> guard(model_lock);
+    uint8_t data[8] = {0};
+    size_t data_len = 0;
+
+    update();
+    switch (mailbox) {
+        case 0x00:  // STATUS
+            data[0] = status_register();
+            data_len = 1;
+            break;
+        case 0x01:  // MEAS_MODE
+            data[0] = static_cast<uint8_t>((drive_mode << 4) | (int_datardy ? 0x08 : 0));
+            data_len = 1;
+            break;
+        case 0x02:  // ALG_RESULT_DATA
+            data[0] = static_cast<uint8_t>(eco2 >> 8);
+            data[1] = static_cast<uint8_t>(eco2 & 0xFF);
+            data[2] = static_cast<uint8_t>(tvoc >> 8);
+            data[3] = static_cast<uint8_t>(tvoc & 0xFF);
+            data[4] = status_register();
+            data[5] = error_id;
+            data[6] = static_cast<uint8_t>(raw_data >> 8);
+            data[7] = static_cast<uint8_t>(raw_data & 0xFF);
+            data_len = 8;
+            data_ready = false;
+            break;
+        case 0x03:  // RAW_DATA
+            data[0] = static_cast<uint8_t>(raw_data >> 8);
+            data[1] = static_cast<uint8_t>(raw_data & 0xFF);
+            data_len = 2;
+            if (drive_mode == 4) {
+                data_ready = false;
+            }
+            break;
+        case 0x06:  // NTC
+            data[0] = 0x03;
+            data[2] = 0x03;
+            data_len = 4;
+            break;
+        case 0x11:  // BASELINE
+            data[0] = baseline[0];
+            data[1] = baseline[1];
+            data_len = 2;
+            break;
+        case 0x20:  // HW_ID
+            data[0] = 0x81;
+            data_len = 1;
+            break;
+        case 0x21:  // HW_VERSION
+            data[0] = 0x12;
+            data_len = 1;
+            break;
+        case 0x23:  // FW_BOOT_VERSION
+            data[0] = 0x10;
+            data_len = 2;
+            break;
+        case 0x24:  // FW_APP_VERSION
+            data[0] = 0x20;
+            data_len = 2;
+            break;
+        case 0xE0:  // ERROR_ID, cleared by reading
+            data[0] = error_id;
+            data_len = 1;
+            error_id = 0;
+            break;
+        default:
+            error_id |= 0x02;  // READ_REG_INVALID
+            break;
+    }
+
+    memset(buffer, 0, buffer_len);
+    memcpy(buffer, data, std::min(buffer_len, data_len));
+    return buffer_len;
+}
+
+/***************************************************************************/
+/*  HDC1080                                                                */
+/***************************************************************************/
+
+SimHDC1080::SimHDC1080() : conversion_done(clock::now()) {}
+
+void SimHDC1080::set_temperature(double temperature) {
+    double raw = (temperature + 40.0) * 65536.0 / 165.0;
+    raw_temperature = static_cast<uint16_t>(std::min(std::max(raw, 0.0), 65535.0)) & 0xFFFC;
+}
+
+void SimHDC1080::set_humidity(double rel_humidity) {
+    double raw = rel_humidity * 65536.0 / 100.0;
+    raw_humidity = static_cast<uint16_t>(std::min(std::max(raw, 0.0), 65535.0)) & 0xFFFC;
+}
+
+std::chrono::microseconds SimHDC1080::conversion_time() const {
+    // conversion times from the datasheet, depending on TRES (bit 10) and HRES (bits 9:8)
+    long t_temperature = (config & 0x0400) ? 3650 : 6350;
+    long t_humidity;
+    switch ((config >> 8) & 3) {
+        case 0:
+            t_humidity = 6500;
+            break;
+        case 1:
+            t_humidity = 3850;
+            break;
+        default:
+            t_humidity = 2500;
+            break;
+    }
+    if (config & 0x1000) {
+        return std::chrono::microseconds(t_temperature + t_humidity);
+    }
+    return std::chrono::microseconds((pointer == 0x00) ? t_temperature : t_humidity);
+}
+
+void SimHDC1080::start_conversion() {
+    if (config & 0x1000) {
+        result[0] = raw_temperature;
+        result[1] = raw_humidity;
+    } else {
+        result[0] = (pointer == 0x00) ? raw_temperature : raw_humidity;
+    }
+    converting = true;
+    conversion_done = clock::now() + conversion_time();
+}
+
+ssize_t SimHDC1080::write(const uint8_t *buffer, size_t buffer_len) {
+    if (buffer_len == 0) {
+        return 0;
+    }
+    pointer = buffer[0];
+    if ((pointer == 0x00) || (pointer == 0x01)) {
+        start_conversion();
+    } else if ((pointer == 0x02) && (buffer_len >= 3)) {
+        uint16_t val = (buffer[1] << 8) | buffer[2];
+        if (val & 0x8000) {
+            config = 0x1000;    // soft reset
+            converting = false;
+        } else {
+            config = (config & 0x0800) | (val & 0x3700);
+        }
+    }
+    return buffer_len;
+}
+
+ssize_t SimHDC1080::read(uint8_t *buffer, size_t buffer_len) {
+    uint16_t words[2] = {0, 0};
+    size_t word_count = 1;
+
+    switch (pointer) {
+        case 0x00:
+        case 0x01:
+            if (converting && (clock::now() < conversion_done)) {
+                return -1;  // conversion still in progress -> NACK
+            }
+            converting = false;
+            words[0] = result[0];
+            words[1] = result[1];
+            word_count = (config & 0x1000) ? 2 : 1;
+            break;
+        case 0x02:
+            words[0] = config;
+            break;
+        case 0xFB:
+            words[0] = 0x0123;
+            break;
+        case 0xFC:
+            words[0] = 0x4567;
+            break;
+        case 0xFD:
+            words[0] = 0x8900;
+            break;
+        case 0xFE:
+            words[0] = 0x5449;
+            break;
+        case 0xFF:
+            words[0] = 0x1050;
+            break;
+        default:
+            break;
+    }
+
+    memset(buffer, 0, buffer_len);
+    for (size_t i = 0; (i < buffer_len) && (i < word_count * 2); i++) {
+        buffer[i] = static_cast<uint8_t>((i & 1) ? (words[i / 2] & 0xFF) : (words[i / 2] >> 8));
+    }
+    return buffer_len;
+}
+
+/***************************************************************************/
+/*  BMP280                                                                 */
+/***************************************************************************/
+
+SimBMP280::SimBMP280() {
+    // trimming parameters of the datasheet example (chapter 3.12)
+    static const uint8_t datasheet_calibration[24] = {
+            0x70, 0x6B, 0x43, 0x67, 0x18, 0xFC,                 // dig_T1..T3
+            0x7D, 0x8E, 0x43, 0xD6, 0xD0, 0x0B, 0x27, 0x0B,     // dig_P1..P4
+            0x8C, 0x00, 0xF9, 0xFF, 0x8C, 0x3C, 0xF8, 0xC6,     // dig_P5..P8
+            0x70, 0x17                                          // dig_P9
+    };
+    memcpy(calibration, datasheet_calibration, sizeof(calibration));
+    reset();
+}
+
+void SimBMP280::set_raw(int32_t adc_T, int32_t adc_P) {
+    this->adc_T = adc_T & 0xFFFFF;
+    this->adc_P = adc_P & 0xFFFFF;
+}
+
+void SimBMP280::set_calibration(const uint8_t *calibration) {
+    memcpy(this->calibration, calibration, sizeof(this->calibration));
+    memcpy(&regs[0x88], this->calibration, sizeof(this->calibration));
+}
+
+void SimBMP280::reset() {
+    memset(regs, 0, sizeof(regs));
+    memcpy(&regs[0x88], calibration, sizeof(calibration));
+    regs[0xD0] = 0x58;
+    regs[0xF7] = 0x80;
+    regs[0xFA] = 0x80;
+    conversions_latched = 0;
+    reset_done = clock::now() + std::chrono::milliseconds(2);   // NVM copy (t_startup)
+    mode_start = clock::now();
+}
+
+static long oversampling(uint8_t osrs) {
+    return (osrs == 0) ? 0 : (1L << (std::min<uint8_t>(osrs, 5) - 1));
+}
+
+std::chrono::microseconds SimBMP280::measurement_time() const {
+    // maximum measurement time, datasheet chapter 3.8.1
+    long t_os = oversampling(regs[0xF4] >> 5);
+    long p_os = oversampling((regs[0xF4] >> 2) & 7);
+    return std::chrono::microseconds(1250 + 2300 * t_os + (p_os ? 2300 * p_os + 575 : 0));
+}
+
+std::chrono::microseconds SimBMP280::standby_time() const {
+    static const long t_sb[8] = {500, 62500, 125000, 250000, 500000, 1000000, 2000000, 4000000};
+    return std::chrono::microseconds(t_sb[regs[0xF5] >> 5]);
+}
+
+void SimBMP280::latch_data() {
+    int32_t p = oversampling((regs[0xF4] >> 2) & 7) ? adc_P : 0x80000;
+    int32_t t = oversampling(regs[0xF4] >> 5) ? adc_T : 0x80000;
+    regs[0xF7] = static_cast<uint8_t>(p >> 12);
+    regs[0xF8] = static_cast<uint8_t>((p >> 4) & 0xFF);
+    regs[0xF9] = static_cast<uint8_t>((p & 0xF) << 4);
+    regs[0xFA] = static_cast<uint8_t>(t >> 12);
+    regs[0xFB] = static_cast<uint8_t>((t >> 4) & 0xFF);
+    regs[0xFC] = static_cast<uint8_t>((t & 0xF) << 4);
+}
+
+void SimBMP280::update() {
+    auto now = clock::now();
+    auto t_meas = measurement_time();
+    uint8_t status = 0;
+
+    if (now < reset_done) {
+        status |= 0x01;     // im_update
+    }
+    switch (regs[0xF4] & 3) {
+        case 0:     // sleep mode
+            break;
+        case 1:
+        case 2:     // forced mode: one conversion, then back to sleep
+            if (now >= mode_start + t_meas) {
+                latch_data();
+                regs[0xF4] &= ~3;
+            } else {
+                status |= 0x08;
+            }
+            break;
+        default: {  // normal mode: conversions separated by t_standby
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - mode_start);
+            auto period = t_meas + standby_time();
+            long completed = (elapsed >= t_meas) ? ((elapsed - t_meas) / period + 1) : 0;
+            if (completed > conversions_latched) {
+                latch_data();
+                conversions_latched = completed;
+            }
+            if ((elapsed % period) < t_meas) {
+                status |= 0x08;
+            }
+            break;
+        }
+    }
+    regs[0xF3] = status;
+}
+
+void SimBMP280::write_register(uint8_t reg, uint8_t val) {
+    switch (reg) {
+        case 0xE0:
+            if (val == 0xB6) {
+                reset();
+            }
+            break;
+        case 0xF4:
+            regs[reg] = val;
+            mode_start = clock::now();
+            conversions_latched = 0;
+            break;
+        case 0xF5:
+            regs[reg] = val;
+            break;
+        default:    // read only register
+            break;
+    }
+}
+
+ssize_t SimBMP280::write(const uint8_t *buffer, size_t buffer_len) {
+    if (buffer_len == 0) {
+        return 0;
+    }
+    update();
+    pointer = buffer[0];
+    // multiple byte write: pairs of register address and register data
+    for (size_t i = 0; i + 1 < buffer_len; i += 2) {
+        write_register(buffer[i], buffer[i + 1]);
+    }
+    return buffer_len;
+}
+
+ssize_t SimBMP280::read(uint8_t *buffer, size_t buffer_len) {
+    update();
+    for (size_t i = 0; i < buffer_len; i++) {
+        buffer[i] = regs[pointer++];
+    }
+    return buffer_len;
+}
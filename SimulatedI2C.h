@@ -0,0 +1,189 @@
+#ifndef IAQ_SIMULATED_I2C_H
+#define IAQ_SIMULATED_I2C_H
+
+#include "I2CTransport.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// In-process model of an I2C bus. Devices are register level models of the chips on the
+// CJMCU-8128 board; they answer the same byte sequences the real chips do (including NACKs
+// while a conversion is still running), so the drivers can be exercised without hardware.
+
+// A device attached to the simulated bus. The bus serializes all calls.
+class SimDevice {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    virtual ~SimDevice() = default;
+
+    // Returns the number of bytes accepted or -1 for a NACK.
+    virtual ssize_t write(const uint8_t *buffer, size_t buffer_len) = 0;
+
+    // Returns the number of bytes delivered or -1 for a NACK.
+    virtual ssize_t read(uint8_t *buffer, size_t buffer_len) = 0;
+};
+
+class SimulatedI2C : public I2CTransport {
+public:
+    SimulatedI2C() = default;
+
+    // Attach a device; replaces any device already present at addr.
+    void attach(uint8_t addr, std::unique_ptr<SimDevice> dev);
+
+    // Attach CCS811, HDC1080 and BMP280 models at the given addresses.
+    void attach_cjmcu8128(uint8_t ccs811_addr = 0x5a, uint8_t hdc1080_addr = 0x40, uint8_t bmp280_addr = 0x76);
+
+    template<class T>
+    T *device(uint8_t addr) {
+        std::lock_guard<std::mutex> guard(lock);
+        return dynamic_cast<T *>(devices[addr & 0x7f].get());
+    }
+
+    ssize_t write(uint8_t addr, const uint8_t *buffer, size_t buffer_len) override;
+
+    ssize_t read(uint8_t addr, uint8_t *buffer, size_t buffer_len) override;
+
+    ssize_t write_read(uint8_t addr, const uint8_t *write_buffer, size_t write_len,
+                       uint8_t *read_buffer, size_t read_len) override;
+
+private:
+    std::unique_ptr<SimDevice> devices[128];
+    std::mutex lock;
+};
+
+// CCS811 model: mailbox selection by a one byte write, boot/application mode, drive modes
+// with the datasheet sample intervals and the DATA_READY flag that is cleared by reading
+// ALG_RESULT_DATA. With INT_DATARDY set in MEAS_MODE, nINT is asserted for every new sample.
+class SimCCS811 : public SimDevice {
+public:
+    SimCCS811();
+
+    ~SimCCS811() override;
+
+    ssize_t write(const uint8_t *buffer, size_t buffer_len) override;
+
+    ssize_t read(uint8_t *buffer, size_t buffer_len) override;
+
+    void set_air_quality(uint16_t eco2, uint16_t tvoc);
+
+    // Override the sample interval of the drive mode (zero restores the datasheet value).
+    void set_sample_interval(std::chrono::microseconds interval);
+
+    // Called on an internal thread when nINT is asserted (falling edge). An empty function
+    // disconnects the line.
+    void set_interrupt(std::function<void()> interrupt);
+
+    uint8_t get_drive_mode() const { return drive_mode; }
+
+    uint16_t get_env_humidity() const { return (env_data[0] << 8) | env_data[1]; }
+
+    uint16_t get_env_temperature() const { return (env_data[2] << 8) | env_data[3]; }
+
+private:
+    bool app_mode = false;
+    uint8_t mailbox = 0x00;
+    uint8_t drive_mode = 0;
+    bool int_datardy = false;
+    bool data_ready = false;
+    uint8_t error_id = 0;
+    uint16_t eco2 = 400;
+    uint16_t tvoc = 0;
+    uint16_t raw_data = (12 << 10) | 400;
+    uint8_t env_data[4] = {0x64, 0x00, 0x64, 0x00};
+    uint8_t baseline[2] = {0x84, 0xb2};
+    std::chrono::microseconds interval_override{0};
+    clock::time_point last_sample;
+
+    // the nINT line is driven by its own thread, so the model has its own lock
+    std::mutex model_lock;
+    std::condition_variable changed;
+    std::function<void()> interrupt;
+    std::thread interrupt_thread;
+    bool stopping = false;
+
+    void interrupt_loop();
+
+    std::chrono::microseconds sample_interval() const;
+
+    void update();
+
+    uint8_t status_register() const;
+};
+
+// HDC1080 model: pointer register, configuration register with soft reset, ID registers and
+// temperature/humidity conversions triggered by the pointer write. Reading the result before
+// the conversion time (depending on the configured resolution) has elapsed is NACKed.
+class SimHDC1080 : public SimDevice {
+public:
+    SimHDC1080();
+
+    ssize_t write(const uint8_t *buffer, size_t buffer_len) override;
+
+    ssize_t read(uint8_t *buffer, size_t buffer_len) override;
+
+    void set_temperature(double temperature);
+
+    void set_humidity(double rel_humidity);
+
+    uint16_t get_config() const { return config; }
+
+private:
+    uint8_t pointer = 0x00;
+    uint16_t config = 0x1000;
+    uint16_t raw_temperature = 0x6666;
+    uint16_t raw_humidity = 0x8000;
+    uint16_t result[2] = {0, 0};
+    bool converting = false;
+    clock::time_point conversion_done;
+
+    void start_conversion();
+
+    std::chrono::microseconds conversion_time() const;
+};
+
+// BMP280 model: auto incrementing register file with the calibration block, soft reset with
+// NVM copy (im_update), sleep/forced/normal mode with measurement and standby timing, and
+// shadowed data registers that are only updated at the end of a conversion.
+class SimBMP280 : public SimDevice {
+public:
+    SimBMP280();
+
+    ssize_t write(const uint8_t *buffer, size_t buffer_len) override;
+
+    ssize_t read(uint8_t *buffer, size_t buffer_len) override;
+
+    // Raw 20 bit ADC words delivered by the next conversions.
+    void set_raw(int32_t adc_T, int32_t adc_P);
+
+    // Replace the 24 byte trimming parameter block (0x88..0x9F).
+    void set_calibration(const uint8_t *calibration);
+
+private:
+    uint8_t regs[256];
+    uint8_t calibration[24];
+    uint8_t pointer = 0x00;
+    int32_t adc_T = 519888;  // datasheet example: 25.08 DegC
+    int32_t adc_P = 415148;  // datasheet example: 100653 Pa
+    clock::time_point reset_done;
+    clock::time_point mode_start;
+    long conversions_latched = 0;
+
+    void reset();
+
+    void write_register(uint8_t reg, uint8_t val);
+
+    void update();
+
+    void latch_data();
+
+    std::chrono::microseconds measurement_time() const;
+
+    std::chrono::microseconds standby_time() const;
+};
+
+#endif //IAQ_SIMULATED_I2C_H
@@ -0,0 +1,55 @@
+#ifndef IAQ_SINGLE_SHOT_PROTOCOL_H
+#define IAQ_SINGLE_SHOT_PROTOCOL_H
+
+#include <cstdint>
+#include <ctime>
+
+enum commands_to_server {
+	CMD_EXIT,
+	CMD_GET_VALUES,
+	CMD_GET_HISTORY,	// followed by struct history_request
+	CMD_SUBSCRIBE		// connection stays open, the server pushes every new sample
+};
+
+// Single-shot protocol: one command_to_server (and its request) per connection, answered with
+// the raw structures below in the native layout of the host (response_from_server is 56 bytes
+// on 32 bit ARM, 64 on x86_64). New clients use the framed protocol (WireProtocol.h), the
+// server tells both apart by the first byte.
+struct command_to_server {
+	uint8_t command;	// see enum commands_to_server
+};
+
+enum history_modes {
+	HISTORY_AFTER_SEQ,	// samples with a sequence number > after_seq
+	HISTORY_TIME_RANGE	// samples with from <= time <= to
+};
+
+struct history_request {
+	uint8_t mode;		// see enum history_modes
+	uint32_t max_samples;	// limit of samples in the response (0: all)
+	uint64_t after_seq;
+	time_t from;
+	time_t to;
+};
+
+// response to CMD_GET_HISTORY, followed by count struct HistorySample (oldest first)
+struct history_response {
+	uint64_t oldest_seq;	// oldest sample still available (0: history empty)
+	uint64_t latest_seq;	// latest sample
+	uint32_t count;
+};
+
+struct response_from_server {
+	time_t server_start;// time of server start
+	time_t time;		// time stamp of measurement time (0: warming up, no values yet)
+	uint16_t co2;		// measured by CCS811
+	uint16_t tvoc;		// measured by CCS811
+	double humidity;	// measured by HDC1080
+	double temp_HDC;	// measured by HDC1080
+	double temp_BMP;	// measured by BMP280
+	double pressure;	// measured by BMP280
+	uint8_t bmp280_status;	// measured by BMP280
+	uint32_t cycle_time;	// duration of the last measurement cycle in ms
+};
+
+#endif
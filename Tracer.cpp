@@ -0,0 +1,142 @@
+#include "Tracer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+std::atomic<bool> Tracer::on{false};
+
+namespace {
+
+// Ring buffer of one thread. Only the owning thread writes; head counts all spans ever
+// recorded and is published after the span has been written.
+struct TraceRing {
+    Tracer::Event events[Tracer::RING_SIZE];
+    std::atomic<uint64_t> head{0};
+    long tid = 0;
+    char name[32] = "";
+};
+
+// The rings are kept until the end of the process, so the spans of finished threads can
+// still be dumped. The lock is only taken when a thread records its first span and by dump().
+std::mutex rings_lock;
+std::vector<std::unique_ptr<TraceRing> > rings;
+
+thread_local TraceRing *thread_ring = nullptr;
+
+TraceRing *get_ring() {
+    if (thread_ring == nullptr) {
+        std::unique_ptr<TraceRing> ring(new TraceRing);
+        ring->tid = syscall(SYS_gettid);
+        thread_ring = ring.get();
+        std::lock_guard<std::mutex> guard(rings_lock);
+        rings.push_back(std::move(ring));
+    }
+    return thread_ring;
+}
+
+const char *kind_name(Tracer::Kind kind) {
+    switch (kind) {
+        case Tracer::TRACE_I2C:
+            return "i2c";
+        case Tracer::TRACE_SLEEP:
+            return "sleep";
+        default:
+            return "phase";
+    }
+}
+
+void write_args(FILE *fp, const Tracer::Event &e) {
+    switch (e.kind) {
+        case Tracer::TRACE_I2C:
+            fprintf(fp, "{\"addr\":\"0x%02x\",\"bytes\":%d}", e.arg0, e.arg1);
+            break;
+        case Tracer::TRACE_SLEEP:
+            fprintf(fp, "{\"requested_us\":%d}", e.arg0);
+            break;
+        default:
+            fprintf(fp, "{\"sensor\":%d,\"result\":%d}", e.arg0, e.arg1);
+            break;
+    }
+}
+
+}
+
+void Tracer::set_thread_name(const char *name) {
+    TraceRing *ring = get_ring();
+    std::lock_guard<std::mutex> guard(rings_lock);
+    strncpy(ring->name, name, sizeof(ring->name) - 1);
+}
+
+int64_t Tracer::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::record(const char *name, Kind kind, int64_t begin_ns, int32_t arg0, int32_t arg1) {
+    TraceRing *ring = get_ring();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    Event &e = ring->events[head & (RING_SIZE - 1)];
+
+    e.name = name;
+    e.kind = kind;
+    e.begin_ns = begin_ns;
+    e.duration_ns = now_ns() - begin_ns;
+    e.arg0 = arg0;
+    e.arg1 = arg1;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+long Tracer::dump(const char *path) {
+    std::vector<Event> events;
+    long pid = getpid(), count = 0;
+    bool first = true;
+    FILE *fp;
+
+    fp = fopen(path, "w");
+    if (fp == nullptr) {
+        return -1;
+    }
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    std::lock_guard<std::mutex> guard(rings_lock);
+    for (auto &ring : rings) {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t first_seq = (head > RING_SIZE) ? head - RING_SIZE : 0;
+        events.clear();
+        for (uint64_t seq = first_seq; seq < head; seq++) {
+            events.push_back(ring->events[seq & (RING_SIZE - 1)]);
+        }
+        // spans the thread has overwritten while they were copied are not consistent
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t now_head = ring->head.load(std::memory_order_relaxed);
+        size_t skip = (now_head > first_seq + RING_SIZE) ? (size_t) (now_head - RING_SIZE - first_seq) : 0;
+
+        if (ring->name[0] != '\0') {
+            fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",", pid, ring->tid, ring->name);
+            first = false;
+        }
+        for (size_t i = skip; i < events.size(); i++) {
+            const Event &e = events[i];
+            fprintf(fp, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld,\"args\":",
+                    first ? "" : ",", e.name, kind_name(e.kind), e.begin_ns / 1000.0, e.duration_ns / 1000.0, pid,
+                    ring->tid);
+            write_args(fp, e);
+            fputc('}', fp);
+            first = false;
+            count++;
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    if (fclose(fp) != 0) {
+        return -1;
+    }
+    return count;
+}
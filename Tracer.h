@@ -0,0 +1,82 @@
+#ifndef IAQ_TRACER_H
+#define IAQ_TRACER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Span tracer for the bus transfers, sleeps and measurement phases, always compiled in and
+// switched on at runtime. Every thread records into its own ring buffer (one writer, no locks);
+// when the tracer is off, a span costs one relaxed load and a branch. dump() writes the spans
+// of all threads in the Chrome trace event format (chrome://tracing, Perfetto).
+//
+//   TraceSpan span("ccs811 write", TRACE_I2C, addr, len);
+//   ...
+//   span.result(ret);
+class Tracer {
+public:
+    static const size_t RING_SIZE = 8192;   // spans per thread (power of 2), the oldest are overwritten
+
+    enum Kind : uint8_t {
+        TRACE_I2C,      // args: addr, bytes (result)
+        TRACE_SLEEP,    // args: requested microseconds
+        TRACE_PHASE     // args: sensor, result
+    };
+
+    struct Event {
+        const char *name;       // string literal
+        int64_t begin_ns;       // steady clock
+        int64_t duration_ns;
+        int32_t arg0;
+        int32_t arg1;
+        Kind kind;
+    };
+
+    static bool enabled() { return on.load(std::memory_order_relaxed); }
+
+    // Async-signal-safe.
+    static void enable(bool enable) { on.store(enable, std::memory_order_relaxed); }
+
+    // Name of the calling thread in the trace (truncated to 31 characters).
+    static void set_thread_name(const char *name);
+
+    static int64_t now_ns();
+
+    static void record(const char *name, Kind kind, int64_t begin_ns, int32_t arg0, int32_t arg1);
+
+    // Writes the recorded spans of all threads to path. Returns the number of spans or -1.
+    // The threads may continue recording, spans overwritten during the copy are skipped.
+    static long dump(const char *path);
+
+private:
+    static std::atomic<bool> on;
+};
+
+// Records the time from construction to destruction if the tracer is enabled at construction.
+class TraceSpan {
+public:
+    TraceSpan(const char *name, Tracer::Kind kind, int32_t arg0 = 0, int32_t arg1 = 0)
+            : name(name), kind(kind), arg0(arg0), arg1(arg1),
+              begin_ns(Tracer::enabled() ? Tracer::now_ns() : -1) {}
+
+    ~TraceSpan() {
+        if (begin_ns >= 0) {
+            Tracer::record(name, kind, begin_ns, arg0, arg1);
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    void result(int32_t r) { arg1 = r; }
+
+private:
+    const char *name;
+    Tracer::Kind kind;
+    int32_t arg0;
+    int32_t arg1;
+    int64_t begin_ns;
+};
+
+#endif //IAQ_TRACER_H
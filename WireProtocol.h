@@ -0,0 +1,210 @@
+#ifndef IAQ_WIRE_PROTOCOL_H
+#define IAQ_WIRE_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Framed client/server protocol.
+//
+// Every request and response is a frame: a 12 byte header followed by length payload bytes.
+//   uint8  magic       FRAME_MAGIC (never a valid command byte of the old single-shot protocol,
+//                      so the server recognizes framed clients by their first byte)
+//   uint8  version     FRAME_VERSION
+//   uint8  type        enum FrameType
+//   uint8  flags       0
+//   uint32 request_id  chosen by the client, copied into the response
+//   uint32 length      of the payload
+// All integers are little endian, doubles are IEEE 754 binary64 (bit pattern as uint64), time
+// stamps are int64 seconds since the epoch. A connection carries any number of frames; the
+// client may send several requests before reading the responses (pipelining), the server
+// answers them in order. FRAME_SUBSCRIBE is the last request of a connection: the server
+// answers the requests before it and then only sends FRAME_PUSH frames.
+//
+// A daemon may manage several boards, identified by their index in its configuration (board
+// id). Requests for values, history or subscriptions take the board id as optional last
+// payload byte (default: board 0).
+
+enum FrameConstants : uint8_t {
+    FRAME_MAGIC = 0xCB,
+    FRAME_VERSION = 2   // 2: history samples carry the channel flags
+};
+
+enum FrameType : uint8_t {
+    FRAME_GET_VALUES = 0x01,    // [u8 board]
+    FRAME_GET_HISTORY = 0x02,   // u8 mode, u32 max_samples, u64 after_seq, i64 from, i64 to, [u8 board]
+    FRAME_EXIT = 0x03,          // no payload, no response
+    FRAME_GET_BOARDS = 0x04,    // no payload
+    FRAME_SET_DRIVE_MODE = 0x05,    // u8 mode (0..4), [u8 board]
+    FRAME_GET_RAW = 0x06,       // u32 max_samples, u64 after_seq, [u8 board]
+    FRAME_SUBSCRIBE = 0x07,     // [u8 board]; answered by FRAME_PUSH frames until the connection is closed
+    FRAME_VALUES = 0x81,        // values (see the server)
+    FRAME_HISTORY = 0x82,       // u64 oldest_seq, u64 latest_seq, u32 count, count samples
+    FRAME_BOARDS = 0x84,        // u8 count, per board: u8 id, str name, str device, values
+    FRAME_DRIVE_MODE = 0x85,    // u8 mode (requested, applied by the worker of the bus)
+    FRAME_RAW = 0x86,           // u64 oldest_seq, u64 latest_seq, u32 count,
+                                // per sample: u64 seq, i64 time_ms, u8 current_ua, u16 voltage_adc
+    FRAME_PUSH = 0x87,          // u64 seq, u16 flags, u16 fields, the values whose bit is set in fields
+                                // (see the server), with the request_id of FRAME_SUBSCRIBE
+    FRAME_ERROR = 0xFF          // u16 error code, enum FrameError
+};
+
+enum FrameError : uint16_t {
+    FRAME_ERROR_VERSION = 1,    // unsupported version
+    FRAME_ERROR_TYPE = 2,       // unknown request type
+    FRAME_ERROR_PAYLOAD = 3,    // malformed payload
+    FRAME_ERROR_BOARD = 4,      // unknown board id
+    FRAME_ERROR_WARMING_UP = 5, // the sensors of the board are starting, no values yet
+    FRAME_ERROR_BOARD_FAILED = 6    // the sensors of the board failed, it is no longer measured
+};
+
+static const size_t FRAME_HEADER_SIZE = 12;
+static const uint32_t FRAME_MAX_REQUEST_PAYLOAD = 256;
+
+struct FrameHeader {
+    uint8_t version;
+    uint8_t type;
+    uint8_t flags;
+    uint32_t request_id;
+    uint32_t length;
+};
+
+// Appends little endian values to a buffer.
+class WireWriter {
+public:
+    explicit WireWriter(std::vector<uint8_t> &out) : out(out) {}
+
+    void u8(uint8_t v) { out.push_back(v); }
+
+    void u16(uint16_t v) { put(v, 2); }
+
+    void u32(uint32_t v) { put(v, 4); }
+
+    void u64(uint64_t v) { put(v, 8); }
+
+    void i64(int64_t v) { put((uint64_t) v, 8); }
+
+    void f64(double v) {
+        uint64_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        put(bits, 8);
+    }
+
+    // u8 length followed by the bytes (at most 255, longer strings are truncated).
+    void str(const std::string &v) {
+        size_t n = (v.size() < 255) ? v.size() : 255;
+        u8((uint8_t) n);
+        out.insert(out.end(), v.begin(), v.begin() + n);
+    }
+
+    // Writes a frame header with length 0; returns its position for end_frame().
+    size_t begin_frame(uint8_t type, uint32_t request_id) {
+        size_t pos = out.size();
+        u8(FRAME_MAGIC);
+        u8(FRAME_VERSION);
+        u8(type);
+        u8(0);
+        u32(request_id);
+        u32(0);
+        return pos;
+    }
+
+    // Sets the payload length of the frame started at pos.
+    void end_frame(size_t pos) {
+        uint32_t length = (uint32_t) (out.size() - pos - FRAME_HEADER_SIZE);
+        for (size_t i = 0; i < 4; i++) {
+            out[pos + 8 + i] = (uint8_t) (length >> (8 * i));
+        }
+    }
+
+private:
+    std::vector<uint8_t> &out;
+
+    void put(uint64_t v, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            out.push_back((uint8_t) (v >> (8 * i)));
+        }
+    }
+};
+
+// Reads little endian values from a buffer. Reading beyond the end yields 0 and clears ok().
+class WireReader {
+public:
+    WireReader(const uint8_t *data, size_t len) : data(data), len(len) {}
+
+    bool ok() const { return valid; }
+
+    size_t remaining() const { return len; }
+
+    uint8_t u8() { return (uint8_t) get(1); }
+
+    uint16_t u16() { return (uint16_t) get(2); }
+
+    uint32_t u32() { return (uint32_t) get(4); }
+
+    uint64_t u64() { return get(8); }
+
+    int64_t i64() { return (int64_t) get(8); }
+
+    double f64() {
+        uint64_t bits = get(8);
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    std::string str() {
+        size_t n = u8();
+        if (n > len) {
+            valid = false;
+            len = 0;
+            return std::string();
+        }
+        std::string v(reinterpret_cast<const char *>(data), n);
+        data += n;
+        len -= n;
+        return v;
+    }
+
+private:
+    const uint8_t *data;
+    size_t len;
+    bool valid = true;
+
+    uint64_t get(size_t n) {
+        uint64_t v = 0;
+        if (n > len) {
+            valid = false;
+            len = 0;
+            return 0;
+        }
+        for (size_t i = 0; i < n; i++) {
+            v |= (uint64_t) data[i] << (8 * i);
+        }
+        data += n;
+        len -= n;
+        return v;
+    }
+};
+
+// Parses a frame header at the start of data. Returns 1 if the header is complete, 0 if more
+// data is needed, -1 if the data does not start with FRAME_MAGIC.
+inline int frame_parse_header(const uint8_t *data, size_t len, FrameHeader &hdr) {
+    if ((len > 0) && (data[0] != FRAME_MAGIC)) {
+        return -1;
+    }
+    if (len < FRAME_HEADER_SIZE) {
+        return 0;
+    }
+    WireReader r(data + 1, FRAME_HEADER_SIZE - 1);
+    hdr.version = r.u8();
+    hdr.type = r.u8();
+    hdr.flags = r.u8();
+    hdr.request_id = r.u32();
+    hdr.length = r.u32();
+    return 1;
+}
+
+#endif //IAQ_WIRE_PROTOCOL_H
@@ -0,0 +1,419 @@
+/*
+  Benchmark suite of the drivers, filters and server on the simulated bus, with machine
+  readable output for tracking regressions between releases.
+
+    cycle.*          latency of a full measurement: MeasurementCycle::run() with the three
+                     sensors interleaved, and the blocking measure() of each sensor in turn
+    i2c.<driver>.*   bus transactions and bytes per measurement, per driver (CountingI2C)
+    alloc.*          heap allocations per measurement cycle (counting operator new)
+    compensate.*     BMP280 temperature + pressure compensations per second
+    filter.*         ns per set() of value_check and the filter pipelines
+    tracer.*         ns per span with the tracer off
+    server.*         round trips per second against the daemon (started on the simulated
+                     bus and stopped again if none is running; -S skips this)
+
+  The results are written as one JSON object, every result is a flat
+  {"name": ..., "value": ..., "unit": ...} record, so two runs can be compared with any
+  JSON tool. Build with optimisation for meaningful numbers (e.g. -DCMAKE_BUILD_TYPE=Release).
+
+  Usage: benchmarks [-n cycles] [-S] [-o file]
+*/
+
+#include "BMP280.h"
+#include "BMP280Compensation.h"
+#include "CCS811.h"
+#include "CountingI2C.h"
+#include "FilterPipeline.h"
+#include "HDC1080.h"
+#include "MeasurementCycle.h"
+#include "SimulatedI2C.h"
+#include "Tracer.h"
+#include "WireProtocol.h"
+#include "stateful_number.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef CJMCU_BINARY
+#define CJMCU_BINARY "cjmcu"
+#endif
+
+typedef std::chrono::steady_clock bench_clock;
+
+static const char *socket_file = "/tmp/cjmcu-8128";
+static const uint8_t CCS811_ADDR = 0x5a, HDC1080_ADDR = 0x40, BMP280_ADDR = 0x76;
+
+static std::atomic<uint64_t> allocations{0};
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+struct Result {
+    std::string name;
+    double value;
+    const char *unit;
+};
+
+static std::vector<Result> results;
+static volatile double sink;
+
+static void result(const std::string &name, double value, const char *unit) {
+    results.push_back({name, value, unit});
+    fprintf(stderr, "%-40s %14.3f %s\n", name.c_str(), value, unit);
+}
+
+static double percentile(std::vector<double> v, double p) {
+    std::sort(v.begin(), v.end());
+    size_t i = (size_t) (p * (v.size() - 1) + 0.5);
+    return v[i];
+}
+
+static void latency_results(const std::string &name, const std::vector<double> &us) {
+    result(name + ".min", percentile(us, 0), "us");
+    result(name + ".p50", percentile(us, 0.5), "us");
+    result(name + ".p99", percentile(us, 0.99), "us");
+    result(name + ".max", percentile(us, 1), "us");
+}
+
+// Best of a few rounds, in ns per iteration.
+static double ns_per_iteration(size_t n, const std::function<void()> &run) {
+    double best = 0;
+    for (int round = 0; round < 5; round++) {
+        bench_clock::time_point start = bench_clock::now();
+        run();
+        double ns = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / n;
+        if ((round == 0) || (ns < best)) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+static void bench_sensors(unsigned cycles) {
+    auto sim = new SimulatedI2C();
+    sim->attach_cjmcu8128(CCS811_ADDR, HDC1080_ADDR, BMP280_ADDR);
+    // one sample per cycle, as with the 30 s interval of the daemon
+    sim->device<SimCCS811>(CCS811_ADDR)->set_sample_interval(std::chrono::microseconds(1000));
+    CountingI2C bus((std::unique_ptr<I2CTransport>(sim)));
+
+    fprintf(stderr, "initialising the sensors (about 3 s)...\n");
+    CCS811 ccs811(bus, CCS811_ADDR);
+    HDC1080 hdc1080(bus, HDC1080_ADDR);
+    BMP280 bmp280(bus, BMP280_ADDR);
+    MeasurementCycle cycle;
+    cycle.add(&ccs811);
+    cycle.add(&hdc1080);
+    cycle.add(&bmp280);
+
+    const struct {
+        const char *name;
+        uint8_t addr;
+    } drivers[] = {{"ccs811", CCS811_ADDR}, {"hdc1080", HDC1080_ADDR}, {"bmp280", BMP280_ADDR}};
+    uint64_t transactions[3], written[3], read[3];
+    for (int d = 0; d < 3; d++) {
+        transactions[d] = bus.counters(drivers[d].addr).transactions;
+        written[d] = bus.counters(drivers[d].addr).bytes_written;
+        read[d] = bus.counters(drivers[d].addr).bytes_read;
+    }
+
+    std::vector<double> interleaved, sequential;
+    unsigned failed = 0;
+    uint64_t allocated = 0;
+    for (unsigned i = 0; i < cycles; i++) {
+        usleep(1500);   // next CCS811 sample
+        uint64_t before = allocations.load();
+        if (cycle.run() < 0) {
+            failed++;
+        }
+        allocated += allocations.load() - before;
+        interleaved.push_back((double) cycle.last_duration().count());
+    }
+    for (int d = 0; d < 3; d++) {
+        const CountingI2C::Counters &c = bus.counters(drivers[d].addr);
+        std::string prefix = std::string("i2c.") + drivers[d].name;
+        result(prefix + ".transactions_per_cycle", (double) (c.transactions - transactions[d]) / cycles, "1");
+        result(prefix + ".bytes_written_per_cycle", (double) (c.bytes_written - written[d]) / cycles, "B");
+        result(prefix + ".bytes_read_per_cycle", (double) (c.bytes_read - read[d]) / cycles, "B");
+    }
+    for (unsigned i = 0; i < cycles; i++) {
+        usleep(1500);
+        bench_clock::time_point start = bench_clock::now();
+        if ((ccs811.read_sensors() < 0) | (hdc1080.measure() < 0) | (bmp280.measure() < 0)) {
+            failed++;
+        }
+        sequential.push_back(std::chrono::duration<double, std::micro>(bench_clock::now() - start).count());
+    }
+    latency_results("cycle.interleaved", interleaved);
+    latency_results("cycle.sequential", sequential);
+    result("cycle.failed", failed, "1");
+    result("alloc.per_cycle", (double) allocated / cycles, "1");
+}
+
+static void bench_compensation() {
+    const char *hex = "706B436718FC7D8E43D6D00B270B8C00F9FF8C3CF8C67017";  // example of the datasheet
+    uint8_t reg_data[24];
+    BMP280Calibration cal;
+    for (int i = 0; i < 24; i++) {
+        char byte[3] = {hex[2 * i], hex[2 * i + 1], 0};
+        reg_data[i] = (uint8_t) strtoul(byte, nullptr, 16);
+    }
+    cal.decode(reg_data);
+
+    std::mt19937 rng(8128);
+    std::uniform_int_distribution<int32_t> adc_T(480000, 560000), adc_P(300000, 450000);
+    const size_t n = 1 << 16;
+    std::vector<int32_t> t(n), p(n);
+    for (size_t i = 0; i < n; i++) {
+        t[i] = adc_T(rng);
+        p[i] = adc_P(rng);
+    }
+    double ns = ns_per_iteration(n, [&]() {
+        double sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            int32_t t_fine;
+            sum += BMP280DoubleCompensation::temperature(cal, t[i], t_fine);
+            sum += BMP280DoubleCompensation::pressure(cal, p[i], t_fine);
+        }
+        sink = sum;
+    });
+    result("compensate.double", 1e3 / ns, "M/s");
+    ns = ns_per_iteration(n, [&]() {
+        double sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            int32_t t_fine;
+            sum += BMP280IntegerCompensation::temperature(cal, t[i], t_fine);
+            sum += BMP280IntegerCompensation::pressure(cal, p[i], t_fine);
+        }
+        sink = sum;
+    });
+    result("compensate.integer", 1e3 / ns, "M/s");
+}
+
+static void bench_filters() {
+    const size_t n = 1000000;
+    std::mt19937 rng(8128);
+    std::normal_distribution<double> noise(50.0, 8.0);
+    std::vector<double> samples(n);
+    for (size_t i = 0; i < n; i++) {
+        samples[i] = noise(rng);
+    }
+
+    value_check<double> checked(10.0, 600);
+    Pipeline<ToleranceGate> gate(ToleranceGate(10.0, 600));
+    Pipeline<ToleranceGate, Median<5>, Ema<1, 4> > smoothed(ToleranceGate(10.0, 600), Median<5>(), Ema<1, 4>());
+    time_t now = time(nullptr);
+
+    result("filter.value_check", ns_per_iteration(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            checked.set(samples[i]);
+        }
+        sink = checked.get();
+    }), "ns");
+    result("filter.tolerance_gate", ns_per_iteration(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            gate.set(samples[i], now);
+        }
+        sink = gate.get();
+    }), "ns");
+    result("filter.smoothed", ns_per_iteration(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            smoothed.set(samples[i], now);
+        }
+        sink = smoothed.get();
+    }), "ns");
+}
+
+static void bench_tracer() {
+    const size_t n = 10000000;
+    Tracer::enable(false);
+    result("tracer.span_off", ns_per_iteration(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            TraceSpan span("bench", Tracer::TRACE_PHASE, (int32_t) i);
+        }
+    }), "ns");
+}
+
+static int connect_server() {
+    struct sockaddr_un addr;
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_file, sizeof(addr.sun_path) - 1);
+    if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static bool recv_all(int sock, uint8_t *p, size_t len) {
+    while (len > 0) {
+        ssize_t ret = recv(sock, p, len, 0);
+        if (ret <= 0) {
+            if ((ret < 0) && (errno == EINTR)) {
+                continue;
+            }
+            return false;
+        }
+        p += ret;
+        len -= (size_t) ret;
+    }
+    return true;
+}
+
+// Sends depth GET_VALUES frames at once and reads the depth responses.
+static bool round_trips(int sock, unsigned depth, uint32_t &request_id) {
+    std::vector<uint8_t> request;
+    WireWriter w(request);
+    uint8_t header[FRAME_HEADER_SIZE];
+    uint8_t payload[256];
+    FrameHeader hdr;
+
+    for (unsigned i = 0; i < depth; i++) {
+        w.end_frame(w.begin_frame(FRAME_GET_VALUES, request_id + i));
+    }
+    if (send(sock, request.data(), request.size(), 0) != (ssize_t) request.size()) {
+        return false;
+    }
+    for (unsigned i = 0; i < depth; i++) {
+        if (!recv_all(sock, header, sizeof(header)) || (frame_parse_header(header, sizeof(header), hdr) != 1) ||
+            (hdr.type != FRAME_VALUES) || (hdr.request_id != request_id + i) || (hdr.length > sizeof(payload)) ||
+            !recv_all(sock, payload, hdr.length)) {
+            return false;
+        }
+    }
+    request_id += depth;
+    return true;
+}
+
+static void bench_server() {
+    bool started = false;
+    int sock = connect_server();
+    if (sock < 0) {
+        fprintf(stderr, "starting %s on the simulated bus...\n", CJMCU_BINARY);
+        if (system(CJMCU_BINARY " -d sim -v > /dev/null") != 0) {
+            fprintf(stderr, "unable to start the daemon, server benchmarks skipped\n");
+            return;
+        }
+        started = true;
+        sock = connect_server();
+        if (sock < 0) {
+            fprintf(stderr, "unable to connect to %s: %s\n", socket_file, strerror(errno));
+            return;
+        }
+    }
+
+    const unsigned depths[] = {1, 16};
+    uint32_t request_id = 1;
+    for (unsigned depth : depths) {
+        unsigned long long n = 0;
+        bench_clock::time_point start = bench_clock::now(), now = start;
+        while (std::chrono::duration<double>(now - start).count() < 1.0) {
+            if (!round_trips(sock, depth, request_id)) {
+                fprintf(stderr, "round trip failed: %s\n", strerror(errno));
+                break;
+            }
+            n += depth;
+            now = bench_clock::now();
+        }
+        result("server.round_trips.depth" + std::to_string(depth),
+               n / std::chrono::duration<double>(now - start).count(), "1/s");
+    }
+    close(sock);
+    if (started && (system(CJMCU_BINARY " -s") != 0)) {
+        fprintf(stderr, "unable to stop the daemon\n");
+    }
+}
+
+static void write_results(FILE *fp) {
+    fprintf(fp, "{\n  \"suite\": \"cjmcu\",\n  \"compiler\": \"%s\",\n", __VERSION__);
+#ifdef __OPTIMIZE__
+    fprintf(fp, "  \"optimized\": true,\n");
+#else
+    fprintf(fp, "  \"optimized\": false,\n");
+#endif
+    fprintf(fp, "  \"time\": %lld,\n  \"results\": [", (long long) time(nullptr));
+    for (size_t i = 0; i < results.size(); i++) {
+        fprintf(fp, "%s\n    {\"name\": \"%s\", \"value\": %.6g, \"unit\": \"%s\"}", i ? "," : "",
+                results[i].name.c_str(), results[i].value, results[i].unit);
+    }
+    fprintf(fp, "\n  ]\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+    unsigned cycles = 50;
+    bool server = true;
+    const char *output = nullptr;
+    int option;
+
+    while ((option = getopt(argc, argv, "n:So:")) != -1) {
+        switch (option) {
+            case 'n':
+                cycles = (unsigned) atoi(optarg);
+                break;
+            case 'S':
+                server = false;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                cycles = 0;
+                break;
+        }
+    }
+    if (cycles == 0) {
+        fprintf(stderr, "usage: %s [-n cycles] [-S] [-o file]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bench_sensors(cycles);
+    bench_compensation();
+    bench_filters();
+    bench_tracer();
+    if (server) {
+        bench_server();
+    }
+
+    FILE *fp = output ? fopen(output, "w") : stdout;
+    if (fp == nullptr) {
+        fprintf(stderr, "unable to open %s: %s\n", output, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    write_results(fp);
+    if (output) {
+        fclose(fp);
+    }
+    return EXIT_SUCCESS;
+}
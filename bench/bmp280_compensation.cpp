@@ -0,0 +1,126 @@
+/*
+  Accuracy and speed of the BMP280 compensation variants (BMP280Compensation.h).
+
+  For each calibration set the raw ADC range is swept and the integer results are compared
+  with the double precision reference. Only samples whose reference value lies within the
+  operating range of the sensor (-40..85 DegC, 300..1100 hPa) count for the maximum error.
+  Afterwards both variants are timed over the in-range samples.
+
+  Usage: bmp280_compensation [calibration ...]
+    calibration: the 24 byte block read from 0x88 as 48 hex digits; without arguments the
+                 example of the datasheet is used.
+*/
+
+#include "BMP280Compensation.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct Sample {
+    int32_t adc_T;
+    int32_t adc_P;
+};
+
+static const char *datasheet_calibration = "706B436718FC7D8E43D6D00B270B8C00F9FF8C3CF8C67017";
+
+static bool parse_calibration(const char *hex, BMP280Calibration &cal) {
+    uint8_t reg_data[24];
+    if (strlen(hex) != 48) {
+        return false;
+    }
+    for (int i = 0; i < 24; i++) {
+        char byte[3] = {hex[2 * i], hex[2 * i + 1], 0};
+        char *end;
+        reg_data[i] = (uint8_t) strtoul(byte, &end, 16);
+        if (*end != 0) {
+            return false;
+        }
+    }
+    cal.decode(reg_data);
+    return true;
+}
+
+template<class Compensation>
+static double time_variant(const BMP280Calibration &cal, const std::vector<Sample> &samples) {
+    const int rounds = 5;
+    volatile double sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        double sum = 0;
+        for (const Sample &s : samples) {
+            int32_t t_fine;
+            sum += Compensation::temperature(cal, s.adc_T, t_fine);
+            sum += Compensation::pressure(cal, s.adc_P, t_fine);
+        }
+        sink = sink + sum;
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    return (double) ns.count() / ((double) samples.size() * rounds);
+}
+
+static void evaluate(const char *name, const BMP280Calibration &cal) {
+    std::vector<Sample> samples;
+    double max_err_T = 0, max_err_p = 0;
+    Sample worst_T = {0, 0}, worst_p = {0, 0};
+
+    for (int32_t adc_T = 0; adc_T <= 0xFFFFF; adc_T += 16) {
+        int32_t t_fine_d, t_fine_i;
+        double t_d = BMP280DoubleCompensation::temperature(cal, adc_T, t_fine_d);
+        double t_i = BMP280IntegerCompensation::temperature(cal, adc_T, t_fine_i);
+        if ((t_d < -40.0) || (t_d > 85.0)) {
+            continue;
+        }
+        if (fabs(t_d - t_i) > max_err_T) {
+            max_err_T = fabs(t_d - t_i);
+            worst_T.adc_T = adc_T;
+        }
+        if ((adc_T % 4096) != 0) {
+            continue;   // pressure: coarser temperature grid
+        }
+        for (int32_t adc_P = 0; adc_P <= 0xFFFFF; adc_P += 64) {
+            double p_d = BMP280DoubleCompensation::pressure(cal, adc_P, t_fine_d);
+            double p_i = BMP280IntegerCompensation::pressure(cal, adc_P, t_fine_i);
+            if ((p_d < 300.0) || (p_d > 1100.0)) {
+                continue;
+            }
+            samples.push_back({adc_T, adc_P});
+            if (fabs(p_d - p_i) > max_err_p) {
+                max_err_p = fabs(p_d - p_i);
+                worst_p.adc_T = adc_T;
+                worst_p.adc_P = adc_P;
+            }
+        }
+    }
+
+    if (samples.empty()) {
+        printf("%s: no samples in the operating range\n", name);
+        return;
+    }
+    printf("%s: %zu samples in range\n", name, samples.size());
+    printf("  max error temperature: %.4f DegC (adc_T=%d)\n", max_err_T, worst_T.adc_T);
+    printf("  max error pressure:    %.4f hPa (adc_T=%d, adc_P=%d)\n", max_err_p, worst_p.adc_T, worst_p.adc_P);
+    printf("  double:  %.1f ns/sample\n", time_variant<BMP280DoubleCompensation>(cal, samples));
+    printf("  integer: %.1f ns/sample\n", time_variant<BMP280IntegerCompensation>(cal, samples));
+}
+
+int main(int argc, char *argv[]) {
+    BMP280Calibration cal;
+
+    if (argc < 2) {
+        parse_calibration(datasheet_calibration, cal);
+        evaluate("datasheet", cal);
+        return EXIT_SUCCESS;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (!parse_calibration(argv[i], cal)) {
+            fprintf(stderr, "invalid calibration block: %s (expected 48 hex digits)\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        evaluate(argv[i], cal);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,156 @@
+/*
+  Bit-identity and throughput of the batched conversion kernels (ConversionKernels.h).
+
+  Random raw samples (BMP280: the full 20 bit ADC range, HDC1080: all 16 bit values, CCS811:
+  random records including the bit 15 the sensor sometimes sets) are converted once with the
+  per-sample functions of the drivers and once with the batch kernels. The outputs must be
+  identical bit for bit; afterwards both paths are timed.
+
+  Usage: conversion_kernels [samples]
+  Exits with a failure code if any output differs.
+*/
+
+#include "ConversionKernels.h"
+#include "CCS811.h"
+#include "HDC1080.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+typedef std::chrono::steady_clock bench_clock;
+
+static const char *datasheet_calibration = "706B436718FC7D8E43D6D00B270B8C00F9FF8C3CF8C67017";
+
+static void parse_calibration(const char *hex, BMP280Calibration &cal) {
+    uint8_t reg_data[24];
+    for (int i = 0; i < 24; i++) {
+        char byte[3] = {hex[2 * i], hex[2 * i + 1], 0};
+        reg_data[i] = (uint8_t) strtoul(byte, nullptr, 16);
+    }
+    cal.decode(reg_data);
+}
+
+// Best of a few rounds, in samples per second.
+template<class F>
+static double throughput(size_t n, F convert) {
+    double best = 0;
+    for (int r = 0; r < 5; r++) {
+        auto start = bench_clock::now();
+        convert();
+        double s = std::chrono::duration<double>(bench_clock::now() - start).count();
+        if ((s > 0) && (n / s > best)) {
+            best = n / s;
+        }
+    }
+    return best;
+}
+
+static void report(const char *name, bool identical, double scalar, double batch) {
+    printf("%-8s %-9s scalar %8.1f Msamples/s  batch %8.1f Msamples/s  x%.1f\n", name,
+           identical ? "identical" : "DIFFERS", scalar / 1e6, batch / 1e6, batch / scalar);
+}
+
+static bool bench_bmp280(std::mt19937 &rng, size_t n, const BMP280Calibration &cal, const char *name) {
+    std::uniform_int_distribution<int32_t> adc(0, 0xFFFFF);
+    std::vector<int32_t> adc_T(n), adc_P(n);
+    std::vector<double> t_ref(n), p_ref(n), t(n), p(n);
+    for (size_t i = 0; i < n; i++) {
+        adc_T[i] = adc(rng);
+        adc_P[i] = adc(rng);
+    }
+
+    auto scalar = [&]() {
+        int32_t t_fine;
+        for (size_t i = 0; i < n; i++) {
+            t_ref[i] = BMP280Compensation::temperature(cal, adc_T[i], t_fine);
+            p_ref[i] = BMP280Compensation::pressure(cal, adc_P[i], t_fine);
+        }
+    };
+    auto batch = [&]() {
+        bmp280_compensate_batch(cal, adc_T.data(), adc_P.data(), n, t.data(), p.data());
+    };
+    double scalar_rate = throughput(n, scalar);
+    double batch_rate = throughput(n, batch);
+
+    bool identical = (memcmp(t_ref.data(), t.data(), n * sizeof(double)) == 0) &&
+                     (memcmp(p_ref.data(), p.data(), n * sizeof(double)) == 0);
+    report(name, identical, scalar_rate, batch_rate);
+    return identical;
+}
+
+static bool bench_hdc1080(std::mt19937 &rng, size_t n) {
+    std::uniform_int_distribution<uint32_t> word(0, 0xFFFF);
+    std::vector<uint16_t> raw_T(n), raw_H(n);
+    std::vector<float> t_ref(n), h_ref(n), t(n), h(n);
+    for (size_t i = 0; i < n; i++) {
+        raw_T[i] = (uint16_t) i;    // every value at least once if n >= 65536
+        raw_H[i] = (uint16_t) word(rng);
+    }
+
+    auto scalar = [&]() {
+        for (size_t i = 0; i < n; i++) {
+            t_ref[i] = HDC1080::temperature_from_raw(raw_T[i]);
+            h_ref[i] = HDC1080::humidity_from_raw(raw_H[i]);
+        }
+    };
+    auto batch = [&]() {
+        hdc1080_convert_batch(raw_T.data(), raw_H.data(), n, t.data(), h.data());
+    };
+    double scalar_rate = throughput(n, scalar);
+    double batch_rate = throughput(n, batch);
+
+    bool identical = (memcmp(t_ref.data(), t.data(), n * sizeof(float)) == 0) &&
+                     (memcmp(h_ref.data(), h.data(), n * sizeof(float)) == 0);
+    report("HDC1080", identical, scalar_rate, batch_rate);
+    return identical;
+}
+
+static bool bench_ccs811(std::mt19937 &rng, size_t n) {
+    std::uniform_int_distribution<uint32_t> byte(0, 0xFF);
+    std::vector<uint8_t> records(8 * n);
+    std::vector<uint16_t> co2_ref(n), tvoc_ref(n), co2(n), tvoc(n);
+    for (uint8_t &b : records) {
+        b = (uint8_t) byte(rng);
+    }
+
+    auto scalar = [&]() {
+        for (size_t i = 0; i < n; i++) {
+            CCS811::decode_alg_result(&records[8 * i], co2_ref[i], tvoc_ref[i]);
+        }
+    };
+    auto batch = [&]() {
+        ccs811_unpack_batch(records.data(), n, co2.data(), tvoc.data());
+    };
+    double scalar_rate = throughput(n, scalar);
+    double batch_rate = throughput(n, batch);
+
+    bool identical = (co2_ref == co2) && (tvoc_ref == tvoc);
+    report("CCS811", identical, scalar_rate, batch_rate);
+    return identical;
+}
+
+int main(int argc, char *argv[]) {
+    size_t n = 1 << 20;
+    if (argc > 1) {
+        n = strtoul(argv[1], nullptr, 0);
+    }
+    // odd count: the scalar tail of the kernels is exercised as well
+    n |= 1;
+
+    std::mt19937 rng(8128);
+    BMP280Calibration cal;
+    parse_calibration(datasheet_calibration, cal);
+    BMP280Calibration no_p1 = cal;
+    no_p1.dig_P1 = 0;   // pressure() takes the division by zero guard for every sample
+
+    printf("%zu samples, kernels: %s\n", n, conversion_kernels_isa());
+    bool ok = bench_bmp280(rng, n, cal, "BMP280");
+    ok = bench_bmp280(rng, n, no_p1, "BMP280/0") && ok;
+    ok = bench_hdc1080(rng, n) && ok;
+    ok = bench_ccs811(rng, n) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
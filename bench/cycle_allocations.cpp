@@ -0,0 +1,94 @@
+/*
+  Heap allocations of the steady-state measurement cycle (zero-allocation register reads).
+
+  The three drivers are started on the simulated bus and measured in a MeasurementCycle like
+  in the daemon (cycle, then ENV_DATA for the CCS811). After a few warm-up cycles every
+  operator new is counted; the steady-state cycles must not allocate at all.
+
+  Usage: cycle_allocations [cycles]
+  Exits with a failure code if any cycle allocates or fails.
+*/
+
+#include "BMP280.h"
+#include "CCS811.h"
+#include "HDC1080.h"
+#include "MeasurementCycle.h"
+#include "SimulatedI2C.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <unistd.h>
+
+static const uint8_t CCS811_ADDR = 0x5a, HDC1080_ADDR = 0x40, BMP280_ADDR = 0x76;
+static const unsigned WARM_UP_CYCLES = 3;
+
+static std::atomic<uint64_t> allocations{0};
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    free(p);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned cycles = (argc > 1) ? (unsigned) atoi(argv[1]) : 100;
+    unsigned failed = 0;
+    uint64_t allocated = 0;
+
+    auto sim = new SimulatedI2C();
+    sim->attach_cjmcu8128(CCS811_ADDR, HDC1080_ADDR, BMP280_ADDR);
+    // a new CCS811 sample in every cycle, so the complete read path is taken
+    sim->device<SimCCS811>(CCS811_ADDR)->set_sample_interval(std::chrono::microseconds(1000));
+    std::unique_ptr<I2CTransport> bus(sim);
+
+    CCS811 ccs811(*bus, CCS811_ADDR);
+    HDC1080 hdc1080(*bus, HDC1080_ADDR);
+    BMP280 bmp280(*bus, BMP280_ADDR);
+    MeasurementCycle cycle;
+    cycle.add(&ccs811);
+    cycle.add(&hdc1080);
+    cycle.add(&bmp280);
+
+    for (unsigned i = 0; i < WARM_UP_CYCLES + cycles; i++) {
+        usleep(1500);   // next CCS811 sample
+        uint64_t before = allocations.load();
+        if (cycle.run() < 0) {
+            failed++;
+        }
+        ccs811.set_env_data(hdc1080.get_recent_humidity(),
+                            (hdc1080.get_recent_temperature() + bmp280.get_temperature()) / 2);
+        if (i >= WARM_UP_CYCLES) {
+            allocated += allocations.load() - before;
+        }
+    }
+
+    printf("%u cycles: %llu allocation(s), %u failed cycle(s)\n", cycles, (unsigned long long) allocated, failed);
+    return ((allocated == 0) && (failed == 0)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
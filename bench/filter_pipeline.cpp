@@ -0,0 +1,109 @@
+/*
+  Cost of a sample in the filter pipelines (FilterPipeline.h) compared to value_check
+  (stateful_number.h), in ns per set().
+
+  Before timing, Pipeline<ToleranceGate> is checked against value_check: with the same
+  parameters and time stamps both must accept the same samples (value_check reads the
+  clock itself, so the check runs with an initialisation phase of 0 seconds within one
+  second).
+
+  Usage: filter_pipeline [samples]
+  Exits with a failure code if the outputs differ.
+*/
+
+#include "FilterPipeline.h"
+#include "stateful_number.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+typedef std::chrono::steady_clock bench_clock;
+
+static volatile double sink;
+
+// Best of a few rounds, in ns per sample.
+template<class F>
+static double ns_per_sample(size_t n, F run) {
+    double best = 0;
+    for (int round = 0; round < 5; round++) {
+        bench_clock::time_point start = bench_clock::now();
+        run();
+        double ns = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / n;
+        if ((round == 0) || (ns < best)) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    size_t n = (argc > 1) ? strtoul(argv[1], nullptr, 0) : 1000000;
+    std::mt19937 rng(8128);
+    std::normal_distribution<double> noise(50.0, 8.0);
+    std::vector<double> samples(n);
+
+    for (size_t i = 0; i < n; i++) {
+        samples[i] = noise(rng);
+    }
+
+    // same decisions as value_check
+    {
+        value_check<double> reference(10.0, 600, 0);
+        Pipeline<ToleranceGate> gate(ToleranceGate(10.0, 600, 0));
+        size_t checked = (n < 10000) ? n : 10000;
+        time_t now = time(nullptr);
+        for (size_t i = 0; i < checked; i++) {
+            reference.set(samples[i]);
+            gate.set(samples[i], now);
+            if (reference.get() != gate.get()) {
+                printf("FAILED: sample %zu: value_check %.6f, ToleranceGate %.6f\n", i, reference.get(), gate.get());
+                return EXIT_FAILURE;
+            }
+        }
+        if (time(nullptr) != now) {
+            printf("(clock ticked during the check, repeat if it fails)\n");
+        }
+        printf("ToleranceGate matches value_check on %zu samples (%llu rejected)\n", checked,
+               (unsigned long long) gate.get_rejected());
+    }
+
+    value_check<double> checked(10.0, 600);
+    Pipeline<ToleranceGate> gate(ToleranceGate(10.0, 600));
+    Pipeline<ToleranceGate, Median<5>, Ema<1, 4> > smoothed(ToleranceGate(10.0, 600), Median<5>(), Ema<1, 4>());
+    Pipeline<ToleranceGate, Median<5>, Ema<1, 4> > clocked(ToleranceGate(10.0, 600), Median<5>(), Ema<1, 4>());
+    time_t now = time(nullptr);
+
+    double t_check = ns_per_sample(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            checked.set(samples[i]);
+        }
+        sink = checked.get();
+    });
+    double t_gate = ns_per_sample(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            gate.set(samples[i], now);
+        }
+        sink = gate.get();
+    });
+    double t_smoothed = ns_per_sample(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            smoothed.set(samples[i], now);
+        }
+        sink = smoothed.get();
+    });
+    double t_clocked = ns_per_sample(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            clocked.set(samples[i]);
+        }
+        sink = clocked.get();
+    });
+
+    printf("%-48s %8.2f ns/set\n", "value_check<double>", t_check);
+    printf("%-48s %8.2f ns/set\n", "Pipeline<ToleranceGate>", t_gate);
+    printf("%-48s %8.2f ns/set\n", "Pipeline<ToleranceGate, Median<5>, Ema<1, 4>>", t_smoothed);
+    printf("%-48s %8.2f ns/set\n", "  same, time stamp from SystemClock", t_clocked);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,307 @@
+/*
+  Load generator for the socket protocols of the daemon: how many monitoring clients can one
+  daemon serve before the request latency degrades?
+
+  Runs the given number of concurrent clients (one thread each) for the given time. With a
+  target rate the requests are sent open loop on a fixed schedule (rate / clients per client),
+  and the latency is taken from the scheduled send time, so a server falling behind shows up
+  as latency instead of as a lower request rate. Without a rate every client sends its next
+  request as soon as it has the response.
+
+    single  one connection per request (command byte, response_from_server), the protocol of
+            the old clients; this is the mode that overflows the listen backlog
+    framed  one connection per client, one GET_VALUES frame after the other
+
+  Errors are counted by kind: connect refused or backlog full (the connect is non-blocking,
+  so a full backlog is reported instead of waited for), timeouts (1 s), closed connections
+  and invalid responses.
+
+  If no daemon is running on the default socket, one is started on the simulated bus and
+  stopped afterwards.
+
+  Usage: load_generator [-c clients] [-r requests/s] [-d seconds] [-m single|framed] [-s socket]
+*/
+
+#include "SingleShotProtocol.h"
+#include "WireProtocol.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef CJMCU_BINARY
+#define CJMCU_BINARY "cjmcu"
+#endif
+
+typedef std::chrono::steady_clock load_clock;
+
+static const char *const DEFAULT_SOCKET = "/tmp/cjmcu-8128";
+static const char *socket_file = DEFAULT_SOCKET;
+
+static const int TIMEOUT_MS = 1000;
+
+enum load_errors {
+    ERROR_REFUSED,      // ECONNREFUSED, EAGAIN (backlog full) or no socket
+    ERROR_TIMEOUT,
+    ERROR_CLOSED,       // connection closed or reset by the server
+    ERROR_INVALID,      // unexpected response
+    ERROR_COUNT
+};
+
+static const char *error_names[ERROR_COUNT] = {"refused", "timeout", "closed", "invalid"};
+
+struct client_stats {
+    std::vector<uint32_t> latency_us;
+    unsigned long long errors[ERROR_COUNT] = {0};
+};
+
+// Connects without blocking on a full backlog. Returns the socket or -1 (errno set).
+static int connect_server() {
+    struct sockaddr_un addr;
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_file, sizeof(addr.sun_path) - 1);
+    if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        int saved_errno = errno;
+        close(sock);
+        errno = saved_errno;
+        return -1;
+    }
+    return sock;
+}
+
+// Returns -1 (error kind in *error) or 0 when len bytes have been received.
+static int recv_all(int sock, uint8_t *p, size_t len, load_clock::time_point deadline, int *error) {
+    while (len > 0) {
+        int wait_ms = (int) std::chrono::duration_cast<std::chrono::milliseconds>(deadline - load_clock::now()).count();
+        struct pollfd pfd = {sock, POLLIN, 0};
+        if ((wait_ms <= 0) || (poll(&pfd, 1, wait_ms) == 0)) {
+            *error = ERROR_TIMEOUT;
+            return -1;
+        }
+        ssize_t ret = recv(sock, p, len, 0);
+        if (ret < 0) {
+            if ((errno == EINTR) || (errno == EAGAIN)) {
+                continue;
+            }
+            *error = ERROR_CLOSED;
+            return -1;
+        }
+        if (ret == 0) {
+            *error = ERROR_CLOSED;
+            return -1;
+        }
+        p += ret;
+        len -= (size_t) ret;
+    }
+    return 0;
+}
+
+static int single_request(int *error) {
+    struct command_to_server command = {CMD_GET_VALUES};
+    struct response_from_server response;
+    int sock = connect_server();
+    if (sock < 0) {
+        *error = ERROR_REFUSED;
+        return -1;
+    }
+    int ret = -1;
+    if (send(sock, &command, sizeof(command), MSG_NOSIGNAL) != (ssize_t) sizeof(command)) {
+        *error = ERROR_CLOSED;
+    } else {
+        ret = recv_all(sock, (uint8_t *) &response, sizeof(response),
+                       load_clock::now() + std::chrono::milliseconds(TIMEOUT_MS), error);
+    }
+    close(sock);
+    return ret;
+}
+
+static int framed_request(int sock, uint32_t request_id, int *error) {
+    std::vector<uint8_t> request;
+    WireWriter w(request);
+    uint8_t header[FRAME_HEADER_SIZE];
+    uint8_t payload[256];
+    FrameHeader hdr;
+    load_clock::time_point deadline = load_clock::now() + std::chrono::milliseconds(TIMEOUT_MS);
+
+    w.end_frame(w.begin_frame(FRAME_GET_VALUES, request_id));
+    if (send(sock, request.data(), request.size(), MSG_NOSIGNAL) != (ssize_t) request.size()) {
+        *error = ERROR_CLOSED;
+        return -1;
+    }
+    if (recv_all(sock, header, sizeof(header), deadline, error) < 0) {
+        return -1;
+    }
+    if ((frame_parse_header(header, sizeof(header), hdr) != 1) || (hdr.type != FRAME_VALUES) ||
+        (hdr.request_id != request_id) || (hdr.length > sizeof(payload))) {
+        *error = ERROR_INVALID;
+        return -1;
+    }
+    return recv_all(sock, payload, hdr.length, deadline, error);
+}
+
+static void run_client(bool framed, double interval_s, load_clock::time_point start, load_clock::time_point end,
+                       client_stats *stats) {
+    load_clock::duration interval = std::chrono::duration_cast<load_clock::duration>(
+            std::chrono::duration<double>(interval_s));
+    load_clock::time_point scheduled = start;
+    uint32_t request_id = 0;
+    int sock = -1;
+
+    std::this_thread::sleep_until(start);
+    while (scheduled < end) {
+        if (interval_s > 0) {
+            std::this_thread::sleep_until(scheduled);
+        } else {
+            scheduled = load_clock::now();
+        }
+        int error = ERROR_COUNT, ret;
+        if (framed) {
+            if ((sock < 0) && ((sock = connect_server()) < 0)) {
+                error = ERROR_REFUSED;
+                ret = -1;
+            } else {
+                ret = framed_request(sock, ++request_id, &error);
+                if (ret < 0) {
+                    close(sock);
+                    sock = -1;
+                }
+            }
+        } else {
+            ret = single_request(&error);
+        }
+        if (ret < 0) {
+            stats->errors[error]++;
+        } else {
+            stats->latency_us.push_back((uint32_t) std::chrono::duration_cast<std::chrono::microseconds>(
+                    load_clock::now() - scheduled).count());
+        }
+        if (interval_s > 0) {
+            scheduled += interval;
+        }
+    }
+    if (sock >= 0) {
+        close(sock);
+    }
+}
+
+static double percentile(const std::vector<uint32_t> &sorted, double p) {
+    return sorted.empty() ? 0 : sorted[(size_t) (p * (sorted.size() - 1) + 0.5)];
+}
+
+int main(int argc, char *argv[]) {
+    unsigned clients = 10;
+    double rate = 0, seconds = 10;
+    bool framed = false, usage = false;
+    int option;
+
+    while ((option = getopt(argc, argv, "c:r:d:m:s:")) != -1) {
+        switch (option) {
+            case 'c':
+                clients = (unsigned) atoi(optarg);
+                break;
+            case 'r':
+                rate = atof(optarg);
+                break;
+            case 'd':
+                seconds = atof(optarg);
+                break;
+            case 'm':
+                framed = (strcmp(optarg, "framed") == 0);
+                usage = usage || (!framed && (strcmp(optarg, "single") != 0));
+                break;
+            case 's':
+                socket_file = optarg;
+                break;
+            default:
+                usage = true;
+                break;
+        }
+    }
+    if (usage || (clients == 0) || (rate < 0) || (seconds <= 0)) {
+        fprintf(stderr, "usage: %s [-c clients] [-r requests/s] [-d seconds] [-m single|framed] [-s socket]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bool started = false;
+    int probe = connect_server();
+    if ((probe < 0) && (socket_file != DEFAULT_SOCKET)) {
+        fprintf(stderr, "unable to connect to %s: %s\n", socket_file, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (probe < 0) {
+        fprintf(stderr, "starting %s on the simulated bus...\n", CJMCU_BINARY);
+        if (system(CJMCU_BINARY " -d sim -v > /dev/null") != 0) {
+            fprintf(stderr, "unable to start the daemon\n");
+            return EXIT_FAILURE;
+        }
+        started = true;
+    } else {
+        close(probe);
+    }
+
+    std::vector<client_stats> stats(clients);
+    std::vector<std::thread> threads;
+    load_clock::time_point start = load_clock::now() + std::chrono::milliseconds(100);
+    load_clock::time_point end = start + std::chrono::duration_cast<load_clock::duration>(
+            std::chrono::duration<double>(seconds));
+    double interval = (rate > 0) ? clients / rate : 0;
+    for (unsigned i = 0; i < clients; i++) {
+        // spread the schedules of the clients over one interval
+        load_clock::time_point client_start = start + std::chrono::duration_cast<load_clock::duration>(
+                std::chrono::duration<double>(interval * i / clients));
+        threads.push_back(std::thread(run_client, framed, interval, client_start, end, &stats[i]));
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    double elapsed = std::chrono::duration<double>(load_clock::now() - start).count();
+
+    std::vector<uint32_t> latency;
+    unsigned long long errors[ERROR_COUNT] = {0}, error_total = 0;
+    for (auto &s : stats) {
+        latency.insert(latency.end(), s.latency_us.begin(), s.latency_us.end());
+        for (int e = 0; e < ERROR_COUNT; e++) {
+            errors[e] += s.errors[e];
+            error_total += s.errors[e];
+        }
+    }
+    std::sort(latency.begin(), latency.end());
+
+    printf("mode %s, %u clients, target %s, %.1f s\n", framed ? "framed" : "single", clients,
+           (rate > 0) ? (std::to_string((long long) rate) + " requests/s").c_str() : "max", elapsed);
+    printf("requests      %10zu ok, %llu errors\n", latency.size(), error_total);
+    printf("throughput    %10.0f requests/s\n", latency.size() / elapsed);
+    printf("latency p50   %10.0f us\n", percentile(latency, 0.5));
+    printf("latency p99   %10.0f us\n", percentile(latency, 0.99));
+    printf("latency p999  %10.0f us\n", percentile(latency, 0.999));
+    printf("latency max   %10.0f us\n", percentile(latency, 1));
+    for (int e = 0; e < ERROR_COUNT; e++) {
+        if (errors[e] > 0) {
+            printf("error %-8s %10llu\n", error_names[e], errors[e]);
+        }
+    }
+
+    if (started && (system(CJMCU_BINARY " -s") != 0)) {
+        fprintf(stderr, "unable to stop the daemon\n");
+    }
+    return EXIT_SUCCESS;
+}
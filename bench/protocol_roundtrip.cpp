@@ -0,0 +1,141 @@
+/*
+  Round trips per second of the client/server protocols against a running daemon.
+
+    single-shot  one connection per request (command byte, 64 byte response), the old protocol
+    framed       one connection, one GET_VALUES frame after the other
+    pipelined    one connection, depth GET_VALUES frames in flight
+
+  Start the daemon first, e.g. with the simulated board: cjmcu -d sim -c
+
+  Usage: protocol_roundtrip [seconds per mode] [depth] [socket]
+*/
+
+#include "SingleShotProtocol.h"
+#include "WireProtocol.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+typedef std::chrono::steady_clock bench_clock;
+
+static const char *socket_file = "/tmp/cjmcu-8128";
+
+static int connect_server() {
+    struct sockaddr_un addr;
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_file, sizeof(addr.sun_path) - 1);
+    if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static bool recv_all(int sock, uint8_t *p, size_t len) {
+    while (len > 0) {
+        ssize_t ret = recv(sock, p, len, 0);
+        if (ret <= 0) {
+            if ((ret < 0) && (errno == EINTR)) {
+                continue;
+            }
+            return false;
+        }
+        p += ret;
+        len -= (size_t) ret;
+    }
+    return true;
+}
+
+static bool single_shot() {
+    struct command_to_server command = {CMD_GET_VALUES};
+    struct response_from_server response;
+    int sock = connect_server();
+    if (sock < 0) {
+        return false;
+    }
+    bool ok = (send(sock, &command, sizeof(command), 0) == (ssize_t) sizeof(command))
+              && recv_all(sock, (uint8_t *) &response, sizeof(response));
+    close(sock);
+    return ok;
+}
+
+// Sends depth GET_VALUES frames at once and reads the depth responses.
+static bool framed(int sock, unsigned depth, uint32_t &request_id) {
+    std::vector<uint8_t> request;
+    WireWriter w(request);
+    uint8_t header[FRAME_HEADER_SIZE];
+    uint8_t payload[256];
+    FrameHeader hdr;
+
+    for (unsigned i = 0; i < depth; i++) {
+        w.end_frame(w.begin_frame(FRAME_GET_VALUES, request_id + i));
+    }
+    if (send(sock, request.data(), request.size(), 0) != (ssize_t) request.size()) {
+        return false;
+    }
+    for (unsigned i = 0; i < depth; i++) {
+        if (!recv_all(sock, header, sizeof(header)) || (frame_parse_header(header, sizeof(header), hdr) != 1) ||
+            (hdr.type != FRAME_VALUES) || (hdr.request_id != request_id + i) || (hdr.length > sizeof(payload)) ||
+            !recv_all(sock, payload, hdr.length)) {
+            return false;
+        }
+    }
+    request_id += depth;
+    return true;
+}
+
+// Runs f for the given time; f returns the number of completed round trips or 0 on error.
+template<class F>
+static void measure(const char *name, double seconds, F f) {
+    unsigned long long round_trips = 0;
+    bench_clock::time_point start = bench_clock::now(), now = start;
+    while (std::chrono::duration<double>(now - start).count() < seconds) {
+        unsigned n = f();
+        if (n == 0) {
+            printf("%-24s failed: %s\n", name, strerror(errno));
+            return;
+        }
+        round_trips += n;
+        now = bench_clock::now();
+    }
+    printf("%-24s %10.0f round trips/s\n", name, round_trips / std::chrono::duration<double>(now - start).count());
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = (argc > 1) ? atof(argv[1]) : 2.0;
+    unsigned depth = (argc > 2) ? (unsigned) atoi(argv[2]) : 16;
+    if (argc > 3) {
+        socket_file = argv[3];
+    }
+    if ((seconds <= 0) || (depth == 0)) {
+        fprintf(stderr, "usage: %s [seconds per mode] [depth] [socket]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int sock = connect_server();
+    if (sock < 0) {
+        fprintf(stderr, "unable to connect to %s: %s (is the daemon running?)\n", socket_file, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    uint32_t request_id = 1;
+
+    measure("single-shot", seconds, []() { return single_shot() ? 1u : 0u; });
+    measure("framed", seconds, [&]() { return framed(sock, 1, request_id) ? 1u : 0u; });
+    char name[32];
+    snprintf(name, sizeof(name), "pipelined (depth %u)", depth);
+    measure(name, seconds, [&]() { return framed(sock, depth, request_id) ? depth : 0u; });
+    close(sock);
+    return EXIT_SUCCESS;
+}
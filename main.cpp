@@ -1,9 +1,24 @@
+#include "BaselineStore.h"
 #include "BMP280.h"
 #include "CCS811.h"
+#include "ChannelRegistry.h"
+#include "CountingI2C.h"
+#include "DataReady.h"
 #include "HDC1080.h"
-#include "stateful_number.h"
+#include "LinuxI2C.h"
+#include "MeasurementCycle.h"
+#include "Metrics.h"
+#include "RawDataBuffer.h"
+#include "SampleHistory.h"
+#include "SampleLog.h"
+#include "SeqlockSnapshot.h"
+#include "SingleShotProtocol.h"
+#include "WireProtocol.h"
+#include "SimulatedI2C.h"
+#include "Tracer.h"
 
 #define I2C_DEVICE	"/dev/i2c-1"
+#define I2C_DEVICE_SIMULATED	"sim"	// in-process model of the board instead of a real bus ("sim1", "sim2", ...: more buses)
 #define CLIENT_SERVER
 
 #ifdef CLIENT_SERVER	// to select the application to build by this file
@@ -17,61 +32,172 @@
 #include <string.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/un.h>
 #include <sys/socket.h>
 #include <errno.h>
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 /***************************************************************************/
 /*  data definitions...                                                    */
 /***************************************************************************/
 
 #define SOCKET_FILE "/tmp/cjmcu-8128"
+#define METRICS_SOCKET_FILE "/tmp/cjmcu-8128.metrics"	// text exposition of the metrics for every connection
+#define SNAPSHOT_SEGMENT "/cjmcu-8128"	// POSIX shared memory with the latest response_from_server
+#define SNAPSHOT_VERSION	1	// layout of struct response_from_server in the segment
+#define SAMPLE_LOG_FILE "/tmp/cjmcu-8128.log"	// persistent sample log (rotated to .1, .2, ...)
+#define BASELINE_DIR "/var/lib/cjmcu-8128"	// created if missing
+#define BASELINE_FILE BASELINE_DIR "/baseline"	// checkpoint of the CCS811 baseline
+#define BASELINE_FALLBACK_FILE "/tmp/cjmcu-8128.baseline"	// if BASELINE_DIR is not writable
+#define TRACE_FILE "/tmp/cjmcu-8128.trace.json"	// SIGUSR1 toggles the tracer, SIGUSR2 dumps it here
 #define MEASURE_LOOP_INTERVAL	30	// in seconds (attention: too short will fail in CC811, should be >=20)
-#define DISPLAY_LOOP_INTERVAL	MEASURE_LOOP_INTERVAL	// client output loop in case of option "-l"
+#define DISPLAY_LOOP_INTERVAL	MEASURE_LOOP_INTERVAL	// client output loop in case of option "-L" with an invalid interval
+#define SERVER_START_TIMEOUT_MS	2000	// client: wait for the socket of a started daemon
+#define WARM_UP_TIMEOUT_MS	5000	// client: wait for the first values of a warming up daemon
+#define CLIENT_POLL_INTERVAL_MS	10
+#define CLIENT_WARMING_UP	(-2)	// client_request(): FRAME_ERROR_WARMING_UP
+#define HISTORY_DEPTH	2880	// samples kept by the server (one day with MEASURE_LOOP_INTERVAL)
+#define BASELINE_CHECKPOINT_INTERVAL	3600	// in seconds
+#define BASELINE_MAX_AGE	(7 * 24 * 3600)	// older checkpoints are not restored (seconds)
+#define BASELINE_CONDITIONING	(20 * 60)	// no checkpoint of a baseline learned in a shorter run (seconds)
+#define RAW_HISTORY_DEPTH	14400	// RAW_DATA samples kept per board (one hour in drive mode 4)
+#define RAW_RESPONSE_MAX	2400	// RAW_DATA samples per FRAME_RAW response
+#define RAW_POLL_INTERVAL_MS	125	// drive mode 4 without data ready: STATUS polled at twice the sample rate
+#define BOARD_MAX	16	// boards managed by one daemon
+#define BOARD_MAX_FAILED_CYCLES	3	// cycles in a row without an answer of any sensor before a board fails
+#define BOARD_DEFAULT_NAME	"cjmcu"	// name of the board without configuration file
+
+// Message pushed to subscribers of the single-shot protocol (CMD_SUBSCRIBE): the header is
+// followed by the fields of struct response_from_server whose bit is set in fields (bit i:
+// push_fields[i]), each with its native size, in the order of push_fields. Framed subscribers
+// (FRAME_SUBSCRIBE) get FRAME_PUSH frames with the same fields in their wire encoding. The
+// first message and every message after a coalesce contain all fields, the others only the
+// fields changed since the previous message.
+struct push_header {
+	uint32_t length;	// of the whole message, including this header
+	uint16_t fields;
+	uint16_t flags;		// see enum push_flags
+	uint64_t seq;		// sequence number of the sample in the history
+};
+
+enum push_flags {
+	PUSH_COALESCED = 1	// the subscriber was too slow, samples before this one were skipped
+};
+
+#define SUBSCRIBER_QUEUE_LIMIT	16	// messages queued per subscriber before they are coalesced
+#define SUBSCRIBER_MAX_OVERFLOWS	4	// coalesces without progress before the subscriber is dropped
+#define FRAMED_OUTPUT_LIMIT	65536	// pending response bytes of a framed connection before it is no longer read
+
+enum push_wire_types {	// encoding of a field in FRAME_PUSH
+	PUSH_WIRE_TIME,		// i64
+	PUSH_WIRE_U8,
+	PUSH_WIRE_U16,
+	PUSH_WIRE_U32,
+	PUSH_WIRE_F64
+};
 
-enum commands_to_server {
-	CMD_EXIT,
-	CMD_GET_VALUES
+struct push_field {
+	size_t offset;
+	size_t size;
+	uint8_t wire;		// see enum push_wire_types
 };
 
-struct command_to_server {
-	uint8_t command;	// see enum commands_to_server
+#define PUSH_FIELD(name, wire)	{offsetof(struct response_from_server, name), sizeof(((struct response_from_server *)0)->name), wire}
+
+static const struct push_field push_fields[] = {
+	PUSH_FIELD(server_start, PUSH_WIRE_TIME),
+	PUSH_FIELD(time, PUSH_WIRE_TIME),
+	PUSH_FIELD(co2, PUSH_WIRE_U16),
+	PUSH_FIELD(tvoc, PUSH_WIRE_U16),
+	PUSH_FIELD(humidity, PUSH_WIRE_F64),
+	PUSH_FIELD(temp_HDC, PUSH_WIRE_F64),
+	PUSH_FIELD(temp_BMP, PUSH_WIRE_F64),
+	PUSH_FIELD(pressure, PUSH_WIRE_F64),
+	PUSH_FIELD(bmp280_status, PUSH_WIRE_U8),
+	PUSH_FIELD(cycle_time, PUSH_WIRE_U32)
 };
 
+#define PUSH_FIELD_COUNT	(sizeof(push_fields) / sizeof(push_fields[0]))
+
+// Measured quantities of a board, one channel each (see ChannelRegistry.h), in the order of
+// board_channels[]. The channel name is also the member of struct response_from_server and
+// HistorySample which receives the value (uint16_t or double).
+enum board_channel_index {
+	CHANNEL_CO2,
+	CHANNEL_TVOC,
+	CHANNEL_HUMIDITY,
+	CHANNEL_TEMP_HDC,
+	CHANNEL_TEMP_BMP,
+	CHANNEL_PRESSURE,
+	BOARD_CHANNEL_COUNT
+};
 
-struct response_from_server_obj {
-	time_t server_start;// time of server start
-	time_t time;		// time stamp of measurement time
-	uint16_t co2;		// measured by CCS811
-	uint16_t tvoc;		// measured by CCS811
-	value_check<double> *humidity;	// measured by HDC1080
-	value_check<double> *temp_HDC;	// measured by HDC1080
-	value_check<double> *temp_BMP;	// measured by BMP280
-	value_check<double> *pressure;	// measured by BMP280	
-	uint8_t bmp280_status;	// measured by BMP280
+struct board_channel {
+	ChannelSpec spec;
+	size_t response_offset;		// in struct response_from_server
+	size_t history_offset;		// in HistorySample
+	size_t size;
 };
 
-struct response_from_server {
-	time_t server_start;// time of server start
-	time_t time;		// time stamp of measurement time
-	uint16_t co2;		// measured by CCS811
-	uint16_t tvoc;		// measured by CCS811
-	double humidity;	// measured by HDC1080
-	double temp_HDC;	// measured by HDC1080
-	double temp_BMP;	// measured by BMP280
-	double pressure;	// measured by BMP280
-	uint8_t bmp280_status;	// measured by BMP280
+#define BOARD_CHANNEL(name, filter, tolerance, timeout)	\
+	{{#name, filter, tolerance, timeout}, offsetof(struct response_from_server, name), offsetof(HistorySample, name), \
+	 sizeof(((struct response_from_server *)0)->name)}
+
+// temperatures pass a tolerance gate against outliers, humidity and pressure are smoothed as well;
+// eCO2 and TVOC only pass a Median<5>, which delays them by two samples (20 s in drive mode 2)
+static const struct board_channel board_channels[BOARD_CHANNEL_COUNT] = {
+	BOARD_CHANNEL(co2, CHANNEL_MEDIAN, 0, 0),
+	BOARD_CHANNEL(tvoc, CHANNEL_MEDIAN, 0, 0),
+	BOARD_CHANNEL(humidity, CHANNEL_SMOOTHED, 10.0, 600),
+	BOARD_CHANNEL(temp_HDC, CHANNEL_GATED, 10.0, 600),
+	BOARD_CHANNEL(temp_BMP, CHANNEL_GATED, 10.0, 600),
+	BOARD_CHANNEL(pressure, CHANNEL_SMOOTHED, 80.0, 600)
 };
 
 struct cjmcu {
+	const char *name;	// of the board, for messages
 	CCS811 *ccs811;
     HDC1080 *hdc1080;
     BMP280 *bmp280;
+    MeasurementCycle *cycle;	// interleaved measurement of all sensors on the bus
+    int ccs811_index, hdc1080_index, bmp280_index;	// indices in cycle (ccs811_index -1: read on data ready)
+};
+
+// One line of the board configuration file (option -C):
+//   <name> <device> [<ccs811 address> <hdc1080 address> <bmp280 address> [<data ready>]]
+struct board_config {
+	std::string name;
+	std::string device;	// I2C device of the bus
+	uint8_t ccs811_addr;
+	uint8_t hdc1080_addr;
+	uint8_t bmp280_addr;
+	std::string ready;	// nINT of the CCS811: "" (none, polled), "<gpiochip>:<line>" or "sim" (simulated bus)
 };
 
 static char *app_name = NULL;
+static const char *i2c_device = I2C_DEVICE;
+static char *loop_time_arg = NULL;
+static char *history_arg = NULL;
+static size_t history_depth = HISTORY_DEPTH;
+static const char *sample_log_file = SAMPLE_LOG_FILE;
+static const char *baseline_file = NULL;	// -k, default: default_baseline_file()
+static std::vector<struct board_config> board_configs;	// boards of a newly started daemon
+static unsigned board_arg = 0;	// board of the value and history queries
+static char *drive_mode_arg = NULL;
+static uint32_t client_request_id = 0;	// of the last framed request
 
 /***************************************************************************/
 /*  server functions...                                                    */
@@ -88,57 +214,79 @@ int init_response_data(struct response_from_server *rsp) {
 	return 0;
 }
 
-int measure(struct cjmcu *cjmcu, struct response_from_server_obj *rsp) {
-	int rc;
-	if ((cjmcu == NULL) || (rsp == NULL)) {
-		syslog(LOG_ERR, "measure(): parameter error");
+// Stores the value of a channel in the member at offset of a response or sample.
+void store_channel(void *dest, size_t offset, size_t size, double value) {
+	uint8_t *p = (uint8_t *)dest + offset;
+	if (size == sizeof(uint16_t)) {
+		uint16_t v = (uint16_t)(value + 0.5);
+		memcpy(p, &v, sizeof(v));
+	} else {
+		memcpy(p, &value, sizeof(value));
+	}
+}
+
+// Takes the raw values of the board from the last measurement cycle of its bus as input of
+// its channels; the values of a failed sensor are skipped. Returns the number of sensors of the
+// cycle which delivered values (0: all failed), -1 on a parameter error.
+int read_measurement(struct cjmcu *cjmcu, ChannelRegistry *channels, size_t base) {
+	int rc, read = 0;
+	if ((cjmcu == NULL) || (channels == NULL)) {
+		syslog(LOG_ERR, "read_measurement(): parameter error");
 		return -1;
 	}
-	if ((cjmcu->bmp280 == NULL) || (cjmcu->ccs811 == NULL) || (cjmcu->hdc1080 == NULL)) {
-		syslog(LOG_ERR, "measure(): parameter error");
+	if ((cjmcu->bmp280 == NULL) || (cjmcu->ccs811 == NULL) || (cjmcu->hdc1080 == NULL) || (cjmcu->cycle == NULL)) {
+		syslog(LOG_ERR, "read_measurement(): parameter error");
 		return -1;
 	}
 
-	// trigger the measurement of the individual sensors:
-	cjmcu->bmp280->measure();
-	if ((rc = cjmcu->ccs811->read_sensors())) {
-		syslog(LOG_WARNING, "[CC811] read sensors failed (%i).", rc);
+	// get BMP280 values:
+	if ((rc = cjmcu->cycle->result(cjmcu->bmp280_index))) {
+		syslog(LOG_WARNING, "%s: [BMP280] read sensors failed (%i).", cjmcu->name, rc);
+		channels->input_failed(base + CHANNEL_PRESSURE);
+		channels->input_failed(base + CHANNEL_TEMP_BMP);
+	} else {
+		channels->input(base + CHANNEL_PRESSURE, cjmcu->bmp280->get_pressure());
+		channels->input(base + CHANNEL_TEMP_BMP, cjmcu->bmp280->get_temperature());
+		read++;
 	}
-	if ((rc = cjmcu->hdc1080->measure())) {
-		syslog(LOG_WARNING, "[HDC1080] read sensors failed (%i).", rc);
+	// get CC811 values (unless read on data ready or the drive mode has no results):
+	if ((cjmcu->ccs811_index < 0) || !cjmcu->ccs811->has_alg_results()) {
+		// see measure_ready()
+	} else if ((rc = cjmcu->cycle->result(cjmcu->ccs811_index))) {
+		syslog(LOG_WARNING, "%s: [CC811] read sensors failed (%i).", cjmcu->name, rc);
+		channels->input_failed(base + CHANNEL_CO2);
+		channels->input_failed(base + CHANNEL_TVOC);
+	} else {
+		channels->input(base + CHANNEL_CO2, cjmcu->ccs811->get_co2());
+		channels->input(base + CHANNEL_TVOC, cjmcu->ccs811->get_tvoc());
+		read++;
 	}
-
-	// get CC811 values:
-	rsp->co2 = cjmcu->ccs811->get_co2();
-	rsp->tvoc = cjmcu->ccs811->get_tvoc();
-	// get BMP280 values:
-	rsp->pressure->set(cjmcu->bmp280->get_pressure());
-	rsp->temp_BMP->set(cjmcu->bmp280->get_temperature());
-	rsp->bmp280_status = cjmcu->bmp280->get_status();
 	// get HDC1080 values:
-	rsp->humidity->set(cjmcu->hdc1080->get_recent_humidity());
-	rsp->temp_HDC->set(cjmcu->hdc1080->get_recent_temperature());
-	// timestamp of this measurement:
-	rsp->time = time(NULL);
-
-	cjmcu->ccs811->set_env_data(rsp->humidity->get(), (rsp->temp_HDC->get() + rsp->temp_BMP->get()) / 2);
-
-	return 0;
+	if ((rc = cjmcu->cycle->result(cjmcu->hdc1080_index))) {
+		syslog(LOG_WARNING, "%s: [HDC1080] read sensors failed (%i).", cjmcu->name, rc);
+		channels->input_failed(base + CHANNEL_HUMIDITY);
+		channels->input_failed(base + CHANNEL_TEMP_HDC);
+	} else {
+		channels->input(base + CHANNEL_HUMIDITY, cjmcu->hdc1080->get_recent_humidity());
+		channels->input(base + CHANNEL_TEMP_HDC, cjmcu->hdc1080->get_recent_temperature());
+		read++;
+	}
+	return read;
 }
 
-int create_server_socket() {
+int create_server_socket(const char *path) {
     int sock;
     struct sockaddr_un server;
 
-    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    sock = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (sock < 0) {
 	syslog(LOG_ERR, "Unable to create socket: %s", strerror(errno));
         return -1;
     }
-    unlink(SOCKET_FILE);
+    unlink(path);
     memset(&server, 0, sizeof(server));
     server.sun_family = AF_UNIX;
-    strncpy(server.sun_path, SOCKET_FILE, sizeof(server.sun_path)-1);
+    strncpy(server.sun_path, path, sizeof(server.sun_path)-1);
     
     if (bind(sock, (struct sockaddr *) &server, sizeof(struct sockaddr_un)) < 0) {
 	syslog(LOG_ERR, "Unable to bind socket: %s", strerror(errno));
@@ -146,7 +294,7 @@ int create_server_socket() {
         return -1;
     }
     
-    if (listen(sock, 5) < 0) {
+    if (listen(sock, SOMAXCONN) < 0) {
 	syslog(LOG_ERR, "Unable to listen to socket: %s", strerror(errno));
 	close(sock);
         return -1;
@@ -154,176 +302,1977 @@ int create_server_socket() {
     return sock;
 }
 
-int init_response(struct response_from_server_obj *p) {
+enum request_kinds {	// for the metrics
+	REQUEST_GET_VALUES,
+	REQUEST_GET_HISTORY,
+	REQUEST_GET_BOARDS,
+	REQUEST_SET_DRIVE_MODE,
+	REQUEST_GET_RAW,
+	REQUEST_SUBSCRIBE,
+	REQUEST_EXIT,
+	REQUEST_INVALID,
+	REQUEST_KIND_COUNT
+};
+
+static const char *request_kind_names[REQUEST_KIND_COUNT] = {
+	"get_values", "get_history", "get_boards", "set_drive_mode", "get_raw", "subscribe", "exit", "invalid"
+};
+
+#define CYCLE_TIME_BUCKETS	{5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 30000}	// ms
+#define REQUEST_LATENCY_BUCKETS	{10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 50000}	// µs
+
+// A CJMCU-8128 managed by the daemon. The sensors and values are only accessed by the
+// worker of its bus, the published data is protected by server_state::lock.
+struct board {
+	uint8_t id;				// index in board_configs, used by the protocol
+	struct board_config config;
+	struct cjmcu device;
+	size_t channel_base;			// first channel in the registry of the worker
+	time_t server_start;
+	time_t time;				// of the last measurement cycle
+	uint8_t bmp280_status;
+	uint32_t cycle_time;			// in ms
+	struct response_from_server snapshot;	// values of the latest measurement cycle or data ready
+	uint64_t snapshot_seq;			// sequence number of the latest sample in the history
+	uint64_t snapshot_version;		// counts the publications of snapshot
+	uint64_t pushed_version;		// latest snapshot pushed to the subscribers (main thread only)
+	bool failed;				// sensors failed, no longer measured (set under server_state::lock)
+	unsigned failed_cycles;			// measurement cycles in a row in which no sensor answered
+	DataReadySource *ready;			// data ready of the CCS811 (NULL: measured by the cycle)
+	SimCCS811 *sim_ccs811;			// drives ready on a simulated bus
+	bool ready_seen;			// a data ready event since the last cycle
+	uint8_t drive_mode;			// of the CCS811, changed by the worker under server_state::lock
+	uint8_t requested_mode;			// by FRAME_SET_DRIVE_MODE, protected by server_state::lock
+	RawDataBuffer *raw;			// RAW_DATA samples (drive mode 4), protected by server_state::lock
+	struct bus_worker *worker;		// of the bus of the board
+	uint64_t rejected[BOARD_CHANNEL_COUNT];	// inputs dropped by the filters (for the metrics)
+	uint8_t channel_flags[BOARD_CHANNEL_COUNT];	// enum ChannelFlags
+	SampleHistory *history;
+	SampleLog *log;				// only used by the worker
+	BaselineStore *baseline;		// only used by the worker
+	time_t baseline_saved;			// time of the last checkpoint (or of the start)
+	bool baseline_restored;
+	SeqlockSnapshot<struct response_from_server> *shm;	// published for socket-free reads (may be NULL)
+	std::string shm_name;
+};
+
+// Measurement worker of one I2C bus: measures all boards on the bus in one interleaved cycle
+// on its own thread, so the buses run in parallel and a slow bus does not delay the others.
+struct bus_worker {
+	std::string device;
+	std::unique_ptr<I2CTransport> bus;
+	CountingI2C *counters;			// the transactions on bus (NULL: the bus could not be opened)
+	MeasurementCycle cycle;
+	ChannelRegistry channels;		// of all boards on the bus
+	std::vector<struct board *> boards;	// measured boards (without the failed ones)
+	std::thread thread;
+	int wake_fd;				// eventfd: wakes the worker for stop and drive mode changes
+	Histogram cycle_time_ms{std::vector<double>(CYCLE_TIME_BUCKETS)};	// protected by server_state::lock
+};
+
+// State shared by the client handling (main thread) and the bus workers.
+struct server_state {
+	std::mutex lock;			// protects the snapshots and histories of the boards and stop
+	std::vector<struct board *> boards;	// by id, not changed while the workers run
+	bool stop;				// the workers are woken by their wake_fd
+	int publish_fd;				// eventfd: a new snapshot has been published (for subscribers)
+	int trace_fd;				// eventfd: SIGUSR1 or SIGUSR2 received
+	std::vector<struct bus_worker *> workers;
+	// metrics of the client handling, only accessed by the main thread:
+	uint64_t requests[REQUEST_KIND_COUNT][2];	// by kind and protocol (0: single-shot, 1: framed)
+	std::vector<Histogram> request_latency_us;	// by kind: complete request to response sent
+};
+
+// A client connection of the non-blocking server: the request is collected until it is
+// complete, then the response is built and sent as far as the socket takes it.
+struct client_connection {
+	uint8_t request[sizeof(struct command_to_server) + sizeof(struct history_request)];
+	size_t request_len;
+	std::vector<uint8_t> response;
+	size_t response_sent;
+	bool wait_writable;			// registered for EPOLLOUT
+	std::chrono::steady_clock::time_point request_time;	// the oldest unanswered request was complete
+	std::vector<uint8_t> pending_kinds;	// of the requests answered by response (for the metrics)
+	// framed protocol only:
+	bool framed;
+	std::vector<uint8_t> in;		// received data not yet processed
+	// subscribers only:
+	bool subscribed;
+	std::deque<std::vector<uint8_t> > queue;	// pushed messages, the front one is sent from response_sent
+	size_t queued_responses;		// entries at the front of queue with responses to earlier requests
+	struct response_from_server pushed;	// values of the last queued message
+	bool push_all;				// next message contains all fields
+	struct board *push_board;		// board of the subscription
+	uint32_t push_request_id;		// framed: request_id of FRAME_SUBSCRIBE
+	unsigned overflows;			// coalesces since the last completely sent message
+};
+
+enum connection_states {
+	CONNECTION_PENDING,	// waiting for more data or for the socket to become writable
+	CONNECTION_DONE,	// response sent or connection failed: close it
+	CONNECTION_EXIT		// CMD_EXIT received
+};
+
+#define MAX_EPOLL_EVENTS	32
+
+// Publishes the values of the board (channel values in the order of board_channels[]): snapshot
+// for CMD_GET_VALUES, shared memory and subscribers; with record also history and log.
+void publish_measurement(struct server_state *state, struct board *board, const double *channels, bool record) {
+	struct response_from_server values;
+	HistorySample sample;
+	size_t i;
+
+	memset(&values, 0, sizeof(values));
+	memset(&sample, 0, sizeof(sample));
+	values.server_start = board->server_start;
+	values.time = sample.time = board->time;
+	values.bmp280_status = sample.bmp280_status = board->bmp280_status;
+	values.cycle_time = sample.cycle_time = board->cycle_time;
+	for (i = 0; i < BOARD_CHANNEL_COUNT; i++) {
+		store_channel(&values, board_channels[i].response_offset, board_channels[i].size, channels[i]);
+		store_channel(&sample, board_channels[i].history_offset, board_channels[i].size, channels[i]);
+		if (board->channel_flags[i] & CHANNEL_FAILED) {
+			sample.channels_failed |= 1 << i;
+		}
+		if (board->channel_flags[i] & CHANNEL_REJECTED) {
+			sample.channels_rejected |= 1 << i;
+		}
+		if (!(board->channel_flags[i] & CHANNEL_VALID)) {
+			sample.channels_invalid |= 1 << i;
+		}
+	}
+	{
+		std::lock_guard<std::mutex> guard(state->lock);
+		board->snapshot = values;
+		board->snapshot_version++;
+		if (record) {
+			sample.seq = board->history->append(sample);
+			board->snapshot_seq = sample.seq;
+		}
+	}
+	eventfd_write(state->publish_fd, 1);
+	if (board->shm) {
+		board->shm->publish(values);
+	}
+	if (record && board->log->is_open() && (board->log->append(sample) < 0)) {
+		syslog(LOG_WARNING, "unable to write sample %llu to %s", (unsigned long long)sample.seq,
+			board->log->get_path().c_str());
+	}
+}
+
+// Opens the sample log and restores the history of the previous server process from it.
+void open_sample_log(SampleLog *log, SampleHistory *history) {
+	size_t n, i, first;
+
+	if (log->open() < 0) {
+		syslog(LOG_WARNING, "unable to open sample log %s, samples are not persisted", log->get_path().c_str());
+		return;
+	}
+	if (log->get_recovered_records() > 0) {
+		syslog(LOG_WARNING, "sample log %s: discarded %zu torn record(s)", log->get_path().c_str(),
+			log->get_recovered_records());
+	}
+	n = log->size();
+	first = (n > history->capacity()) ? n - history->capacity() : 0;
+	for (i = first; i < n; i++) {
+		history->restore(log->at(i));
+	}
+	syslog(LOG_INFO, "restored %zu sample(s) from %s", n - first, log->get_path().c_str());
+}
+
+// Writes the baseline checkpoint of the CCS811 of the board to the sensor, unless it was
+// learned by another sensor or is older than BASELINE_MAX_AGE.
+void restore_baseline(struct board *board) {
+	const CCS811::Identity &id = board->device.ccs811->get_identity();
+	const char *path = board->baseline->get_path().c_str();
+	BaselineRecord record;
+	time_t now = time(NULL);
+
+	if (board->baseline->load(record) < 0) {
+		if (errno != ENOENT) {
+			syslog(LOG_WARNING, "%s: ignoring invalid baseline checkpoint %s", board->device.name, path);
+		}
+		return;
+	}
+	if ((record.hw_id != id.hw_id) || (record.hw_version != id.hw_version) ||
+	    (memcmp(record.fw_app_version, id.fw_app_version, sizeof(record.fw_app_version)) != 0) ||
+	    (record.address != board->config.ccs811_addr) || (board->config.device != record.device)) {
+		syslog(LOG_INFO, "%s: baseline checkpoint %s is of another sensor, not restored", board->device.name, path);
+		return;
+	}
+	if ((record.saved > now) || (now - record.saved > BASELINE_MAX_AGE)) {
+		syslog(LOG_INFO, "%s: baseline checkpoint %s is stale, not restored", board->device.name, path);
+		return;
+	}
+	if (board->device.ccs811->restore_baseline(record.baseline) < 0) {
+		syslog(LOG_WARNING, "%s: unable to restore the CCS811 baseline", board->device.name);
+		return;
+	}
+	board->baseline_restored = true;
+	syslog(LOG_INFO, "%s: restored the CCS811 baseline 0x%02x%02x of %lld min ago", board->device.name,
+	       record.baseline[0], record.baseline[1], (long long)(now - record.saved) / 60);
+}
 
-	if (p) {
-		memset(p, 0, sizeof(*p));
-		p->humidity = new value_check<double>(10.0, 600);
-		if (!p->humidity) {
+// Saves the baseline of the CCS811 of the board every BASELINE_CHECKPOINT_INTERVAL seconds,
+// with force at once. A baseline of a sensor running for less than BASELINE_CONDITIONING
+// without a restored one is not saved.
+void checkpoint_baseline(struct board *board, bool force) {
+	const CCS811::Identity &id = board->device.ccs811->get_identity();
+	BaselineRecord record;
+	time_t now = time(NULL);
+
+	if (!force && (now - board->baseline_saved < BASELINE_CHECKPOINT_INTERVAL)) {
+		return;
+	}
+	if (!board->baseline_restored && (now - board->server_start < BASELINE_CONDITIONING)) {
+		return;
+	}
+	memset(&record, 0, sizeof(record));
+	if (!board->device.ccs811->get_baseline(record.baseline)) {
+		return;
+	}
+	record.hw_id = id.hw_id;
+	record.hw_version = id.hw_version;
+	memcpy(record.fw_app_version, id.fw_app_version, sizeof(record.fw_app_version));
+	record.saved = now;
+	record.address = board->config.ccs811_addr;
+	strncpy(record.device, board->config.device.c_str(), sizeof(record.device) - 1);
+	if (board->baseline->save(record) < 0) {
+		syslog(LOG_WARNING, "%s: unable to write the baseline checkpoint %s: %s", board->device.name,
+		       board->baseline->get_path().c_str(), strerror(errno));
+	}
+	board->baseline_saved = now;
+}
+
+// Takes the board out of the measurement after its sensors failed: its value requests are
+// answered with FRAME_ERROR_BOARD_FAILED, the other boards are measured on. Its shared memory
+// segment is removed, so socket-free readers fall back to the socket and get the error.
+void fail_board(struct server_state *state, struct board *board) {
+	if (board->shm) {
+		SeqlockSnapshot<struct response_from_server>::remove(board->shm_name.c_str());
+		delete board->shm;
+		board->shm = NULL;
+	}
+	std::lock_guard<std::mutex> guard(state->lock);
+	board->failed = true;
+}
+
+// Runs one measurement cycle of all boards on the bus (the waits of all their sensors
+// overlap), filters the values of all their channels in one sweep and publishes them. A board
+// none of whose sensors delivered values keeps its last published values and time stamp; after
+// BOARD_MAX_FAILED_CYCLES such cycles in a row it fails. Returns -1 if no board of the bus is left.
+int measure_bus(struct server_state *state, struct bus_worker *worker) {
+	double channels[BOARD_CHANNEL_COUNT];
+	time_t now;
+	int ret;
+
+	worker->cycle.run();
+	now = time(NULL);
+	syslog(LOG_DEBUG, "measurement cycle of %s took %lld ms", worker->device.c_str(),
+		(long long)(worker->cycle.last_duration().count() / 1000));
+	for (auto board : worker->boards) {
+		if ((ret = read_measurement(&board->device, &worker->channels, board->channel_base)) <= 0) {
+			if ((ret < 0) || (++board->failed_cycles >= BOARD_MAX_FAILED_CYCLES)) {
+				syslog(LOG_ERR, "%s: no sensor answered in %u cycles, the board is no longer measured",
+				       board->device.name, board->failed_cycles);
+				fail_board(state, board);
+			}
+			continue;
+		}
+		board->failed_cycles = 0;
+		board->time = now;
+		board->bmp280_status = board->device.bmp280->get_status();
+		board->cycle_time = (uint32_t)(worker->cycle.last_duration().count() / 1000);
+	}
+	worker->boards.erase(std::remove_if(worker->boards.begin(), worker->boards.end(),
+					    [](const struct board *board) { return board->failed; }),
+			     worker->boards.end());
+	if (worker->boards.empty()) {
+		return -1;
+	}
+	{
+		TraceSpan span("filter", Tracer::TRACE_PHASE, -1);
+		worker->channels.update(now);
+	}
+	{
+		std::lock_guard<std::mutex> guard(state->lock);
+		worker->cycle_time_ms.observe((double)(worker->cycle.last_duration().count() / 1000));
+		for (auto board : worker->boards) {
+			for (size_t i = 0; i < BOARD_CHANNEL_COUNT; i++) {
+				board->rejected[i] = worker->channels.get_rejected(board->channel_base + i);
+				board->channel_flags[i] = worker->channels.get_flags(board->channel_base + i);
+			}
+		}
+	}
+
+	for (auto board : worker->boards) {
+		if (board->failed_cycles > 0) {
+			continue;	// nothing read, the published values stay as they are
+		}
+		TraceSpan span("publish", Tracer::TRACE_PHASE, board->id);
+		worker->channels.copy_values(board->channel_base, BOARD_CHANNEL_COUNT, channels);
+		board->device.ccs811->set_env_data(channels[CHANNEL_HUMIDITY],
+						   (channels[CHANNEL_TEMP_HDC] + channels[CHANNEL_TEMP_BMP]) / 2);
+		publish_measurement(state, board, channels, true);
+	}
+	return 0;
+}
+
+// Reads the RAW_DATA of the CCS811 of the board (drive mode 4) into its raw buffer, if it has
+// a new sample.
+void read_raw(struct server_state *state, struct board *board) {
+	CCS811::RawData data;
+	RawSample sample;
+	int ret;
+
+	if ((ret = board->device.ccs811->read_raw_data(data)) <= 0) {
+		if (ret < 0) {
+			syslog(LOG_WARNING, "%s: [CC811] read raw data failed.", board->device.name);
+		}
+		return;
+	}
+	sample.seq = 0;
+	sample.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	sample.current_ua = data.current_ua;
+	sample.voltage_adc = data.voltage_adc;
+	std::lock_guard<std::mutex> guard(state->lock);
+	board->raw->append(sample);
+}
+
+// Applies the drive modes requested for the CCS811 of the boards on the bus.
+void apply_drive_modes(struct server_state *state, struct bus_worker *worker) {
+	uint8_t mode;
+
+	for (auto board : worker->boards) {
+		{
+			std::lock_guard<std::mutex> guard(state->lock);
+			mode = board->requested_mode;
+		}
+		if (mode == board->drive_mode) {
+			continue;
+		}
+		if (board->device.ccs811->set_drive_mode(mode) < 0) {
+			syslog(LOG_WARNING, "%s: unable to set the drive mode %u of the CCS811", board->device.name, mode);
+			mode = board->drive_mode;
+		} else {
+			syslog(LOG_INFO, "%s: CCS811 drive mode %u", board->device.name, mode);
+		}
+		std::lock_guard<std::mutex> guard(state->lock);
+		board->drive_mode = board->requested_mode = mode;
+	}
+}
+
+// Boards of the bus whose RAW_DATA has to be polled (drive mode 4 without data ready).
+bool raw_polling(struct bus_worker *worker) {
+	for (auto board : worker->boards) {
+		if ((board->drive_mode == 4) && (board->ready == NULL)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Reads the new result of the CCS811 of the board (data ready) and publishes it at once. The
+// other sensors keep the values of the last cycle; the history gets the values of the cycles.
+// In drive mode 4 the new result is a raw sample.
+void measure_ready(struct server_state *state, struct bus_worker *worker, struct board *board) {
+	double channels[BOARD_CHANNEL_COUNT];
+	size_t base = board->channel_base;
+	TraceSpan span("data ready", Tracer::TRACE_PHASE, board->id);
+
+	if (board->drive_mode == 4) {
+		read_raw(state, board);
+		return;
+	}
+	if (!board->device.ccs811->has_alg_results()) {
+		return;
+	}
+	if (board->device.ccs811->read_sensors() < 0) {
+		syslog(LOG_WARNING, "%s: [CC811] read sensors failed.", board->device.name);
+		worker->channels.input_failed(base + CHANNEL_CO2);
+		worker->channels.input_failed(base + CHANNEL_TVOC);
+	} else {
+		worker->channels.input(base + CHANNEL_CO2, board->device.ccs811->get_co2());
+		worker->channels.input(base + CHANNEL_TVOC, board->device.ccs811->get_tvoc());
+	}
+	board->time = time(NULL);
+	worker->channels.update(board->time);
+	{
+		std::lock_guard<std::mutex> guard(state->lock);
+		board->rejected[CHANNEL_CO2] = worker->channels.get_rejected(base + CHANNEL_CO2);
+		board->rejected[CHANNEL_TVOC] = worker->channels.get_rejected(base + CHANNEL_TVOC);
+		board->channel_flags[CHANNEL_CO2] = worker->channels.get_flags(base + CHANNEL_CO2);
+		board->channel_flags[CHANNEL_TVOC] = worker->channels.get_flags(base + CHANNEL_TVOC);
+	}
+	worker->channels.copy_values(base, BOARD_CHANNEL_COUNT, channels);
+	publish_measurement(state, board, channels, false);
+}
+
+// Opens the data ready source of the CCS811 of the board and enables its nINT. Returns NULL if
+// the board has none or it is not available; the CCS811 is then measured by the cycle.
+DataReadySource *open_data_ready(struct board *board, struct bus_worker *worker) {
+	const std::string &spec = board->config.ready;
+	DataReadySource *source;
+
+	board->sim_ccs811 = NULL;
+	if (spec.empty()) {
+		return NULL;
+	}
+	if (spec == "sim") {
+		EventfdDataReady *ready = new EventfdDataReady();
+		SimulatedI2C *sim = dynamic_cast<SimulatedI2C *>(&worker->counters->get_bus());
+		if (sim != NULL) {
+			board->sim_ccs811 = sim->device<SimCCS811>(board->config.ccs811_addr);
+		}
+		if ((board->sim_ccs811 == NULL) || (ready->open() < 0)) {
+			syslog(LOG_WARNING, "%s: no simulated data ready, the CCS811 is polled", board->device.name);
+			board->sim_ccs811 = NULL;
+			delete ready;
+			return NULL;
+		}
+		board->sim_ccs811->set_interrupt([ready]() { ready->signal(); });
+		source = ready;
+	} else {
+		GpioDataReady *gpio = new GpioDataReady();
+		size_t colon = spec.rfind(':');
+		if (gpio->open(spec.substr(0, colon).c_str(), (uint32_t)strtoul(spec.c_str() + colon + 1, NULL, 10)) < 0) {
+			syslog(LOG_WARNING, "%s: unable to request GPIO %s: %s, the CCS811 is polled", board->device.name,
+			       spec.c_str(), strerror(errno));
+			delete gpio;
+			return NULL;
+		}
+		source = gpio;
+	}
+	board->device.ccs811->set_data_ready_interrupt(true);
+	syslog(LOG_INFO, "%s: CCS811 read on data ready (%s)", board->device.name, spec.c_str());
+	return source;
+}
+
+// Creates the sensors of all boards on the bus of the worker. They start up concurrently, so
+// their reset and start times overlap (the bus serializes the transfers); the baseline of the
+// CCS811 is restored right after its start. A board with a failed sensor fails, the others
+// are measured. Returns -1 if no board of the bus started.
+int bring_up_sensors(struct server_state *state, struct bus_worker *worker) {
+	std::vector<const char *> errors(worker->boards.size() * 3, (const char *)NULL);
+	std::vector<std::thread> threads;
+	size_t i;
+
+	if (!worker->bus) {
+		for (auto board : worker->boards) {
+			fail_board(state, board);
+		}
+		worker->boards.clear();
+		return -1;
+	}
+	I2CTransport &bus = *worker->bus;
+
+	for (i = 0; i < worker->boards.size(); i++) {
+		struct board *board = worker->boards[i];
+		const char **error = &errors[i * 3];
+		threads.push_back(std::thread([board, &bus, error]() {
+			try {
+				board->device.ccs811 = new CCS811(bus, board->config.ccs811_addr);
+				restore_baseline(board);
+			} catch (const char *e) {
+				error[0] = e;
+			}
+		}));
+		threads.push_back(std::thread([board, &bus, error]() {
+			try {
+				board->device.hdc1080 = new HDC1080(bus, board->config.hdc1080_addr);
+			} catch (const char *e) {
+				error[1] = e;
+			}
+		}));
+		threads.push_back(std::thread([board, &bus, error]() {
+			try {
+				board->device.bmp280 = new BMP280(bus, board->config.bmp280_addr);
+			} catch (const char *e) {
+				error[2] = e;
+			}
+		}));
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	for (i = 0; i < errors.size(); i++) {
+		if (errors[i] != NULL) {
+			syslog(LOG_ERR, "%s: %s", worker->boards[i / 3]->device.name, errors[i]);
+			fail_board(state, worker->boards[i / 3]);
+		}
+	}
+
+	for (auto board : worker->boards) {
+		if (board->failed) {
+			continue;
+		}
+		board->device.bmp280_index = worker->cycle.add(board->device.bmp280);
+		board->ready = open_data_ready(board, worker);
+		board->device.ccs811_index = (board->ready == NULL) ? worker->cycle.add(board->device.ccs811) : -1;
+		board->device.hdc1080_index = worker->cycle.add(board->device.hdc1080);
+		std::lock_guard<std::mutex> guard(state->lock);
+		board->drive_mode = board->requested_mode = board->device.ccs811->get_drive_mode();
+	}
+	worker->boards.erase(std::remove_if(worker->boards.begin(), worker->boards.end(),
+					    [](const struct board *board) { return board->failed; }),
+			     worker->boards.end());
+	return worker->boards.empty() ? -1 : 0;
+}
+
+// Brings up the sensors of the bus and measures at once, then every MEASURE_LOOP_INTERVAL
+// seconds, and reads the CCS811 of the boards with a data ready source whenever it has a new
+// result, until state->stop is set or no board of the bus is left. The RAW_DATA of boards
+// in drive mode 4 without data ready is polled every RAW_POLL_INTERVAL_MS. The sensors and the
+// value filters of the boards on the bus are only accessed by this thread.
+void measurement_thread(struct server_state *state, struct bus_worker *worker) {
+	struct pollfd fds[1 + MeasurementCycle::MAX_SENSORS];
+	struct board *ready_boards[1 + MeasurementCycle::MAX_SENSORS];
+	std::chrono::steady_clock::time_point next_cycle, next_raw_poll, wake;
+	nfds_t nfds = 0, i;
+	eventfd_t count;
+
+	Tracer::set_thread_name(("bus " + worker->device).c_str());
+	if ((bring_up_sensors(state, worker) < 0) || (measure_bus(state, worker) < 0)) {
+		syslog(LOG_ERR, "start of the sensors on %s failed, no board left", worker->device.c_str());
+		return;
+	}
+	syslog(LOG_INFO, "%zu board(s) on %s initialized", worker->boards.size(), worker->device.c_str());
+	fds[nfds].fd = worker->wake_fd;
+	fds[nfds++].events = POLLIN;
+	for (auto board : worker->boards) {
+		if (board->ready != NULL) {
+			ready_boards[nfds] = board;
+			fds[nfds].fd = board->ready->get_fd();
+			fds[nfds++].events = POLLIN;
+		}
+	}
+
+	next_raw_poll = std::chrono::steady_clock::now();
+	next_cycle = next_raw_poll + std::chrono::seconds(MEASURE_LOOP_INTERVAL);
+	while (true) {
+		bool polling = raw_polling(worker);
+		wake = (polling && (next_raw_poll < next_cycle)) ? next_raw_poll : next_cycle;
+		auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(wake - std::chrono::steady_clock::now());
+		if ((timeout.count() > 0) && (poll(fds, nfds, (int)timeout.count()) < 0) && (errno != EINTR)) {
+			syslog(LOG_ERR, "poll() failed on %s: %s, its boards are no longer measured", worker->device.c_str(),
+			       strerror(errno));
+			for (auto board : worker->boards) {
+				fail_board(state, board);
+			}
+			return;
+		}
+		if (fds[0].revents) {
+			fds[0].revents = 0;
+			eventfd_read(worker->wake_fd, &count);
+			{
+				std::lock_guard<std::mutex> guard(state->lock);
+				if (state->stop) {
+					for (auto board : worker->boards) {
+						checkpoint_baseline(board, true);
+					}
+					return;
+				}
+			}
+			apply_drive_modes(state, worker);
+		}
+		for (i = 1; i < nfds; i++) {
+			if (fds[i].revents && (ready_boards[i]->ready->acknowledge() > 0) && !ready_boards[i]->failed) {
+				ready_boards[i]->ready_seen = true;
+				measure_ready(state, worker, ready_boards[i]);
+			}
+			fds[i].revents = 0;
+		}
+		if (polling && (std::chrono::steady_clock::now() >= next_raw_poll)) {
+			for (auto board : worker->boards) {
+				if ((board->drive_mode == 4) && (board->ready == NULL)) {
+					read_raw(state, board);
+				}
+			}
+			next_raw_poll = std::chrono::steady_clock::now() + std::chrono::milliseconds(RAW_POLL_INTERVAL_MS);
+		}
+		if (std::chrono::steady_clock::now() < next_cycle) {
+			continue;
+		}
+		next_cycle += std::chrono::seconds(MEASURE_LOOP_INTERVAL);
+		if (measure_bus(state, worker) < 0) {
+			syslog(LOG_ERR, "measurement on %s failed, no board left", worker->device.c_str());
+			return;
+		}
+		// an edge may have been missed (e.g. during the start): check the CCS811 for a result
+		for (i = 1; i < nfds; i++) {
+			if (!ready_boards[i]->ready_seen && !ready_boards[i]->failed) {
+				measure_ready(state, worker, ready_boards[i]);
+			}
+			ready_boards[i]->ready_seen = false;
+		}
+		for (auto board : worker->boards) {
+			checkpoint_baseline(board, false);
+		}
+	}
+}
+
+// Bit mask of the fields of cur which differ from prev (all fields if prev is NULL).
+uint16_t push_changed(const struct response_from_server *prev, const struct response_from_server *cur) {
+	const uint8_t *p = (const uint8_t *)prev, *c = (const uint8_t *)cur;
+	uint16_t fields = 0;
+	size_t i;
+
+	for (i = 0; i < PUSH_FIELD_COUNT; i++) {
+		const struct push_field *f = &push_fields[i];
+		if ((prev == NULL) || (memcmp(p + f->offset, c + f->offset, f->size) != 0)) {
+			fields |= 1 << i;
+		}
+	}
+	return fields;
+}
+
+// Encodes the fields of cur which differ from prev (all fields if prev is NULL) as message
+// of the single-shot protocol.
+void push_encode(const struct response_from_server *prev, const struct response_from_server *cur, uint64_t seq,
+		 uint16_t flags, std::vector<uint8_t> *msg) {
+	const uint8_t *c = (const uint8_t *)cur;
+	struct push_header hdr;
+	size_t i;
+
+	msg->resize(sizeof(hdr));
+	hdr.fields = push_changed(prev, cur);
+	for (i = 0; i < PUSH_FIELD_COUNT; i++) {
+		const struct push_field *f = &push_fields[i];
+		if (hdr.fields & (1 << i)) {
+			msg->insert(msg->end(), c + f->offset, c + f->offset + f->size);
+		}
+	}
+	hdr.length = msg->size();
+	hdr.flags = flags;
+	hdr.seq = seq;
+	memcpy(msg->data(), &hdr, sizeof(hdr));
+}
+
+void wire_put_field(WireWriter *w, const struct push_field *f, const struct response_from_server *values) {
+	const uint8_t *p = (const uint8_t *)values + f->offset;
+	time_t t;
+	uint16_t u16;
+	uint32_t u32;
+	double f64;
+
+	switch (f->wire) {
+		case PUSH_WIRE_TIME:
+			memcpy(&t, p, sizeof(t));
+			w->i64(t);
+			break;
+		case PUSH_WIRE_U8:
+			w->u8(*p);
+			break;
+		case PUSH_WIRE_U16:
+			memcpy(&u16, p, sizeof(u16));
+			w->u16(u16);
+			break;
+		case PUSH_WIRE_U32:
+			memcpy(&u32, p, sizeof(u32));
+			w->u32(u32);
+			break;
+		case PUSH_WIRE_F64:
+			memcpy(&f64, p, sizeof(f64));
+			w->f64(f64);
+			break;
+	}
+}
+
+void wire_get_field(WireReader *r, const struct push_field *f, struct response_from_server *values) {
+	uint8_t *p = (uint8_t *)values + f->offset;
+	time_t t;
+	uint16_t u16;
+	uint32_t u32;
+	double f64;
+
+	switch (f->wire) {
+		case PUSH_WIRE_TIME:
+			t = (time_t)r->i64();
+			memcpy(p, &t, sizeof(t));
+			break;
+		case PUSH_WIRE_U8:
+			*p = r->u8();
+			break;
+		case PUSH_WIRE_U16:
+			u16 = r->u16();
+			memcpy(p, &u16, sizeof(u16));
+			break;
+		case PUSH_WIRE_U32:
+			u32 = r->u32();
+			memcpy(p, &u32, sizeof(u32));
+			break;
+		case PUSH_WIRE_F64:
+			f64 = r->f64();
+			memcpy(p, &f64, sizeof(f64));
+			break;
+	}
+}
+
+// Encodes the fields of cur which differ from prev (all fields if prev is NULL) as FRAME_PUSH.
+void push_encode_frame(const struct response_from_server *prev, const struct response_from_server *cur,
+		       uint64_t seq, uint16_t flags, uint32_t request_id, std::vector<uint8_t> *msg) {
+	WireWriter w(*msg);
+	uint16_t fields = push_changed(prev, cur);
+	size_t frame, i;
+
+	msg->clear();
+	frame = w.begin_frame(FRAME_PUSH, request_id);
+	w.u64(seq);
+	w.u16(flags);
+	w.u16(fields);
+	for (i = 0; i < PUSH_FIELD_COUNT; i++) {
+		if (fields & (1 << i)) {
+			wire_put_field(&w, &push_fields[i], cur);
+		}
+	}
+	w.end_frame(frame);
+}
+
+// Applies the payload of a FRAME_PUSH to values.
+int push_apply_frame(const std::vector<uint8_t> &payload, uint64_t *seq, uint16_t *flags,
+		     struct response_from_server *values) {
+	WireReader r(payload.data(), payload.size());
+	uint16_t fields;
+	size_t i;
+
+	*seq = r.u64();
+	*flags = r.u16();
+	fields = r.u16();
+	for (i = 0; i < PUSH_FIELD_COUNT; i++) {
+		if (fields & (1 << i)) {
+			wire_get_field(&r, &push_fields[i], values);
+		}
+	}
+	return (r.ok() && (r.remaining() == 0)) ? 0 : -1;
+}
+
+// Queues a message with the values for a subscriber, in the encoding of its protocol.
+void push_queue(struct client_connection *conn, const struct response_from_server *values, uint64_t seq,
+		uint16_t flags) {
+	const struct response_from_server *prev = conn->push_all ? NULL : &conn->pushed;
+
+	conn->queue.emplace_back();
+	if (conn->framed) {
+		push_encode_frame(prev, values, seq, flags, conn->push_request_id, &conn->queue.back());
+	} else {
+		push_encode(prev, values, seq, flags, &conn->queue.back());
+	}
+	conn->pushed = *values;
+	conn->push_all = false;
+}
+
+// Counts a request for the metrics; if it is answered by a response, its latency is measured
+// when the response has been sent.
+void count_request(struct server_state *state, struct client_connection *conn, int kind, bool answered) {
+	state->requests[kind][conn->framed ? 1 : 0]++;
+	if (answered) {
+		if (conn->pending_kinds.empty()) {
+			conn->request_time = std::chrono::steady_clock::now();
+		}
+		conn->pending_kinds.push_back((uint8_t)kind);
+	}
+}
+
+// The response to the pending requests of the connection has been sent completely.
+void requests_answered(struct server_state *state, struct client_connection *conn) {
+	if (conn->pending_kinds.empty()) {
+		return;
+	}
+	double latency = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() -
+								    conn->request_time).count();
+	for (uint8_t kind : conn->pending_kinds) {
+		state->request_latency_us[kind].observe(latency);
+	}
+	conn->pending_kinds.clear();
+}
+
+void wait_writable(int epfd, int fd, struct client_connection *conn, bool writable) {
+	struct epoll_event ev;
+
+	if (conn->wait_writable == writable) {
+		return;
+	}
+	ev.events = (conn->subscribed ? (uint32_t)EPOLLIN : 0u) | (writable ? (uint32_t)EPOLLOUT : 0u);
+	ev.data.fd = fd;
+	epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+	conn->wait_writable = writable;
+}
+
+// Sends the queued messages of a subscriber as far as the socket takes them; the requests
+// answered before the subscription are counted when their responses are sent.
+int flush_subscriber(int epfd, int fd, struct server_state *state, struct client_connection *conn) {
+	ssize_t ret;
+
+	while (!conn->queue.empty()) {
+		std::vector<uint8_t> &msg = conn->queue.front();
+		ret = send(fd, msg.data() + conn->response_sent, msg.size() - conn->response_sent, MSG_NOSIGNAL);
+		if (ret < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				wait_writable(epfd, fd, conn, true);
+				return CONNECTION_PENDING;
+			}
+			if (errno == EINTR) {
+				continue;
+			}
+			return CONNECTION_DONE;
+		}
+		conn->response_sent += ret;
+		if (conn->response_sent == msg.size()) {
+			conn->queue.pop_front();
+			conn->response_sent = 0;
+			conn->overflows = 0;
+			if ((conn->queued_responses > 0) && (--conn->queued_responses == 0)) {
+				requests_answered(state, conn);
+			}
+		}
+	}
+	wait_writable(epfd, fd, conn, false);
+	return CONNECTION_PENDING;
+}
+
+// Queues a new sample for a subscriber. If its queue is full, the messages not yet started
+// are replaced by one message with all fields (the responses to the requests before the
+// subscription are kept); a subscriber which does not make progress over several coalesces
+// is dropped.
+int push_to_subscriber(int epfd, int fd, struct server_state *state, struct client_connection *conn,
+		       const struct response_from_server *values, uint64_t seq) {
+	uint16_t flags = 0;
+	size_t keep;
+
+	if (conn->queue.size() >= SUBSCRIBER_QUEUE_LIMIT) {
+		if (++conn->overflows > SUBSCRIBER_MAX_OVERFLOWS) {
+			syslog(LOG_WARNING, "dropping subscriber %i: not reading", fd);
+			return CONNECTION_DONE;
+		}
+		keep = std::max(conn->queued_responses, (size_t)((conn->response_sent > 0) ? 1 : 0));
+		conn->queue.erase(conn->queue.begin() + keep, conn->queue.end());
+		conn->push_all = true;
+		flags |= PUSH_COALESCED;
+	}
+	push_queue(conn, values, seq, flags);
+	return flush_subscriber(epfd, fd, state, conn);
+}
+
+// Turns the connection into a subscriber of the board: its latest snapshot is queued with all
+// fields, behind the responses not sent yet. While the board is warming up nothing is queued,
+// its first values are pushed with all fields by push_snapshot().
+void subscribe(struct server_state *state, struct client_connection *conn, struct board *board) {
+	struct response_from_server values;
+	uint64_t seq, version;
+
+	conn->queued_responses = 0;
+	if (!conn->response.empty()) {
+		conn->queue.push_back(std::move(conn->response));
+		conn->response.clear();
+		conn->queued_responses = 1;
+	}
+	{
+		std::lock_guard<std::mutex> guard(state->lock);
+		values = board->snapshot;
+		seq = board->snapshot_seq;
+		version = board->snapshot_version;
+	}
+	conn->subscribed = true;
+	conn->push_board = board;
+	conn->push_all = true;
+	conn->overflows = 0;
+	if (version > 0) {
+		push_queue(conn, &values, seq, 0);
+	}
+}
+
+// Runs a history query on the board; samples is resized to the result. The samples are
+// counted first and the vector is sized outside the lock, only the copy is done under it
+// (samples appended in between are left for the next query).
+void query_history(struct server_state *state, struct board *board, const struct history_request *req,
+		   std::vector<HistorySample> *samples, struct history_response *hdr) {
+	size_t max;
+
+	{
+		std::lock_guard<std::mutex> guard(state->lock);
+		if (req->mode == HISTORY_TIME_RANGE) {
+			max = board->history->count_in_range(req->from, req->to);
+		} else {
+			max = board->history->count_after(req->after_seq);
+		}
+	}
+	if ((req->max_samples > 0) && (req->max_samples < max)) {
+		max = req->max_samples;
+	}
+	samples->resize(max);
+
+	std::lock_guard<std::mutex> guard(state->lock);
+	if (req->mode == HISTORY_TIME_RANGE) {
+		hdr->count = board->history->in_range(req->from, req->to, samples->data(), max);
+	} else {
+		hdr->count = board->history->after(req->after_seq, samples->data(), max);
+	}
+	hdr->oldest_seq = board->history->oldest_seq();
+	hdr->latest_seq = board->history->latest_seq();
+	samples->resize(hdr->count);
+}
+
+// Response to CMD_GET_HISTORY (board 0): struct history_response followed by the matching samples.
+void build_history_response(struct server_state *state, const struct history_request *req,
+			    std::vector<uint8_t> *response) {
+	struct history_response hdr;
+	std::vector<HistorySample> samples;
+
+	query_history(state, state->boards[0], req, &samples, &hdr);
+	response->resize(sizeof(hdr) + samples.size() * sizeof(HistorySample));
+	memcpy(response->data(), &hdr, sizeof(hdr));
+	memcpy(response->data() + sizeof(hdr), samples.data(), samples.size() * sizeof(HistorySample));
+}
+
+/* framed protocol: field encoding (see WireProtocol.h) */
+
+void wire_put_values(WireWriter *w, const struct response_from_server *v) {
+	w->i64(v->server_start);
+	w->i64(v->time);
+	w->u16(v->co2);
+	w->u16(v->tvoc);
+	w->f64(v->humidity);
+	w->f64(v->temp_HDC);
+	w->f64(v->temp_BMP);
+	w->f64(v->pressure);
+	w->u8(v->bmp280_status);
+	w->u32(v->cycle_time);
+}
+
+int wire_get_values(WireReader *r, struct response_from_server *v) {
+	memset(v, 0, sizeof(*v));
+	v->server_start = (time_t)r->i64();
+	v->time = (time_t)r->i64();
+	v->co2 = r->u16();
+	v->tvoc = r->u16();
+	v->humidity = r->f64();
+	v->temp_HDC = r->f64();
+	v->temp_BMP = r->f64();
+	v->pressure = r->f64();
+	v->bmp280_status = r->u8();
+	v->cycle_time = r->u32();
+	return r->ok() ? 0 : -1;
+}
+
+void wire_put_sample(WireWriter *w, const HistorySample *s) {
+	w->u64(s->seq);
+	w->i64(s->time);
+	w->u16(s->co2);
+	w->u16(s->tvoc);
+	w->f64(s->humidity);
+	w->f64(s->temp_HDC);
+	w->f64(s->temp_BMP);
+	w->f64(s->pressure);
+	w->u8(s->bmp280_status);
+	w->u8(s->channels_failed);
+	w->u8(s->channels_rejected);
+	w->u8(s->channels_invalid);
+	w->u32(s->cycle_time);
+}
+
+int wire_get_sample(WireReader *r, HistorySample *s) {
+	s->seq = r->u64();
+	s->time = (time_t)r->i64();
+	s->co2 = r->u16();
+	s->tvoc = r->u16();
+	s->humidity = r->f64();
+	s->temp_HDC = r->f64();
+	s->temp_BMP = r->f64();
+	s->pressure = r->f64();
+	s->bmp280_status = r->u8();
+	s->channels_failed = r->u8();
+	s->channels_rejected = r->u8();
+	s->channels_invalid = r->u8();
+	s->cycle_time = r->u32();
+	return r->ok() ? 0 : -1;
+}
+
+void wire_put_error(WireWriter *w, uint32_t request_id, uint16_t code) {
+	size_t frame = w->begin_frame(FRAME_ERROR, request_id);
+	w->u16(code);
+	w->end_frame(frame);
+}
+
+// Board of a request: the optional last payload byte, board 0 without it. NULL if unknown.
+struct board *request_board(struct server_state *state, WireReader *r) {
+	unsigned id = (r->remaining() > 0) ? r->u8() : 0;
+	return (id < state->boards.size()) ? state->boards[id] : NULL;
+}
+
+// Appends the response to one request frame to conn->response.
+int handle_frame(struct server_state *state, struct client_connection *conn, const FrameHeader *hdr,
+		 const uint8_t *payload) {
+	WireWriter w(conn->response);
+	WireReader r(payload, hdr->length);
+	struct response_from_server values;
+	struct history_request req;
+	struct history_response result;
+	std::vector<HistorySample> samples;
+	std::vector<RawSample> raw;
+	struct board *board;
+	uint64_t after_seq, version;
+	uint32_t max;
+	uint8_t mode;
+	bool failed;
+	size_t frame, i;
+
+	if (hdr->version != FRAME_VERSION) {
+		count_request(state, conn, REQUEST_INVALID, true);
+		wire_put_error(&w, hdr->request_id, FRAME_ERROR_VERSION);
+		return CONNECTION_PENDING;
+	}
+	switch (hdr->type) {
+		case FRAME_GET_VALUES:
+			count_request(state, conn, REQUEST_GET_VALUES, true);
+			if ((board = request_board(state, &r)) == NULL) {
+				wire_put_error(&w, hdr->request_id, FRAME_ERROR_BOARD);
+				return CONNECTION_PENDING;
+			}
+			{
+				std::lock_guard<std::mutex> guard(state->lock);
+				values = board->snapshot;
+				version = board->snapshot_version;
+				failed = board->failed;
+			}
+			if (failed) {
+				wire_put_error(&w, hdr->request_id, FRAME_ERROR_BOARD_FAILED);
+				return CONNECTION_PENDING;
+			}
+			if (version == 0) {
+				wire_put_error(&w, hdr->request_id, FRAME_ERROR_WARMING_UP);
+				return CONNECTION_PENDING;
+			}
+			frame = w.begin_frame(FRAME_VALUES, hdr->request_id);
+			wire_put_values(&w, &values);
+			w.end_frame(frame);
+			return CONNECTION_PENDING;
+		case FRAME_GET_HISTORY:
+			count_request(state, conn, REQUEST_GET_HISTORY, true);
+			req.mode = r.u8();
+			req.max_samples = r.u32();
+			req.after_seq = r.u64();
+			req.from = (time_t)r.i64();
+			req.to = (time_t)r.i64();
+			if (!r.ok()) {
+				wire_put_error(&w, hdr->request_id, FRAME_ERROR_PAYLOAD);
+				return CONNECTION_PENDING;
+			}
+			if ((board = request_board(state, &r)) == NULL) {
+				wire_put_error(&w, hdr->request_id, FRAME_ERROR_BOARD);
+				return CONNECTION_PENDING;
+			}
+			query_history(state, board, &req, &samples, &result);
+			frame = w.begin_frame(FRAME_HISTORY, hdr->request_id);
+			w.u64(result.oldest_seq);
+			w.u64(result.latest_seq);
+			w.u32(result.count);
+			for (i = 0; i < samples.size(); i++) {
+				wire_put_sample(&w, &samples[i]);
+			}
+			w.end_frame(frame);
+			return CONNECTION_PENDING;
+		case FRAME_GET_BOARDS:
+			count_request(state, conn, REQUEST_GET_BOARDS, true);
+			frame = w.begin_frame(FRAME_BOARDS, hdr->request_id);
+			w.u8((uint8_t)state->boards.size());
+			for (auto b : state->boards) {
+				{
+					std::lock_guard<std::mutex> guard(state->lock);
+					values = b->snapshot;
+				}
+				w.u8(b->id);
+				w.str(b->config.name);
+				w.str(b->config.device);
+				wire_put_values(&w, &values);
+			}
+			w.end_frame(frame);
+			return CONNECTION_PENDING;
+		case FRAME_SET_DRIVE_MODE:
+			count_request(state, conn, REQUEST_SET_DRIVE_MODE, true);
+			mode = r.u8();
+			if (!r.ok() || (mode > 4)) {
+				wire_put_error(&w, hdr->request_id, FRAME_ERROR_PAYLOAD);
+				return CONNECTION_PENDING;
+			}
+			if ((board = request_board(state, &r)) == NULL) {
+				wire_put_error(&w, hdr->request_id, FRAME_ERROR_BOARD);
+				return CONNECTION_PENDING;
+			}
+			{
+				std::lock_guard<std::mutex> guard(state->lock);
+				version = board->snapshot_version;
+				failed = board->failed;
+				if ((version > 0) && !failed) {
+					board->requested_mode = mode;
+				}
+			}
+			if (failed) {
+				wire_put_error(&w, hdr->request_id, FRAME_ERROR_BOARD_FAILED);
+				return CONNECTION_PENDING;
+			}
+			if (version == 0) {	// the worker sets the mode of the started CCS811
+				wire_put_error(&w, hdr->request_id, FRAME_ERROR_WARMING_UP);
+				return CONNECTION_PENDING;
+			}
+			eventfd_write(board->worker->wake_fd, 1);
+			frame = w.begin_frame(FRAME_DRIVE_MODE, hdr->request_id);
+			w.u8(mode);
+			w.end_frame(frame);
+			return CONNECTION_PENDING;
+		case FRAME_GET_RAW:
+			count_request(state, conn, REQUEST_GET_RAW, true);
+			max = r.u32();
+			after_seq = r.u64();
+			if (!r.ok()) {
+				wire_put_error(&w, hdr->request_id, FRAME_ERROR_PAYLOAD);
+				return CONNECTION_PENDING;
+			}
+			if ((board = request_board(state, &r)) == NULL) {
+				wire_put_error(&w, hdr->request_id, FRAME_ERROR_BOARD);
+				return CONNECTION_PENDING;
+			}
+			if ((max == 0) || (max > RAW_RESPONSE_MAX)) {
+				max = RAW_RESPONSE_MAX;
+			}
+			raw.resize(max);
+			frame = w.begin_frame(FRAME_RAW, hdr->request_id);
+			{
+				std::lock_guard<std::mutex> guard(state->lock);
+				raw.resize(board->raw->after(after_seq, raw.data(), max));
+				w.u64(board->raw->oldest_seq());
+				w.u64(board->raw->latest_seq());
+			}
+			w.u32((uint32_t)raw.size());
+			for (auto &s : raw) {
+				w.u64(s.seq);
+				w.i64(s.time_ms);
+				w.u8(s.current_ua);
+				w.u16(s.voltage_adc);
+			}
+			w.end_frame(frame);
+			return CONNECTION_PENDING;
+		case FRAME_SUBSCRIBE:
+			count_request(state, conn, REQUEST_SUBSCRIBE, false);
+			if ((board = request_board(state, &r)) == NULL) {
+				wire_put_error(&w, hdr->request_id, FRAME_ERROR_BOARD);
+				return CONNECTION_PENDING;
+			}
+			{
+				std::lock_guard<std::mutex> guard(state->lock);
+				failed = board->failed;
+			}
+			if (failed) {
+				wire_put_error(&w, hdr->request_id, FRAME_ERROR_BOARD_FAILED);
+				return CONNECTION_PENDING;
+			}
+			conn->push_request_id = hdr->request_id;
+			subscribe(state, conn, board);
+			return CONNECTION_PENDING;
+		case FRAME_EXIT:
+			count_request(state, conn, REQUEST_EXIT, false);
+			syslog(LOG_INFO, "received EXIT command");
+			return CONNECTION_EXIT;
+		default:
+			count_request(state, conn, REQUEST_INVALID, true);
+			wire_put_error(&w, hdr->request_id, FRAME_ERROR_TYPE);
+			return CONNECTION_PENDING;
+	}
+}
+
+// Handles the complete request frames in conn->in, up to FRAME_SUBSCRIBE.
+int process_frames(struct server_state *state, struct client_connection *conn) {
+	FrameHeader hdr;
+	size_t pos = 0;
+	int rc = CONNECTION_PENDING;
+
+	while ((rc == CONNECTION_PENDING) && !conn->subscribed && (conn->response.size() < FRAMED_OUTPUT_LIMIT)) {
+		int ret = frame_parse_header(conn->in.data() + pos, conn->in.size() - pos, hdr);
+		if (ret < 0) {
+			syslog(LOG_ERR, "received invalid frame");
+			return CONNECTION_DONE;
+		}
+		if (ret == 0) {
+			break;
+		}
+		if (hdr.length > FRAME_MAX_REQUEST_PAYLOAD) {
+			syslog(LOG_ERR, "received too large frame (%u)", hdr.length);
+			return CONNECTION_DONE;
+		}
+		if (conn->in.size() - pos < FRAME_HEADER_SIZE + hdr.length) {
+			break;
+		}
+		rc = handle_frame(state, conn, &hdr, conn->in.data() + pos + FRAME_HEADER_SIZE);
+		pos += FRAME_HEADER_SIZE + hdr.length;
+	}
+	conn->in.erase(conn->in.begin(), conn->in.begin() + pos);
+	return rc;
+}
+
+// Size of the request, as far as it is known from the data received so far.
+size_t request_size(const struct client_connection *conn) {
+	if ((conn->request_len > 0) && (conn->request[0] == CMD_GET_HISTORY)) {
+		return sizeof(struct command_to_server) + sizeof(struct history_request);
+	}
+	return sizeof(struct command_to_server);
+}
+
+// Builds the response to the complete request.
+int handle_request(struct server_state *state, struct client_connection *conn) {
+	struct command_to_server cmd;
+	struct history_request req;
+
+	memcpy(&cmd, conn->request, sizeof(cmd));
+	switch (cmd.command) {
+		case CMD_EXIT:
+			count_request(state, conn, REQUEST_EXIT, false);
+			syslog(LOG_INFO, "received EXIT command");
+			return CONNECTION_EXIT;
+		case CMD_GET_VALUES:
+			count_request(state, conn, REQUEST_GET_VALUES, true);
+			conn->response.resize(sizeof(struct response_from_server));
+			{
+				std::lock_guard<std::mutex> guard(state->lock);
+				memcpy(conn->response.data(), &state->boards[0]->snapshot, sizeof(struct response_from_server));
+			}
+			return CONNECTION_PENDING;
+		case CMD_GET_HISTORY:
+			count_request(state, conn, REQUEST_GET_HISTORY, true);
+			memcpy(&req, conn->request + sizeof(cmd), sizeof(req));
+			build_history_response(state, &req, &conn->response);
+			return CONNECTION_PENDING;
+		case CMD_SUBSCRIBE:
+			count_request(state, conn, REQUEST_SUBSCRIBE, false);
+			subscribe(state, conn, state->boards[0]);
+			return CONNECTION_PENDING;
+		default:
+			count_request(state, conn, REQUEST_INVALID, false);
+			syslog(LOG_ERR, "received invalid command (%i)", cmd.command);
+			return CONNECTION_DONE;
+	}
+}
+
+// Sends conn->response as far as the socket takes it. Returns 1 if everything has been sent,
+// 0 if the socket is full (the connection waits for EPOLLOUT), -1 on error.
+int flush_response(int epfd, int fd, struct server_state *state, struct client_connection *conn) {
+	ssize_t ret;
+
+	while (conn->response_sent < conn->response.size()) {
+		ret = send(fd, conn->response.data() + conn->response_sent, conn->response.size() - conn->response_sent,
+			   MSG_NOSIGNAL);
+		if (ret < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				wait_writable(epfd, fd, conn, true);
+				return 0;
+			}
+			if (errno == EINTR) {
+				continue;
+			}
+			syslog(LOG_ERR, "send() failed: %s", strerror(errno));
+			return -1;
+		}
+		conn->response_sent += ret;
+	}
+	conn->response.clear();
+	conn->response_sent = 0;
+	wait_writable(epfd, fd, conn, false);
+	requests_answered(state, conn);
+	return 1;
+}
+
+// Framed connection: reads the pipelined requests, answers all complete ones in one batch.
+// While responses are pending, no further requests are read (the client has to read them).
+int serve_framed(int epfd, int fd, struct server_state *state, struct client_connection *conn) {
+	uint8_t buffer[4096];
+	bool closed = false;
+	ssize_t ret;
+	int rc;
+
+	rc = flush_response(epfd, fd, state, conn);
+	if (rc <= 0) {
+		return (rc < 0) ? CONNECTION_DONE : CONNECTION_PENDING;
+	}
+
+	while (conn->response.size() < FRAMED_OUTPUT_LIMIT) {
+		ret = recv(fd, buffer, sizeof(buffer), 0);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+				syslog(LOG_ERR, "recv() failed: %s", strerror(errno));
+				return CONNECTION_DONE;
+			}
+		} else if (ret == 0) {
+			closed = true;
+		} else {
+			conn->in.insert(conn->in.end(), buffer, buffer + ret);
+		}
+		rc = process_frames(state, conn);
+		if (rc != CONNECTION_PENDING) {
+			return rc;
+		}
+		if (conn->subscribed) {
+			return flush_subscriber(epfd, fd, state, conn);
+		}
+		if (ret <= 0) {
+			break;
+		}
+	}
+
+	rc = flush_response(epfd, fd, state, conn);
+	if (rc < 0) {
+		return CONNECTION_DONE;
+	}
+	return (closed && (rc > 0)) ? CONNECTION_DONE : CONNECTION_PENDING;
+}
+
+// Continues the connection after an epoll event, without blocking.
+int serve_connection(int epfd, int fd, struct server_state *state, struct client_connection *conn) {
+	ssize_t ret;
+
+	if (conn->subscribed) {
+		uint8_t discard[64];
+		while ((ret = recv(fd, discard, sizeof(discard), 0)) > 0) {
+			// subscribers do not send anything after subscribing
+		}
+		if ((ret == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))) {
+			return CONNECTION_DONE;	// closed by the subscriber
+		}
+		return flush_subscriber(epfd, fd, state, conn);
+	}
+
+	if (!conn->framed && (conn->request_len == 0)) {
+		uint8_t first;
+		if ((recv(fd, &first, 1, MSG_PEEK) == 1) && (first == FRAME_MAGIC)) {
+			conn->framed = true;
+		}
+	}
+	if (conn->framed) {
+		return serve_framed(epfd, fd, state, conn);
+	}
+
+	if (conn->response.empty()) {
+		while (conn->request_len < request_size(conn)) {
+			ret = recv(fd, conn->request + conn->request_len, request_size(conn) - conn->request_len, 0);
+			if (ret < 0) {
+				if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+					return CONNECTION_PENDING;
+				}
+				if (errno == EINTR) {
+					continue;
+				}
+				syslog(LOG_ERR, "recv() failed: %s", strerror(errno));
+				return CONNECTION_DONE;
+			}
+			if (ret == 0) {
+				if (conn->request_len > 0) {
+					syslog(LOG_ERR, "received invalid data size (%u/%u)", (unsigned)conn->request_len,
+						(unsigned)request_size(conn));
+				}
+				return CONNECTION_DONE;
+			}
+			conn->request_len += ret;
+		}
+		ret = handle_request(state, conn);
+		if (ret != CONNECTION_PENDING) {
+			return ret;
+		}
+		if (conn->subscribed) {
+			return flush_subscriber(epfd, fd, state, conn);
+		}
+	}
+
+	if (flush_response(epfd, fd, state, conn) == 0) {
+		return CONNECTION_PENDING;
+	}
+	return CONNECTION_DONE;	// support only one command in a connection!
+}
+
+// Metrics in the text exposition format.
+void write_metrics(struct server_state *state, size_t connections, std::string &out) {
+	time_t now = time(NULL);
+	std::string labels;
+	size_t i, k;
+
+	static const struct {
+		const char *name;
+		const char *help;
+		const std::atomic<uint64_t> CountingI2C::Counters::*counter;
+	} i2c_metrics[] = {
+		{"cjmcu_i2c_transactions_total", "I2C transactions per sensor.", &CountingI2C::Counters::transactions},
+		{"cjmcu_i2c_bytes_written_total", "Bytes written to the sensor.", &CountingI2C::Counters::bytes_written},
+		{"cjmcu_i2c_bytes_read_total", "Bytes read from the sensor.", &CountingI2C::Counters::bytes_read},
+		{"cjmcu_i2c_write_failures_total", "Failed writes.", &CountingI2C::Counters::write_failures},
+		{"cjmcu_i2c_read_failures_total", "Failed reads (including combined transactions).",
+		 &CountingI2C::Counters::read_failures}
+	};
+	for (auto &metric : i2c_metrics) {
+		metric_header(out, metric.name, "counter", metric.help);
+		for (auto board : state->boards) {
+			if (board->worker->counters == NULL) {
+				continue;
+			}
+			const struct { const char *name; uint8_t addr; } sensors[] = {
+				{"ccs811", board->config.ccs811_addr},
+				{"hdc1080", board->config.hdc1080_addr},
+				{"bmp280", board->config.bmp280_addr}
+			};
+			for (auto &sensor : sensors) {
+				labels = "board=\"" + board->config.name + "\",sensor=\"" + sensor.name + "\"";
+				metric_value(out, metric.name, labels,
+					     (double)(board->worker->counters->counters(sensor.addr).*metric.counter).load());
+			}
+		}
+	}
+
+	std::lock_guard<std::mutex> guard(state->lock);
+	metric_header(out, "cjmcu_channel_rejected_total", "counter", "Values dropped by the filter of the channel.");
+	for (auto board : state->boards) {
+		for (i = 0; i < BOARD_CHANNEL_COUNT; i++) {
+			labels = "board=\"" + board->config.name + "\",channel=\"" + board_channels[i].spec.name + "\"";
+			metric_value(out, "cjmcu_channel_rejected_total", labels, (double)board->rejected[i]);
+		}
+	}
+	metric_header(out, "cjmcu_channel_failed", "gauge", "1 if the last reading of the sensor of the channel failed.");
+	for (auto board : state->boards) {
+		for (i = 0; i < BOARD_CHANNEL_COUNT; i++) {
+			labels = "board=\"" + board->config.name + "\",channel=\"" + board_channels[i].spec.name + "\"";
+			metric_value(out, "cjmcu_channel_failed", labels, (board->channel_flags[i] & CHANNEL_FAILED) ? 1 : 0);
+		}
+	}
+	metric_header(out, "cjmcu_warming_up", "gauge", "1 until the first values of the board are published.");
+	for (auto board : state->boards) {
+		metric_value(out, "cjmcu_warming_up", "board=\"" + board->config.name + "\"",
+			     (board->snapshot_version == 0) ? 1 : 0);
+	}
+	metric_header(out, "cjmcu_board_failed", "gauge", "1 if the sensors of the board failed and it is no longer measured.");
+	for (auto board : state->boards) {
+		metric_value(out, "cjmcu_board_failed", "board=\"" + board->config.name + "\"", board->failed ? 1 : 0);
+	}
+	metric_header(out, "cjmcu_snapshot_age_seconds", "gauge", "Age of the latest published values.");
+	for (auto board : state->boards) {
+		if (board->snapshot_version > 0) {
+			metric_value(out, "cjmcu_snapshot_age_seconds", "board=\"" + board->config.name + "\"",
+				     (double)(now - board->snapshot.time));
+		}
+	}
+	metric_header(out, "cjmcu_ccs811_drive_mode", "gauge", "Drive mode of the CCS811 (0: idle, 4: raw data).");
+	for (auto board : state->boards) {
+		metric_value(out, "cjmcu_ccs811_drive_mode", "board=\"" + board->config.name + "\"", board->drive_mode);
+	}
+	metric_header(out, "cjmcu_raw_samples_total", "counter", "RAW_DATA samples read from the CCS811.");
+	for (auto board : state->boards) {
+		metric_value(out, "cjmcu_raw_samples_total", "board=\"" + board->config.name + "\"",
+			     (double)board->raw->latest_seq());
+	}
+	metric_header(out, "cjmcu_measure_interval_seconds", "gauge", "Interval of the measurement cycles.");
+	metric_value(out, "cjmcu_measure_interval_seconds", "", MEASURE_LOOP_INTERVAL);
+	metric_header(out, "cjmcu_cycle_duration_ms", "histogram", "Duration of the measurement cycles per bus.");
+	for (auto worker : state->workers) {
+		worker->cycle_time_ms.write(out, "cjmcu_cycle_duration_ms", "bus=\"" + worker->device + "\"");
+	}
+
+	metric_header(out, "cjmcu_requests_total", "counter", "Client requests.");
+	for (k = 0; k < REQUEST_KIND_COUNT; k++) {
+		for (i = 0; i < 2; i++) {
+			labels = std::string("kind=\"") + request_kind_names[k] + "\",protocol=\"" +
+				 (i ? "framed" : "single-shot") + "\"";
+			metric_value(out, "cjmcu_requests_total", labels, (double)state->requests[k][i]);
+		}
+	}
+	metric_header(out, "cjmcu_request_latency_us", "histogram", "Complete request to response sent.");
+	for (k = 0; k < REQUEST_KIND_COUNT; k++) {
+		state->request_latency_us[k].write(out, "cjmcu_request_latency_us",
+						   std::string("kind=\"") + request_kind_names[k] + "\"");
+	}
+	metric_header(out, "cjmcu_connections", "gauge", "Open client connections.");
+	metric_value(out, "cjmcu_connections", "", (double)connections);
+}
+
+// Accepts all pending connections. A connection to the metrics socket gets the metrics as
+// response right away and is closed when they are sent.
+void accept_clients(int epfd, int sock, struct server_state *state,
+		    std::unordered_map<int, struct client_connection> *connections, bool metrics) {
+	struct epoll_event ev;
+	int client_sock;
+
+	while ((client_sock = accept4(sock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		struct client_connection &conn = (*connections)[client_sock];
+		conn.request_len = 0;
+		conn.response.clear();
+		conn.response_sent = 0;
+		conn.wait_writable = false;
+		conn.subscribed = false;
+		conn.queue.clear();
+		conn.queued_responses = 0;
+		conn.framed = false;
+		conn.in.clear();
+		conn.pending_kinds.clear();
+		ev.events = EPOLLIN;
+		if (metrics) {
+			std::string text;
+			write_metrics(state, connections->size() - 1, text);
+			conn.response.assign(text.begin(), text.end());
+			conn.wait_writable = true;
+			ev.events = EPOLLOUT;
+		}
+		ev.data.fd = client_sock;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, client_sock, &ev) < 0) {
+			syslog(LOG_ERR, "epoll_ctl() failed: %s", strerror(errno));
+			connections->erase(client_sock);
+			close(client_sock);
+		}
+	}
+	if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+		syslog(LOG_ERR, "accept() failed: %s", strerror(errno));
+	}
+}
+
+static int trace_signal_fd = -1;		// trace_fd of the running server
+static volatile sig_atomic_t trace_toggled = 0;
+static volatile sig_atomic_t trace_dump_requested = 0;
+
+// SIGUSR1 switches the tracer on or off, SIGUSR2 requests a dump; both are logged (and the
+// dump is written) by the client handling.
+static void trace_signal(int sig) {
+	int saved_errno = errno;
+
+	if (sig == SIGUSR1) {
+		Tracer::enable(!Tracer::enabled());
+		trace_toggled = 1;
+	} else {
+		trace_dump_requested = 1;
+	}
+	eventfd_write(trace_signal_fd, 1);
+	errno = saved_errno;
+}
+
+void handle_trace_signal(struct server_state *state) {
+	eventfd_t count;
+	long n;
+
+	eventfd_read(state->trace_fd, &count);
+	if (trace_toggled) {
+		trace_toggled = 0;
+		syslog(LOG_INFO, "tracing %s", Tracer::enabled() ? "enabled" : "disabled");
+	}
+	if (trace_dump_requested) {
+		trace_dump_requested = 0;
+		n = Tracer::dump(TRACE_FILE);
+		if (n < 0) {
+			syslog(LOG_ERR, "unable to write %s: %s", TRACE_FILE, strerror(errno));
+		} else {
+			syslog(LOG_INFO, "%ld trace span(s) written to %s", n, TRACE_FILE);
+		}
+	}
+}
+
+// Pushes the new snapshots of the boards to their subscribers.
+void push_snapshot(int epfd, struct server_state *state, std::unordered_map<int, struct client_connection> *connections) {
+	struct response_from_server values;
+	eventfd_t count;
+	uint64_t seq, version;
+
+	eventfd_read(state->publish_fd, &count);
+	for (auto board : state->boards) {
+		{
+			std::lock_guard<std::mutex> guard(state->lock);
+			values = board->snapshot;
+			seq = board->snapshot_seq;
+			version = board->snapshot_version;
+		}
+		if (version == board->pushed_version) {
+			continue;
+		}
+		board->pushed_version = version;
+		for (auto conn = connections->begin(); conn != connections->end();) {
+			if (conn->second.subscribed && (conn->second.push_board == board) &&
+			    (push_to_subscriber(epfd, conn->first, state, &conn->second, &values, seq) != CONNECTION_PENDING)) {
+				close(conn->first);
+				conn = connections->erase(conn);
+			} else {
+				++conn;
+			}
+		}
+	}
+}
+
+// Serves the clients from the published snapshot until CMD_EXIT (returns 0) or an error of
+// epoll (returns -1). Every connection is handled without blocking, a slow client only delays
+// itself.
+int serve_clients(int sock, int metrics_sock, struct server_state *state) {
+	struct epoll_event ev, events[MAX_EPOLL_EVENTS];
+	std::unordered_map<int, struct client_connection> connections;
+	int epfd, n, i, ret = -1;
+	bool running = true;
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0) {
+		syslog(LOG_ERR, "epoll_create1() failed: %s", strerror(errno));
+		return -1;
+	}
+	ev.events = EPOLLIN;
+	ev.data.fd = sock;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, sock, &ev);
+	ev.events = EPOLLIN;
+	ev.data.fd = metrics_sock;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, metrics_sock, &ev);
+	ev.events = EPOLLIN;
+	ev.data.fd = state->publish_fd;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, state->publish_fd, &ev);
+	ev.events = EPOLLIN;
+	ev.data.fd = state->trace_fd;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, state->trace_fd, &ev);
+
+	while (running) {
+		n = epoll_wait(epfd, events, MAX_EPOLL_EVENTS, -1);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			syslog(LOG_ERR, "epoll_wait failed: %s", strerror(errno));
+			break;
+		}
+		for (i = 0; (i < n) && running; i++) {
+			int fd = events[i].data.fd;
+			if (fd == sock) {
+				accept_clients(epfd, sock, state, &connections, false);
+			} else if (fd == metrics_sock) {
+				accept_clients(epfd, metrics_sock, state, &connections, true);
+			} else if (fd == state->publish_fd) {
+				push_snapshot(epfd, state, &connections);
+			} else if (fd == state->trace_fd) {
+				handle_trace_signal(state);
+			} else {
+				auto conn = connections.find(fd);
+				if (conn == connections.end()) {
+					continue;
+				}
+				int rc = serve_connection(epfd, fd, state, &conn->second);
+				if (rc == CONNECTION_PENDING) {
+					continue;
+				}
+				if (rc == CONNECTION_EXIT) {
+					running = false;
+					ret = 0;
+				}
+				close(fd);	// also removes it from the epoll set
+				connections.erase(conn);
+			}
+		}
+	}
+
+	for (auto &conn : connections) {
+		close(conn.first);
+	}
+	close(epfd);
+	return ret;
+}
+
+bool is_simulated_bus(const std::string &device) {
+	return device.compare(0, strlen(I2C_DEVICE_SIMULATED), I2C_DEVICE_SIMULATED) == 0;
+}
+
+// Reads the boards of the daemon from the configuration file (in the foreground, errors are
+// printed to stderr). Lines: <name> <device> [<ccs811> <hdc1080> <bmp280> [<data ready>]], the
+// addresses default to 0x5a 0x40 0x76; empty lines and lines starting with '#' are ignored.
+int read_board_config(const char *file) {
+	char line[256], name[64], device[128], ready[64];
+	int ccs811_addr, hdc1080_addr, bmp280_addr, n;
+	unsigned gpio_line;
+	unsigned line_no = 0;
+	FILE *fp;
+
+	fp = fopen(file, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "unable to open %s: %s\n", file, strerror(errno));
+		return -1;
+	}
+	board_configs.clear();
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		line_no++;
+		ccs811_addr = 0x5a;
+		hdc1080_addr = 0x40;
+		bmp280_addr = 0x76;
+		ready[0] = '\0';
+		n = sscanf(line, "%63s %127s %i %i %i %63s", name, device, &ccs811_addr, &hdc1080_addr, &bmp280_addr, ready);
+		if ((n <= 0) || (name[0] == '#')) {
+			continue;
+		}
+		if ((n == 6) && (strcmp(ready, "sim") == 0) && !is_simulated_bus(device)) {
+			fprintf(stderr, "%s:%u: data ready \"sim\" is only available on a simulated bus\n", file, line_no);
+			fclose(fp);
 			return -1;
 		}
-		p->temp_HDC = new value_check<double>(10.0, 600);
-		if (!p->temp_HDC) {
-			delete p->humidity;
+		if ((n == 6) && (strcmp(ready, "sim") != 0) && ((strchr(ready, ':') == NULL) ||
+		    (sscanf(strchr(ready, ':'), ":%u", &gpio_line) != 1))) {
+			fprintf(stderr, "%s:%u: data ready must be <gpiochip>:<line> or sim\n", file, line_no);
+			fclose(fp);
 			return -1;
 		}
-		p->temp_BMP = new value_check<double>(10.0, 600);
-		if (!p->temp_BMP) {
-			delete p->humidity;
-			delete p->temp_HDC;
+		if (((n != 2) && (n != 5) && (n != 6)) || (ccs811_addr < 0x03) || (ccs811_addr > 0x77) || (hdc1080_addr < 0x03) ||
+		    (hdc1080_addr > 0x77) || (bmp280_addr < 0x03) || (bmp280_addr > 0x77)) {
+			fprintf(stderr, "%s:%u: expected <name> <device> [<ccs811> <hdc1080> <bmp280> [<data ready>]]\n", file,
+				line_no);
+			fclose(fp);
 			return -1;
 		}
-		p->pressure = new value_check<double>(80.0, 600);
-		if (!p->pressure) {
-			delete p->humidity;
-			delete p->temp_HDC;
-			delete p->temp_BMP;
+
+		struct board_config config;
+		config.name = name;
+		config.device = device;
+		config.ccs811_addr = (uint8_t)ccs811_addr;
+		config.hdc1080_addr = (uint8_t)hdc1080_addr;
+		config.bmp280_addr = (uint8_t)bmp280_addr;
+		config.ready = ready;
+
+		unsigned on_bus = 1;
+		for (auto &other : board_configs) {
+			if (other.name == config.name) {
+				fprintf(stderr, "%s:%u: board %s already defined\n", file, line_no, name);
+				fclose(fp);
+				return -1;
+			}
+			if (other.device != config.device) {
+				continue;
+			}
+			on_bus++;
+			uint8_t a[3] = {other.ccs811_addr, other.hdc1080_addr, other.bmp280_addr};
+			for (int i = 0; i < 3; i++) {
+				if ((a[i] == config.ccs811_addr) || (a[i] == config.hdc1080_addr) || (a[i] == config.bmp280_addr)) {
+					fprintf(stderr, "%s:%u: address 0x%02x is already used on %s by board %s\n", file,
+						line_no, a[i], device, other.name.c_str());
+					fclose(fp);
+					return -1;
+				}
+			}
+		}
+		if ((on_bus * 3 > MeasurementCycle::MAX_SENSORS) || (board_configs.size() == BOARD_MAX)) {
+			fprintf(stderr, "%s:%u: too many boards\n", file, line_no);
+			fclose(fp);
 			return -1;
 		}
-		p->time = p->server_start = time(NULL);
-		
-		// p->pressure->enable_debug();
-	} else {
+		board_configs.push_back(config);
+	}
+	fclose(fp);
+	if (board_configs.empty()) {
+		fprintf(stderr, "%s: no boards defined\n", file);
 		return -1;
 	}
 	return 0;
 }
 
-void exit_response(struct response_from_server_obj *p) {
+// Opens the bus; a simulated bus gets the boards configured on it.
+std::unique_ptr<I2CTransport> open_bus(const std::string &device) {
+	if (is_simulated_bus(device)) {
+		auto sim = new SimulatedI2C();
+		for (auto &config : board_configs) {
+			if (config.device == device) {
+				sim->attach_cjmcu8128(config.ccs811_addr, config.hdc1080_addr, config.bmp280_addr);
+			}
+		}
+		syslog(LOG_INFO, "using simulated sensor board(s) on %s", device.c_str());
+		return std::unique_ptr<I2CTransport>(sim);
+	}
+	try {
+		return std::unique_ptr<I2CTransport>(new LinuxI2C(device.c_str()));
+	} catch (int) {
+		syslog(LOG_ERR, "unable to open %s: %s", device.c_str(), strerror(errno));
+		return std::unique_ptr<I2CTransport>();
+	}
+}
 
-	if (p) {
-		delete p->humidity;
-		delete p->temp_HDC;
-		delete p->temp_BMP;
-		delete p->pressure;
+// Checkpoint of the CCS811 baseline without option -k: in BASELINE_DIR, which survives a
+// reboot, or in /tmp if that directory cannot be created or written.
+const char *default_baseline_file(void) {
+	if (((mkdir(BASELINE_DIR, 0755) < 0) && (errno != EEXIST)) || (access(BASELINE_DIR "/.", W_OK) < 0)) {
+		syslog(LOG_WARNING, "unable to write to %s (%s), the CCS811 baseline is saved to %s", BASELINE_DIR,
+		       strerror(errno), BASELINE_FALLBACK_FILE);
+		return BASELINE_FALLBACK_FILE;
 	}
+	return BASELINE_FILE;
 }
 
-void copy_response(struct response_from_server_obj *s, struct response_from_server *d) {
+// Creates the history, sample log and shared memory of the board on the bus of the worker; the
+// sensors are brought up by the worker (bring_up_sensors()). Board 0 uses the names of a
+// single-board daemon, the others append "-<name>".
+struct board *open_board(uint8_t id, struct bus_worker *worker) {
+	struct board *board = new struct board;
+	std::string suffix;
+
+	board->id = id;
+	board->config = board_configs[id];
+	board->time = board->server_start = time(NULL);
+	board->bmp280_status = 0;
+	board->cycle_time = 0;
+	memset(board->rejected, 0, sizeof(board->rejected));
+	memset(board->channel_flags, 0, sizeof(board->channel_flags));
+	if (id > 0) {
+		suffix = "-" + board->config.name;
+	}
 
-	if ((s) && (d)) {
-		d->server_start = s->server_start;
-		d->time = s->time;
-		d->co2 = s->co2;
-		d->tvoc = s->tvoc;
-		d->bmp280_status = s->bmp280_status;
-		d->humidity = s->humidity->get();
-		d->temp_HDC = s->temp_HDC->get();
-		d->temp_BMP = s->temp_BMP->get();
-		d->pressure = s->pressure->get();
+	board->device.name = board->config.name.c_str();
+	board->device.ccs811 = NULL;
+	board->device.hdc1080 = NULL;
+	board->device.bmp280 = NULL;
+	board->device.cycle = &worker->cycle;
+	board->ready = NULL;
+	board->sim_ccs811 = NULL;
+	board->ready_seen = false;
+	board->baseline = new BaselineStore(baseline_file + suffix);
+	board->baseline_saved = board->server_start;
+	board->baseline_restored = false;
+	board->drive_mode = board->requested_mode = 0;
+	board->raw = new RawDataBuffer(RAW_HISTORY_DEPTH);
+	board->worker = worker;
+	board->channel_base = worker->channels.size();
+	for (size_t i = 0; i < BOARD_CHANNEL_COUNT; i++) {
+		worker->channels.add(board_channels[i].spec);
 	}
-}
 
-int server_loop() {
-    	int ret, sock;
-    	struct pollfd fd;
-	struct response_from_server current_values;
-	struct response_from_server_obj current_values_obj;
-	struct command_to_server cmd;
-	struct cjmcu device;
-	int timeout = MEASURE_LOOP_INTERVAL * 1000;
+	board->history = new SampleHistory(history_depth);
+	board->log = new SampleLog(sample_log_file + suffix);
+	open_sample_log(board->log, board->history);
+
+	board->shm_name = SNAPSHOT_SEGMENT + suffix;
+	board->shm = new SeqlockSnapshot<struct response_from_server>();
+	if (board->shm->create(board->shm_name.c_str(), SNAPSHOT_VERSION) < 0) {
+		syslog(LOG_WARNING, "unable to create shared memory %s: %s", board->shm_name.c_str(), strerror(errno));
+		delete board->shm;
+		board->shm = NULL;
+	}
+	init_response_data(&board->snapshot);
+	board->snapshot.time = 0;	// warming up: no values yet
+	board->snapshot_seq = 0;
+	board->pushed_version = 0;
+	board->failed = false;
+	board->failed_cycles = 0;
+	board->snapshot_version = 0;
+	return board;
+}
 
-	if (init_response(&current_values_obj)) {
-		syslog(LOG_ERR, "unable to initialize data structure...");
-		return -1;	
+void close_board(struct board *board) {
+	if (board->shm) {
+		SeqlockSnapshot<struct response_from_server>::remove(board->shm_name.c_str());
+		delete board->shm;
 	}
+	if (board->sim_ccs811) {
+		board->sim_ccs811->set_interrupt(std::function<void()>());
+	}
+	delete board->ready;
+	delete board->raw;
+	delete board->baseline;
+	delete board->log;
+	delete board->history;
+	delete board->device.ccs811;
+	delete board->device.hdc1080;
+	delete board->device.bmp280;
+	delete board;
+}
+
+int server_loop() {
+	std::vector<struct bus_worker *> workers;
+	struct server_state state;
+	struct sigaction sa;
+	int ret, sock, metrics_sock;
+	size_t i;
 
-	sock = create_server_socket();
+	sock = create_server_socket(SOCKET_FILE);
 	if (sock < 0) {		
         	return -1;
 	}
+	metrics_sock = create_server_socket(METRICS_SOCKET_FILE);
+	if (metrics_sock < 0) {
+		close(sock);
+		return -1;
+	}
+	if (baseline_file == NULL) {
+		baseline_file = default_baseline_file();
+	}
+	state.stop = false;
+	memset(state.requests, 0, sizeof(state.requests));
+	for (i = 0; i < REQUEST_KIND_COUNT; i++) {
+		state.request_latency_us.push_back(Histogram(std::vector<double>(REQUEST_LATENCY_BUCKETS)));
+	}
+	state.publish_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	state.trace_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if ((state.publish_fd < 0) || (state.trace_fd < 0)) {
+		syslog(LOG_ERR, "eventfd() failed: %s", strerror(errno));
+		close(sock);
+		close(metrics_sock);
+		return -1;
+	}
+	Tracer::set_thread_name("server");
+	trace_signal_fd = state.trace_fd;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = trace_signal;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGUSR1, &sa, NULL);
+	sigaction(SIGUSR2, &sa, NULL);
+
+	// create the boards, one worker per bus:
+	for (i = 0; i < board_configs.size(); i++) {
+		struct bus_worker *worker = NULL;
+		for (auto w : workers) {
+			if (w->device == board_configs[i].device) {
+				worker = w;
+			}
+		}
+		if (worker == NULL) {
+			worker = new struct bus_worker;
+			worker->device = board_configs[i].device;
+			std::unique_ptr<I2CTransport> bus = open_bus(worker->device);
+			worker->counters = bus ? new CountingI2C(std::move(bus)) : NULL;
+			worker->bus = std::unique_ptr<I2CTransport>(worker->counters);
+			worker->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if (worker->wake_fd < 0) {
+				syslog(LOG_WARNING, "eventfd() failed: %s, stopping may take up to %i s", strerror(errno),
+				       MEASURE_LOOP_INTERVAL);
+			}
+			workers.push_back(worker);
+		}
+		struct board *board = open_board((uint8_t)i, worker);
+		worker->boards.push_back(board);
+		state.boards.push_back(board);
+	}
+	syslog(LOG_INFO, "initialize sensors of %zu board(s) on %zu bus(es)...", state.boards.size(), workers.size());
 
-	// initialize the sensors:	
-	syslog(LOG_INFO, "initialize sensors...");
-	CCS811 ccs811(I2C_DEVICE, 0x5a);
-	HDC1080 hdc1080(I2C_DEVICE, 0x40);
-	BMP280 bmp280(I2C_DEVICE, 0x76);
-	syslog(LOG_INFO, "sensors initialized...");
-
-	device.ccs811 = &ccs811;
-	device.hdc1080 = &hdc1080;
-	device.bmp280 = &bmp280;
-
-	init_response_data(&current_values);
-	measure(&device, &current_values_obj); // initial measurement
-
-    fd.fd = sock; 
-    fd.events = POLLIN;
-    while (1) {
-		int client_sock;
-        ret = poll(&fd, 1, timeout);
-        switch (ret) {
-            case -1:	// error
-				syslog(LOG_ERR, "poll failed: %s", strerror(errno));
-				close(sock);
-				return -1;
-				break;
+	// every bus is brought up and measured on its own thread, clients are served from the
+	// published values right away (warming up until the first values of a board):
+	for (auto worker : workers) {
+		worker->thread = std::thread(measurement_thread, &state, worker);
+	}
+	state.workers = workers;
+	ret = serve_clients(sock, metrics_sock, &state);
+	{
+		std::lock_guard<std::mutex> guard(state.lock);
+		state.stop = true;
+	}
+	for (auto worker : workers) {
+		eventfd_write(worker->wake_fd, 1);
+		worker->thread.join();
+	}
 
-            case 0:		// timeout
-                		ret = measure(&device, &current_values_obj);
-				if (ret < 0) {
-				    close(sock);
-				    syslog(LOG_ERR, "measure() failed: %i", ret); 
-				    return -1;
-				}
-				timeout = MEASURE_LOOP_INTERVAL * 1000;
-				break;
+	for (auto board : state.boards) {
+		close_board(board);
+	}
+	for (auto worker : workers) {
+		if (worker->wake_fd >= 0) {
+			close(worker->wake_fd);
+		}
+		delete worker;
+	}
+	signal(SIGUSR1, SIG_IGN);
+	signal(SIGUSR2, SIG_IGN);
+	close(state.trace_fd);
+	close(state.publish_fd);
+	close(sock);
+	close(metrics_sock);
+	syslog(LOG_INFO, "end server loop");
 
-            default:	// data received from socket
-				client_sock = accept(sock, NULL, NULL);
-				ret = recv(client_sock , &cmd, sizeof(cmd), 0); // receive data from client
-				if (ret < 0) {
-					syslog(LOG_ERR, "recv() failed: %s", strerror(errno));
-					close(client_sock);
-					break;
-				}
-				if (ret != sizeof(cmd)) {
-					syslog(LOG_ERR, "received invalid data size (%i/%u)", ret, sizeof(cmd));
-				} else {
-					time_t difference;
-					switch (cmd.command) {
-						case CMD_EXIT:
-							syslog(LOG_INFO, "received EXIT command");
-							close(client_sock);
-							close(sock);
-							exit_response(&current_values_obj);
-							return 0;
-							break;
-						case CMD_GET_VALUES:
-							//syslog(LOG_INFO, "received GET_VALUES command");
-							copy_response(&current_values_obj, &current_values);
-							ret = send(client_sock, &current_values, sizeof(current_values), 0);
-							if (ret < 0) {
-								syslog(LOG_ERR, "send() failed: %s", strerror(errno));
-							}		
-							close(client_sock);	// support only one command in a connection!
-							break;
-						default:
-							syslog(LOG_ERR, "received invalid command (%i)", cmd.command);
-							close(client_sock);
-							break;
-					}
-					difference = time(NULL) - current_values_obj.time;
-					if (difference >= MEASURE_LOOP_INTERVAL) {
-						ret = measure(&device, &current_values_obj);
-						if (ret < 0) {
-							syslog(LOG_INFO, "measure() failed %i", ret);
-							close(sock);
-							return -1;
-						}
-						timeout = MEASURE_LOOP_INTERVAL * 1000;
-					} else {
-						timeout = (MEASURE_LOOP_INTERVAL - difference) * 1000;
-					}
-				}
-                break;
-        }
-    }
-    close(sock);
-    exit_response(&current_values_obj);
-    syslog(LOG_INFO, "end server loop");
-    
-    return 0;
+	return ret;
 }
 
 static void start_server()
@@ -384,6 +2333,7 @@ static void start_server()
 
 	/* server loop has terminated... */
 	unlink(SOCKET_FILE);
+	unlink(METRICS_SOCKET_FILE);
 	syslog(LOG_INFO, "Stopped %s", app_name);
 	closelog();
 
@@ -398,7 +2348,7 @@ static void start_server()
 /*  client functions...                                                    */
 /***************************************************************************/
 
-int create_client_socket() {
+int create_client_socket(const char *path) {
     int sock;
     struct sockaddr_un server;
 
@@ -409,7 +2359,7 @@ int create_client_socket() {
     }
     memset(&server, 0, sizeof(server));
     server.sun_family = AF_UNIX;
-    strncpy(server.sun_path, SOCKET_FILE, sizeof(server.sun_path)-1);
+    strncpy(server.sun_path, path, sizeof(server.sun_path)-1);
 
    if (connect(sock, (struct sockaddr *) &server, sizeof(struct sockaddr_un)) < 0) {
     	if ((errno != 2) && (errno != 111)) {
@@ -436,41 +2386,407 @@ void print_help(void)
 	printf("   -o			Output TVOC value in ppb (taken from CC811)\n");
 	printf("   -a			Output mean of temperature from BMP200 and HDC1080\n");
 	printf("   -v			Output Summary of all available values\n");
-	printf("   -l			Output Summary of all available values in a loop\n");
+	printf("   -l			Output Summary of all available values of every new measurement\n");
+	printf("   -L <sec>		Output Summary of all available values in a loop with the given interval\n");
+	printf("   -g <seq>		Output all stored samples after the given sequence number (0: all)\n");
+	printf("   -G <from>,<to>	Output all stored samples in the given time range (seconds since the epoch)\n");
+	printf("   -R <from>,<to>	Output all samples of the given time range read from the sample log files\n");
+	printf("   -m <mode>		Set the drive mode of the CCS811 (0: idle, 1: 1 s, 2: 10 s, 3: 60 s, 4: raw data every 250 ms)\n");
+	printf("   -w <seq>		Output the raw data samples (drive mode 4) after the given sequence number (0: all)\n");
+	printf("   -f <file>		Sample log file (default: %s)\n", SAMPLE_LOG_FILE);
+	printf("   -k <file>		CCS811 baseline checkpoint of a newly started daemon (default: %s, else %s)\n",
+	       BASELINE_FILE, BASELINE_FALLBACK_FILE);
+	printf("   -n <samples>		Number of samples stored by a newly started daemon (default: %u)\n", HISTORY_DEPTH);
+	printf("   -d <device>		I2C device used by a newly started daemon (default: %s, \"%s\": simulated board)\n",
+		I2C_DEVICE, I2C_DEVICE_SIMULATED);
+	printf("   -C <file>		Boards of a newly started daemon, one per line: <name> <device> [<ccs811> <hdc1080> <bmp280> [<data ready>]]\n");
+	printf("			  data ready: <gpiochip>:<line> of the nINT of the CCS811, or \"sim\" on a simulated bus\n");
+	printf("   -b <board>		Board of the value and history queries (default: 0, the first one)\n");
+	printf("   -B			Output the latest values of all boards\n");
+	printf("   -M			Output the metrics of the running daemon\n");
+}
+int recv_all(int sock, void *buffer, size_t len) {
+	uint8_t *p = (uint8_t *)buffer;
+	while (len > 0) {
+		ssize_t ret = recv(sock, p, len, 0);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			fprintf(stderr, "recv failed with code %i (%s)\n", errno, strerror(errno));
+			return -1;
+		}
+		if (ret == 0) {
+			fprintf(stderr, "connection closed by server\n");
+			return -1;
+		}
+		p += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+// Receives the next response frame to the last request and its payload. Returns the response
+// type, -1 on error or CLIENT_WARMING_UP (not printed).
+int client_response(int sock, std::vector<uint8_t> *response) {
+	uint8_t header[FRAME_HEADER_SIZE];
+	FrameHeader hdr;
+
+	if (recv_all(sock, header, sizeof(header)) < 0) {
+		return -1;
+	}
+	if ((frame_parse_header(header, sizeof(header), hdr) != 1) || (hdr.request_id != client_request_id)) {
+		fprintf(stderr, "invalid response from server\n");
+		return -1;
+	}
+	response->resize(hdr.length);
+	if (recv_all(sock, response->data(), hdr.length) < 0) {
+		return -1;
+	}
+	if (hdr.type == FRAME_ERROR) {
+		WireReader r(response->data(), response->size());
+		uint16_t code = r.u16();
+		if (code == FRAME_ERROR_WARMING_UP) {
+			return CLIENT_WARMING_UP;
+		}
+		if (code == FRAME_ERROR_BOARD_FAILED) {
+			fprintf(stderr, "the sensors of the board failed, see the system log of the daemon\n");
+			return -1;
+		}
+		fprintf(stderr, "request rejected by server (error %u)\n", code);
+		return -1;
+	}
+	return hdr.type;
+}
+
+// Sends one framed request (type and payload) and, unless it is FRAME_EXIT, receives the
+// response payload. Returns the response type, -1 on error or CLIENT_WARMING_UP (not printed).
+int client_request(int sock, uint8_t type, const std::vector<uint8_t> &payload, std::vector<uint8_t> *response) {
+	std::vector<uint8_t> request;
+	WireWriter w(request);
+	size_t frame;
+
+	frame = w.begin_frame(type, ++client_request_id);
+	request.insert(request.end(), payload.begin(), payload.end());
+	w.end_frame(frame);
+	if (send(sock, request.data(), request.size(), MSG_NOSIGNAL) < 0) {
+		fprintf(stderr, "send failed with code %i (%s)\n", errno, strerror(errno));
+		return -1;
+	}
+	if (type == FRAME_EXIT) {
+		return type;
+	}
+	return client_response(sock, response);
 }
+
+// Subscribes to the samples and prints every pushed sample; with loop_time > 0 at most one
+// line per loop_time seconds.
 int client_loop(int sock, unsigned int loop_time) {
-	struct command_to_server cmd;
 	struct response_from_server rsp;
+	std::vector<uint8_t> response;
+	time_t last_output = 0;
+	uint64_t seq;
+	uint16_t flags;
+	int ret;
+
+	memset(&rsp, 0, sizeof(rsp));
+	ret = client_request(sock, FRAME_SUBSCRIBE, std::vector<uint8_t>(1, (uint8_t)board_arg), &response);
+
+	while (ret == FRAME_PUSH) {
+		if (push_apply_frame(response, &seq, &flags, &rsp) < 0) {
+			break;
+		}
+		if (flags & PUSH_COALESCED) {
+			fprintf(stderr, "too slow, samples before %llu skipped\n", (unsigned long long)seq);
+		}
+		if ((loop_time == 0) || (time(NULL) - last_output >= (time_t)loop_time)) {
+			last_output = time(NULL);
+			printf("T(HDC1080): %.2lf°C\tT(BMP280): %.2lf°C\tRH: %.2lf%%\tCO2: %uppm\tTVOC: %uppb\tPres: %.2lfhPa\n",
+			rsp.temp_HDC, rsp.temp_BMP, rsp.humidity, rsp.co2, rsp.tvoc, rsp.pressure);
+			fflush(stdout);
+		}
+		ret = client_response(sock, &response);
+	}
+	if (ret >= 0) {
+		fprintf(stderr, "invalid message from server\n");
+	}
+	return EXIT_FAILURE;
+}
 
-	cmd.command = CMD_GET_VALUES;
+// One line per sample: sequence number, time stamp, T(HDC1080), T(BMP280), RH, CO2, TVOC, pressure
+// and the mask of the channels (see HistorySample) without a valid reading of the cycle
+void print_sample(const HistorySample *sample) {
+	printf("%llu\t%lld\t%.2lf\t%.2lf\t%.2lf\t%u\t%u\t%.2lf\t0x%02x\n", (unsigned long long)sample->seq,
+		(long long)sample->time, sample->temp_HDC, sample->temp_BMP, sample->humidity, sample->co2, sample->tvoc,
+		sample->pressure, sample->channels_failed | sample->channels_rejected | sample->channels_invalid);
+}
 
-	while (1) {
-		if (send(sock, &cmd, sizeof(cmd), 0) < 0) {
-			fprintf(stderr, "send failed with code %i (%s)\n", errno, strerror(errno));
+// Requests the history and prints it
+int client_history(int sock, int cmd_option) {
+	struct history_request req;
+	std::vector<uint8_t> payload, response;
+	WireWriter w(payload);
+	HistorySample sample;
+	uint64_t oldest_seq;
+	uint32_t count;
+
+	memset(&req, 0, sizeof(req));
+	if (cmd_option == 'G') {
+		long long from, to;
+		if (sscanf(history_arg, "%lld,%lld", &from, &to) != 2) {
+			fprintf(stderr, "invalid time range: %s (expected <from>,<to>)\n", history_arg);
 			return EXIT_FAILURE;
 		}
-		if (recv(sock, &rsp, sizeof(rsp), 0) < 0) {
-			fprintf(stderr, "recv failed with code %i (%s)\n", errno, strerror(errno));
+		req.mode = HISTORY_TIME_RANGE;
+		req.from = (time_t)from;
+		req.to = (time_t)to;
+	} else {
+		req.mode = HISTORY_AFTER_SEQ;
+		req.after_seq = strtoull(history_arg, NULL, 0);
+	}
+	w.u8(req.mode);
+	w.u32(req.max_samples);
+	w.u64(req.after_seq);
+	w.i64(req.from);
+	w.i64(req.to);
+	w.u8((uint8_t)board_arg);
+	if (client_request(sock, FRAME_GET_HISTORY, payload, &response) != FRAME_HISTORY) {
+		return EXIT_FAILURE;
+	}
+
+	WireReader r(response.data(), response.size());
+	oldest_seq = r.u64();
+	r.u64();	// latest_seq
+	count = r.u32();
+	if ((req.mode == HISTORY_AFTER_SEQ) && (oldest_seq > req.after_seq + 1)) {
+		fprintf(stderr, "samples %llu..%llu are no longer available\n",
+			(unsigned long long)req.after_seq + 1, (unsigned long long)oldest_seq - 1);
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		if (wire_get_sample(&r, &sample) < 0) {
+			fprintf(stderr, "invalid response from server\n");
 			return EXIT_FAILURE;
 		}
+		print_sample(&sample);
+	}
+	return EXIT_SUCCESS;
+}
 
-		printf("T(HDC1080): %.2lf°C\tT(BMP280): %.2lf°C\tRH: %.2lf%%\tCO2: %uppm\tTVOC: %uppb\tPres: %.2lfhPa\n",
-		rsp.temp_HDC, rsp.temp_BMP, rsp.humidity, rsp.co2, rsp.tvoc, rsp.pressure);
+// Sets the drive mode of the CCS811 of the board
+int client_drive_mode(int sock) {
+	std::vector<uint8_t> payload, response;
+	WireWriter w(payload);
+	char *end;
+	unsigned long mode = strtoul(drive_mode_arg, &end, 0);
+	int ret, waited;
 
-		close(sock);
-		sleep(loop_time);
-		if ((sock = create_client_socket()) < 0) {
+	if ((*end != '\0') || (mode > 4)) {
+		fprintf(stderr, "invalid drive mode: %s (expected 0..4)\n", drive_mode_arg);
+		return EXIT_FAILURE;
+	}
+	w.u8((uint8_t)mode);
+	w.u8((uint8_t)board_arg);
+	ret = client_request(sock, FRAME_SET_DRIVE_MODE, payload, &response);
+	for (waited = 0; (ret == CLIENT_WARMING_UP) && (waited < WARM_UP_TIMEOUT_MS); waited += CLIENT_POLL_INTERVAL_MS) {
+		usleep(CLIENT_POLL_INTERVAL_MS * 1000);
+		ret = client_request(sock, FRAME_SET_DRIVE_MODE, payload, &response);
+	}
+	if (ret == CLIENT_WARMING_UP) {
+		fprintf(stderr, "the server is warming up, try again later\n");
+	}
+	if (ret != FRAME_DRIVE_MODE) {
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+// Requests the RAW_DATA samples and prints them, one line per sample: sequence number, time
+// stamp in ms, current in uA, voltage (ADC value and V)
+int client_raw(int sock) {
+	std::vector<uint8_t> payload, response;
+	WireWriter w(payload);
+	uint64_t after_seq = strtoull(history_arg, NULL, 0), oldest_seq;
+	uint32_t count;
+
+	w.u32(0);	// as many as the server sends
+	w.u64(after_seq);
+	w.u8((uint8_t)board_arg);
+	if (client_request(sock, FRAME_GET_RAW, payload, &response) != FRAME_RAW) {
+		return EXIT_FAILURE;
+	}
+
+	WireReader r(response.data(), response.size());
+	oldest_seq = r.u64();
+	r.u64();	// latest_seq
+	count = r.u32();
+	if (oldest_seq > after_seq + 1) {
+		fprintf(stderr, "samples %llu..%llu are no longer available\n", (unsigned long long)after_seq + 1,
+			(unsigned long long)oldest_seq - 1);
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		unsigned long long seq = r.u64();
+		long long time_ms = r.i64();
+		unsigned current = r.u8();
+		unsigned adc = r.u16();
+		if (!r.ok()) {
+			fprintf(stderr, "invalid response from server\n");
+			return EXIT_FAILURE;
+		}
+		printf("%llu\t%lld\t%u\t%u\t%.3lf\n", seq, time_ms, current, adc, adc * 1.65 / 1023);
+	}
+	return EXIT_SUCCESS;
+}
+
+// Prints the samples of the given time range directly from the sample log files (mapped
+// read-only, no server needed), oldest file first.
+int client_log(void) {
+	long long from, to;
+	unsigned n;
+
+	if (sscanf(history_arg, "%lld,%lld", &from, &to) != 2) {
+		fprintf(stderr, "invalid time range: %s (expected <from>,<to>)\n", history_arg);
+		return EXIT_FAILURE;
+	}
+	for (n = SampleLog::DEFAULT_KEEP + 1; n-- > 0;) {
+		SampleLogReader reader;
+		size_t i;
+		if (reader.open(SampleLog::rotated_path(sample_log_file, n)) < 0) {
+			continue;
+		}
+		for (i = reader.lower_bound((time_t)from); i < reader.size(); i++) {
+			HistorySample sample = reader.at(i);
+			if (sample.time > (time_t)to) {
+				break;
+			}
+			print_sample(&sample);
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+// Reads the values published by the server in shared memory, without a connection to the
+// server. Returns -1 if no (running) server has published values.
+int read_snapshot(struct response_from_server *rsp) {
+	SeqlockSnapshot<struct response_from_server> shm;
+
+	if (shm.open(SNAPSHOT_SEGMENT, SNAPSHOT_VERSION) < 0) {
+		return -1;
+	}
+	return shm.read(*rsp) ? 0 : -1;
+}
+
+// Prints the value(s) selected by the command line option.
+int print_values(int cmd_option, const struct response_from_server *rsp) {
+	switch (cmd_option) {
+		case 'p':
+			printf("%.2lf\n", rsp->pressure);
+			return EXIT_SUCCESS;
+			break;
+		case 't':
+			printf("%.2lf\n", rsp->temp_BMP);
+			return EXIT_SUCCESS;
+			break;
+		case 'T':
+			printf("%.2lf\n", rsp->temp_HDC);
+			return EXIT_SUCCESS;
+			break;
+		case 'h':
+			printf("%.2lf\n", rsp->humidity);
+			return EXIT_SUCCESS;
+			break;
+		case 'c':
+			printf("%u\n", rsp->co2);
+			return EXIT_SUCCESS;
+			break;
+		case 'o':
+			printf("%u\n", rsp->tvoc);
+			return EXIT_SUCCESS;
+			break;
+		case 'a':
+			printf("%.2lf\n", (rsp->temp_BMP + rsp->temp_HDC) / 2.0);
+			return EXIT_SUCCESS;
+			break;
+		case 'v':
+		    printf("Air Pressure:           %.2lf hPa\n",rsp->pressure);
+		    printf("Temperature (BMP200):   %.2lf °C\n", rsp->temp_BMP);
+		    printf("Temperature (HDC1080):  %.2lf °C\n", rsp->temp_HDC);
+		    printf("Air Humidity:           %.2lf %%\n", rsp->humidity);
+		    printf("CO2:                    %u ppm\n", rsp->co2);
+		    printf("TVOC:                   %u ppb\n", rsp->tvoc);
+		    printf("Age of the Values:      %li sec\n", time(NULL) - rsp->time);
+		    printf("BMP280 status:          0x%02u\n", rsp->bmp280_status);
+		    printf("Measurement cycle:      %u ms\n", rsp->cycle_time);
+		    printf("Uptime of server proc:  %li min\n", (time(NULL) - rsp->server_start) / 60);
+			break;
+		default:
+			// should never happen...
+		    fprintf(stderr, "unknown error...\n");
+			break;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+// Copies the metrics of the running daemon to stdout.
+int client_metrics(void) {
+	char buffer[4096];
+	ssize_t ret;
+	int sock;
+
+	sock = create_client_socket(METRICS_SOCKET_FILE);
+	if (sock < 0) {
+		fprintf(stderr, "no server detected.\n");
+		return EXIT_FAILURE;
+	}
+	while ((ret = recv(sock, buffer, sizeof(buffer), 0)) != 0) {
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			fprintf(stderr, "recv failed with code %i (%s)\n", errno, strerror(errno));
+			close(sock);
 			return EXIT_FAILURE;
 		}
+		fwrite(buffer, 1, ret, stdout);
 	}
+	close(sock);
+	return EXIT_SUCCESS;
+}
+
+// Prints one line per board: id, name, device, time stamp, T(HDC1080), T(BMP280), RH, CO2, TVOC, pressure
+int client_boards(int sock) {
+	struct response_from_server rsp;
+	std::vector<uint8_t> response;
+	unsigned count, id;
 
+	if (client_request(sock, FRAME_GET_BOARDS, std::vector<uint8_t>(), &response) != FRAME_BOARDS) {
+		return EXIT_FAILURE;
+	}
+	WireReader r(response.data(), response.size());
+	count = r.u8();
+	for (unsigned i = 0; i < count; i++) {
+		id = r.u8();
+		std::string name = r.str();
+		std::string device = r.str();
+		if (wire_get_values(&r, &rsp) < 0) {
+			fprintf(stderr, "invalid response from server\n");
+			return EXIT_FAILURE;
+		}
+		if (rsp.time == 0) {
+			printf("%u\t%s\t%s\twarming up\n", id, name.c_str(), device.c_str());
+			continue;
+		}
+		printf("%u\t%s\t%s\t%lld\t%.2lf\t%.2lf\t%.2lf\t%u\t%u\t%.2lf\n", id, name.c_str(), device.c_str(),
+			(long long)rsp.time, rsp.temp_HDC, rsp.temp_BMP, rsp.humidity, rsp.co2, rsp.tvoc, rsp.pressure);
+	}
 	return EXIT_SUCCESS;
 }
 
 int client_run(int sock, int cmd_option) {
-	struct command_to_server cmd;
 	struct response_from_server rsp;
-	int loop_time = DISPLAY_LOOP_INTERVAL;
+	std::vector<uint8_t> response;
+	int loop_time = 0;
+	int ret, waited;
 
 	switch (cmd_option) {
 		case 'p':
@@ -481,39 +2797,47 @@ int client_run(int sock, int cmd_option) {
 		case 'o':
 		case 'a':
 		case 'v':
-			cmd.command = CMD_GET_VALUES;
-			if (send(sock, &cmd, sizeof(cmd), 0) < 0) {
-				fprintf(stderr, "send failed with code %i (%s)\n", errno, strerror(errno));
-				return EXIT_FAILURE;
+			// a just started daemon has no values until its sensors are up
+			ret = client_request(sock, FRAME_GET_VALUES, std::vector<uint8_t>(1, (uint8_t)board_arg), &response);
+			for (waited = 0; (ret == CLIENT_WARMING_UP) && (waited < WARM_UP_TIMEOUT_MS);
+			     waited += CLIENT_POLL_INTERVAL_MS) {
+				usleep(CLIENT_POLL_INTERVAL_MS * 1000);
+				ret = client_request(sock, FRAME_GET_VALUES, std::vector<uint8_t>(1, (uint8_t)board_arg),
+						     &response);
+			}
+			if (ret == CLIENT_WARMING_UP) {
+				fprintf(stderr, "the server is warming up, try again later\n");
 			}
-			if (recv(sock, &rsp, sizeof(rsp), 0) < 0) {
-				fprintf(stderr, "recv failed with code %i (%s)\n", errno, strerror(errno));
+			if (ret != FRAME_VALUES) {
 				return EXIT_FAILURE;
 			}
+			{
+				WireReader r(response.data(), response.size());
+				if (wire_get_values(&r, &rsp) < 0) {
+					fprintf(stderr, "invalid response from server\n");
+					return EXIT_FAILURE;
+				}
+			}
 			break;
 
 		case 's':	// stop daemon
-			cmd.command = CMD_EXIT;
-		    if (send(sock, &cmd, sizeof(cmd), 0) < 0) {
-				fprintf(stderr, "send failed with code %i (%s)\n", errno, strerror(errno));
+			if (client_request(sock, FRAME_EXIT, std::vector<uint8_t>(), &response) < 0) {
 				return EXIT_FAILURE;
-		    }
+			}
 			return EXIT_SUCCESS;
 			break;
 
 		case 'r':	// restart daemon
-			cmd.command = CMD_EXIT;
-		    if (send(sock, &cmd, sizeof(cmd), 0) < 0) {
-				fprintf(stderr, "send failed with code %i (%s)\n", errno, strerror(errno));
+			if (client_request(sock, FRAME_EXIT, std::vector<uint8_t>(), &response) < 0) {
 				return EXIT_FAILURE;
-		    }
+			}
 			sleep(1);
 			start_server();
 			return EXIT_SUCCESS;
 			break;
 
 		case 'L':	// output values in a loop
-			loop_time = atoi(optarg);
+			loop_time = atoi(loop_time_arg);
 			if (loop_time < 1) {
 				loop_time = DISPLAY_LOOP_INTERVAL;
 			}
@@ -521,57 +2845,28 @@ int client_run(int sock, int cmd_option) {
 			return client_loop(sock, (unsigned int)loop_time);
 			break;
 
-		default:
+		case 'g':	// output the history
+		case 'G':
+			return client_history(sock, cmd_option);
 			break;
-	}
 
-	switch (cmd_option) {
-		case 'p':
-			printf("%.2lf\n", rsp.pressure);
-			return EXIT_SUCCESS;
-			break;
-		case 't':
-			printf("%.2lf\n", rsp.temp_BMP);
-			return EXIT_SUCCESS;
-			break;
-		case 'T':
-			printf("%.2lf\n", rsp.temp_HDC);
-			return EXIT_SUCCESS;
-			break;
-		case 'h':
-			printf("%.2lf\n", rsp.humidity);
-			return EXIT_SUCCESS;
+		case 'B':	// output all boards
+			return client_boards(sock);
 			break;
-		case 'c':
-			printf("%u\n", rsp.co2);
-			return EXIT_SUCCESS;
-			break;
-		case 'o':
-			printf("%u\n", rsp.tvoc);
-			return EXIT_SUCCESS;
-			break;
-		case 'a':
-			printf("%.2lf\n", (rsp.temp_BMP + rsp.temp_HDC) / 2.0);
-			return EXIT_SUCCESS;
+
+		case 'm':	// set the drive mode of the CCS811
+			return client_drive_mode(sock);
 			break;
-		case 'v':
-		    printf("Air Pressure:           %.2lf hPa\n",rsp.pressure);
-		    printf("Temperature (BMP200):   %.2lf °C\n", rsp.temp_BMP);
-		    printf("Temperature (HDC1080):  %.2lf °C\n", rsp.temp_HDC);
-		    printf("Air Humidity:           %.2lf %%\n", rsp.humidity);
-		    printf("CO2:                    %u ppm\n", rsp.co2);
-		    printf("TVOC:                   %u ppb\n", rsp.tvoc);
-		    printf("Age of the Values:      %li sec\n", time(NULL) - rsp.time);
-		    printf("BMP280 status:          0x%02u\n", rsp.bmp280_status);
-		    printf("Uptime of server proc:  %li min\n", (time(NULL) - rsp.server_start) / 60);
+
+		case 'w':	// output the raw data
+			return client_raw(sock);
 			break;
+
 		default:
-			// should never happen...
-		    fprintf(stderr, "unknown error...\n");
 			break;
 	}
 
-	return EXIT_SUCCESS;
+	return print_values(cmd_option, &rsp);
 }
 
 /***************************************************************************/
@@ -579,18 +2874,81 @@ int client_run(int sock, int cmd_option) {
 /***************************************************************************/
 int main(int argc, char *argv[])
 {
-	int cmd_option;
+	int cmd_option = -1;
+	int option;
 	int retry_counter = 3;
-	int ret, sock;
+	int ret, sock, waited;
 
 	app_name = argv[0];
 
-	if (((cmd_option = getopt(argc, argv, "srptThcoavlL:?")) == -1) || (cmd_option == '?')) {
+	while ((option = getopt(argc, argv, "srptThcoavlBML:g:G:R:m:w:n:f:k:d:C:b:?")) != -1) {
+		if (option == '?') {
+			print_help();
+			return EXIT_FAILURE;
+		}
+		if (option == 'd') {
+			i2c_device = optarg;
+		} else if (option == 'C') {
+			if (read_board_config(optarg) < 0) {
+				return EXIT_FAILURE;
+			}
+		} else if (option == 'b') {
+			board_arg = strtoul(optarg, NULL, 0);
+			if (board_arg >= BOARD_MAX) {
+				fprintf(stderr, "invalid board: %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+		} else if (option == 'f') {
+			sample_log_file = optarg;
+		} else if (option == 'k') {
+			baseline_file = optarg;
+		} else if (option == 'n') {
+			history_depth = strtoul(optarg, NULL, 0);
+			if (history_depth < 1) {
+				history_depth = HISTORY_DEPTH;
+			}
+		} else if (cmd_option == -1) {	// only the first command is executed
+			cmd_option = option;
+			if (option == 'L') {
+				loop_time_arg = optarg;
+			}
+			if ((option == 'g') || (option == 'G') || (option == 'R') || (option == 'w')) {
+				history_arg = optarg;
+			}
+			if (option == 'm') {
+				drive_mode_arg = optarg;
+			}
+		}
+	}
+	if (cmd_option == -1) {
 		print_help();
 		return EXIT_FAILURE;
 	}
 
-	while ((sock = create_client_socket()) < 0) {
+	if (cmd_option == 'R') {	// reads the files, no server needed
+		return client_log();
+	}
+	if (cmd_option == 'M') {	// does not start a server
+		return client_metrics();
+	}
+	if (board_configs.empty()) {	// no configuration file: one board with the default addresses
+		struct board_config config;
+		config.name = BOARD_DEFAULT_NAME;
+		config.device = i2c_device;
+		config.ccs811_addr = 0x5a;
+		config.hdc1080_addr = 0x40;
+		config.bmp280_addr = 0x76;
+		board_configs.push_back(config);
+	}
+
+	if ((board_arg == 0) && (strchr("ptThcoav", cmd_option) != NULL)) {	// value queries: shared memory if a server is running
+		struct response_from_server rsp;
+		if (read_snapshot(&rsp) == 0) {
+			return print_values(cmd_option, &rsp);
+		}
+	}
+
+	while ((sock = create_client_socket(SOCKET_FILE)) < 0) {
 		// no server exists -> start one...
 
 		if (cmd_option =='s') {
@@ -599,11 +2957,19 @@ int main(int argc, char *argv[])
 		}
 
 		start_server();
-		sleep(1);
-
 		if (cmd_option =='r') { // restart command: nothing more to do
 			return EXIT_SUCCESS;
 		}
+		// the daemon opens its socket before it starts the sensors
+		for (waited = 0; waited < SERVER_START_TIMEOUT_MS; waited += CLIENT_POLL_INTERVAL_MS) {
+			usleep(CLIENT_POLL_INTERVAL_MS * 1000);
+			if ((sock = create_client_socket(SOCKET_FILE)) >= 0) {
+				break;
+			}
+		}
+		if (sock >= 0) {
+			break;
+		}
 
 		if ((retry_counter--) == 0) {
 			fprintf(stderr, "Unable to connect, giving up...\n");
@@ -624,9 +2990,10 @@ int main(int argc, char *argv[])
 #include <iomanip>
 
 int main() {
-    CCS811 ccs811(I2C_DEVICE, 0x5a);
-    HDC1080 hdc1080(I2C_DEVICE, 0x40);
-    BMP280 bmp280(I2C_DEVICE, 0x76);
+    LinuxI2C bus(I2C_DEVICE);
+    CCS811 ccs811(bus, 0x5a);
+    HDC1080 hdc1080(bus, 0x40);
+    BMP280 bmp280(bus, 0x76);
 
     while (true) {5A5A5A5A5A
         ccs811.read_sensors();